@@ -0,0 +1,34 @@
+# Copyright (C) 2024 The Qt Company Ltd.
+# SPDX-License-Identifier: BSD-3-Clause
+
+# We can't create the same interface imported target multiple times, CMake will complain if we do
+# that. This can happen if the find_package call is done in multiple different subdirectories.
+if(TARGET WrapLZ4::WrapLZ4)
+    set(WrapLZ4_FOUND ON)
+    return()
+endif()
+
+find_package(PkgConfig QUIET)
+if(PKG_CONFIG_FOUND)
+    pkg_check_modules(PC_LZ4 QUIET liblz4)
+endif()
+
+find_path(LZ4_INCLUDE_DIR NAMES lz4.h HINTS ${PC_LZ4_INCLUDEDIR} ${PC_LZ4_INCLUDE_DIRS})
+find_library(LZ4_LIBRARY NAMES lz4 liblz4 HINTS ${PC_LZ4_LIBDIR} ${PC_LZ4_LIBRARY_DIRS})
+if(PC_LZ4_VERSION)
+    set(WrapLZ4_VERSION "${PC_LZ4_VERSION}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(WrapLZ4
+    REQUIRED_VARS LZ4_LIBRARY LZ4_INCLUDE_DIR
+    VERSION_VAR WrapLZ4_VERSION
+)
+
+if(WrapLZ4_FOUND)
+    add_library(WrapLZ4::WrapLZ4 INTERFACE IMPORTED)
+    target_include_directories(WrapLZ4::WrapLZ4 INTERFACE "${LZ4_INCLUDE_DIR}")
+    target_link_libraries(WrapLZ4::WrapLZ4 INTERFACE "${LZ4_LIBRARY}")
+endif()
+
+mark_as_advanced(LZ4_INCLUDE_DIR LZ4_LIBRARY)
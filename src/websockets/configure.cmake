@@ -0,0 +1,32 @@
+# Copyright (C) 2024 The Qt Company Ltd.
+# SPDX-License-Identifier: BSD-3-Clause
+
+#### Inputs
+
+
+
+#### Libraries
+
+qt_find_package(WrapLZ4 PROVIDED_TARGETS WrapLZ4::WrapLZ4 MODULE_NAME websockets QMAKE_LIB lz4)
+qt_find_package(WrapZSTD 1.3 PROVIDED_TARGETS WrapZSTD::WrapZSTD MODULE_NAME websockets
+                QMAKE_LIB zstd)
+
+
+#### Tests
+
+
+
+#### Features
+
+qt_feature("websockets-lz4" PRIVATE
+    LABEL "LZ4 message compression"
+    CONDITION WrapLZ4_FOUND
+)
+qt_feature("websockets-zstd" PRIVATE
+    LABEL "Zstandard message compression"
+    CONDITION WrapZSTD_FOUND
+)
+qt_configure_add_summary_section(NAME "Qt WebSockets")
+qt_configure_add_summary_entry(ARGS "websockets-lz4")
+qt_configure_add_summary_entry(ARGS "websockets-zstd")
+qt_configure_end_summary_section() # end of "Qt WebSockets" section
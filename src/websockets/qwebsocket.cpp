@@ -16,7 +16,8 @@
 
     This class was modeled after QAbstractSocket.
 
-    QWebSocket currently does not support \l {WebSocket Extensions}.
+    Per-message \l {WebSocket Extensions} can be offered with
+    QWebSocketHandshakeOptions::setExtensions(); see QWebSocketExtension.
 
     QWebSocket only supports version 13 of the WebSocket protocol, as outlined in
     \l {RFC 6455}.
@@ -63,6 +64,37 @@
     Whenever a message is received, we write it out.
 */
 
+/*!
+    \enum QWebSocket::MessagePriority
+    \since 6.9
+
+    This enum describes in which order queued messages are sent.
+
+    \value NormalPriority The message is sent after all messages queued before it.
+    \value HighPriority The message is sent before all queued messages of normal priority,
+    as soon as the message that is currently being sent is complete.
+
+    \sa sendTextMessage(), sendBinaryMessage()
+*/
+
+/*!
+    \enum QWebSocket::RateLimitPolicy
+    \since 6.9
+
+    This enum describes what happens to incoming frames beyond the rate limits.
+
+    \value DelayReading Reading from the network pauses until the limits
+    allow more frames. The peer is slowed down by TCP flow control, and
+    nothing is lost. This is the default.
+    \value DropExcess Messages and ping and pong frames beyond the limits are
+    discarded; pings that are dropped are not answered. A message is dropped
+    or delivered as a whole.
+    \value CloseConnection The connection is closed with
+    QWebSocketProtocol::CloseCodePolicyViolated.
+
+    \sa setIncomingRateLimitPolicy()
+*/
+
 /*!
   \fn void QWebSocket::connected()
   \brief Emitted when a connection is successfully established.
@@ -192,6 +224,18 @@ not been filled in with new information when the signal returns.
 
     \sa textMessageReceived()
 */
+/*!
+    \fn void QWebSocket::messageRelayed(const QByteArray &message, bool isBinary);
+    \since 6.9
+
+    This signal is emitted whenever a message has been relayed to the
+    relayTarget(). The \a message contains the payload as received, which is
+    UTF-8 for text messages; \a isBinary tells the two apart.
+
+    The frames of a message are only assembled while this signal is connected.
+
+    \sa setRelayTarget()
+*/
 /*!
     \fn void QWebSocket::sslErrors(const QList<QSslError> &errors)
     QWebSocket emits this signal after the SSL handshake to indicate that one or more errors have
@@ -344,6 +388,8 @@ QWebSocket::~QWebSocket()
 {
     Q_D(QWebSocket);
     d->closeGoingAway();
+    // nothing may be queued to this socket by the budget anymore
+    d->setMemoryBudget(nullptr);
 }
 
 /*!
@@ -410,6 +456,10 @@ bool QWebSocket::flush()
     \brief Sends the given \a message over the socket as a text message and
     returns the number of bytes actually sent.
 
+    Messages are queued and split into frames of at most outgoingFrameSize()
+    bytes while they are sent, so the returned value is the number of bytes
+    of the message that have been queued.
+
     \sa sendBinaryMessage()
  */
 qint64 QWebSocket::sendTextMessage(const QString &message)
@@ -418,10 +468,34 @@ qint64 QWebSocket::sendTextMessage(const QString &message)
     return d->sendTextMessage(message);
 }
 
+/*!
+    \since 6.9
+    \overload
+
+    Sends the given \a message over the socket as a text message with the
+    given \a priority and returns the number of bytes queued.
+
+    A message sent with QWebSocket::HighPriority is sent before all messages
+    of normal priority that have not been started yet. Control frames, such
+    as pings, pongs and the close frame, are always sent at the next frame
+    boundary.
+
+    \sa sendBinaryMessage(), outgoingFrameSize()
+ */
+qint64 QWebSocket::sendTextMessage(const QString &message, MessagePriority priority)
+{
+    Q_D(QWebSocket);
+    return d->sendTextMessage(message, priority);
+}
+
 /*!
     \brief Sends the given \a data over the socket as a binary message and
     returns the number of bytes actually sent.
 
+    Messages are queued and split into frames of at most outgoingFrameSize()
+    bytes while they are sent, so the returned value is the number of bytes
+    of the message that have been queued.
+
     \sa sendTextMessage()
  */
 qint64 QWebSocket::sendBinaryMessage(const QByteArray &data)
@@ -430,6 +504,198 @@ qint64 QWebSocket::sendBinaryMessage(const QByteArray &data)
     return d->sendBinaryMessage(data);
 }
 
+/*!
+    \since 6.9
+    \overload
+
+    Sends the given \a data over the socket as a binary message with the
+    given \a priority and returns the number of bytes queued.
+
+    \sa sendTextMessage(const QString &, MessagePriority)
+ */
+qint64 QWebSocket::sendBinaryMessage(const QByteArray &data, MessagePriority priority)
+{
+    Q_D(QWebSocket);
+    return d->sendBinaryMessage(data, priority);
+}
+
+/*!
+    \since 6.9
+
+    Sends \a length bytes of \a file, starting at \a offset, over the socket as
+    a binary message and returns the number of bytes queued. If \a length is
+    -1, everything from \a offset up to the end of the file is sent.
+
+    The file is read while the message is being sent, so it must stay open and
+    unchanged until then. If it cannot be read, or is destroyed before the
+    message has been sent, the connection is aborted, as the message cannot be
+    completed.
+
+    On Linux, the payload is moved from the file to the socket by the kernel
+    when frames are neither masked nor encrypted, which is the case for
+    server-side sockets in QWebSocketServer::NonSecureMode. Those bytes are not
+    reported by the bytesWritten() signal.
+
+    Returns -1 if \a file is not open for reading, is a sequential device,
+    or does not contain the requested range.
+
+    \sa sendBinaryMessage()
+ */
+qint64 QWebSocket::sendFile(QFile *file, qint64 offset, qint64 length)
+{
+    Q_D(QWebSocket);
+    return d->sendFile(file, offset, length);
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Queues the given \a message to be sent over the socket as a text message.
+    Unlike sendTextMessage(), this function can be called from any thread.
+
+    The message is handed to the socket by the thread the socket lives in,
+    which is woken up once for all messages posted in the meantime. Messages
+    posted from one thread are sent in the order they were posted, but after
+    the messages sent with sendTextMessage() or sendBinaryMessage() before the
+    socket's thread got to them. Messages posted while the socket is not
+    connected are discarded.
+
+    \sa postBinaryMessage(), sendTextMessage()
+ */
+void QWebSocket::postTextMessage(const QString &message)
+{
+    Q_D(QWebSocket);
+    d->postMessage(message.toUtf8(), false);
+}
+
+/*!
+    \since 6.9
+    \threadsafe
+
+    Queues the given \a data to be sent over the socket as a binary message.
+    Unlike sendBinaryMessage(), this function can be called from any thread.
+
+    \sa postTextMessage(), sendBinaryMessage()
+ */
+void QWebSocket::postBinaryMessage(const QByteArray &data)
+{
+    Q_D(QWebSocket);
+    d->postMessage(data, true);
+}
+
+/*!
+    \since 6.9
+
+    Hands the connection over, so that it can be continued by a QWebSocket
+    created with restoreState(), for example in a new instance of the
+    application that takes over from this one.
+
+    Returns the state of the connection and stores a duplicate of its socket
+    descriptor in \a socketDescriptor; the caller takes ownership of the
+    descriptor. The state contains the negotiated subprotocol and extension,
+    the masking role, the frame and message size limits, and all data that
+    has been received but not delivered yet, including a partially received
+    message. Messages that have been sent are written to the socket before the
+    handover. This blocks the calling thread until they have been written, but
+    for at most one second; if the peer does not accept them in that time, the
+    handover fails.
+
+    This socket is then closed without a close frame and without ending the
+    connection, and disconnected() is emitted.
+
+    On Unix, the descriptor can be passed to another process over a Unix
+    domain socket with \c SCM_RIGHTS. A listening socket can be handed over
+    the same way with QWebSocketServer::socketDescriptor() and
+    QWebSocketServer::setSocketDescriptor().
+
+    Returns an empty QByteArray and leaves the socket open if it is not
+    connected, is closing, uses TLS, has negotiated extensions (see
+    QWebSocketHandshakeOptions::setExtensions()), cannot write the sent
+    messages in time, or the platform does not support duplicating socket
+    descriptors.
+
+    \note The frame signals for the part of a partially received message are
+    emitted again by the restored socket, as a single frame.
+
+    \sa restoreState()
+ */
+QByteArray QWebSocket::saveState(qintptr *socketDescriptor)
+{
+    Q_D(QWebSocket);
+    return d->saveState(socketDescriptor);
+}
+
+/*!
+    \since 6.9
+
+    Creates a QWebSocket with the given \a parent that continues the
+    connection of \a socketDescriptor, using the \a state returned by
+    saveState(). Data received before the handover is processed once control
+    returns to the event loop, so signals can be connected first.
+
+    Returns \nullptr if \a state is not valid or the descriptor cannot be
+    used, in which case the caller keeps ownership of the descriptor.
+
+    \sa saveState()
+ */
+QWebSocket *QWebSocket::restoreState(qintptr socketDescriptor, const QByteArray &state,
+                                     QObject *parent)
+{
+    return QWebSocketPrivate::restoreState(socketDescriptor, state, parent);
+}
+
+/*!
+    \since 6.9
+
+    Relays the messages received on this socket to \a target, for example
+    from a gateway to a backend. Frames are handed to \a target as they
+    arrive: messages are not assembled, text is not decoded or validated,
+    and only the masking is redone for the peer of \a target. If extensions
+    have been negotiated, messages are decoded by those of this socket, and
+    \a target assembles them to encode them with its own. No
+    textMessageReceived(), binaryMessageReceived(), textFrameReceived() or
+    binaryFrameReceived() signals are emitted while relaying; connect to
+    messageRelayed() to inspect the messages.
+
+    Pings and close frames are still handled by this socket; closing
+    \a target when this socket closes is up to the application. To relay in
+    both directions, set each socket as the relay target of the other.
+
+    Reading pauses while \a target has more than a few megabytes to write,
+    so that a slow peer does not make the data pile up in memory; consider
+    setReadBufferSize() to limit what the socket buffers in the meantime.
+    Frames are dropped if \a target is not connected.
+
+    \a target must live in the same thread as this socket; a target in another
+    thread is refused with a warning, and frames are dropped if either socket
+    is moved to another thread later on.
+
+    The target should only be changed between messages. Passing \nullptr
+    stops relaying. Relaying is not supported on WebAssembly.
+
+    \sa relayTarget(), messageRelayed()
+ */
+void QWebSocket::setRelayTarget(QWebSocket *target)
+{
+    Q_D(QWebSocket);
+    d->setRelayTarget(target);
+}
+
+/*!
+    \since 6.9
+
+    Returns the socket that received messages are relayed to, or \nullptr if
+    no relay target is set.
+
+    \sa setRelayTarget()
+ */
+QWebSocket *QWebSocket::relayTarget() const
+{
+    Q_D(const QWebSocket);
+    return d->relayTarget();
+}
+
 /*!
     \brief Gracefully closes the socket with the given \a closeCode and \a reason.
 
@@ -886,12 +1152,14 @@ bool QWebSocket::isValid() const
     Returns the number of bytes that are waiting to be written. The bytes are written when control
     goes back to the event loop or when flush() is called.
 
+    This includes the payload of queued messages that have not been split into frames yet.
+
     \sa flush
  */
 qint64 QWebSocket::bytesToWrite() const
 {
     Q_D(const QWebSocket);
-    return d->m_pSocket ? d->m_pSocket->bytesToWrite() : 0;
+    return d->bytesToWrite();
 }
 
 /*!
@@ -968,6 +1236,208 @@ quint64 QWebSocket::maxIncomingFrameSize()
     return QWebSocketPrivate::maxIncomingFrameSize();
 }
 
+/*!
+    \since 6.9
+    Limits the payload received on this socket to \a bytesPerSecond, with
+    bursts of up to as many bytes. A frame that exceeds what is left is
+    let through, and counts against the following frames.
+    The default is 0, which means no limit.
+
+    \sa setIncomingRateLimitPolicy(), incomingByteRateLimit()
+ */
+void QWebSocket::setIncomingByteRateLimit(qint64 bytesPerSecond)
+{
+    Q_D(QWebSocket);
+    d->setIncomingByteRateLimit(bytesPerSecond);
+}
+
+/*!
+    \since 6.9
+    Returns the maximum number of payload bytes received per second, or 0 if
+    there is no limit.
+
+    \sa setIncomingByteRateLimit()
+ */
+qint64 QWebSocket::incomingByteRateLimit() const
+{
+    Q_D(const QWebSocket);
+    return d->incomingByteRateLimit();
+}
+
+/*!
+    \since 6.9
+    Limits the text and binary messages received on this socket to
+    \a messagesPerSecond, with bursts of up to as many messages.
+    The default is 0, which means no limit.
+
+    \sa setIncomingRateLimitPolicy(), incomingMessageRateLimit()
+ */
+void QWebSocket::setIncomingMessageRateLimit(int messagesPerSecond)
+{
+    Q_D(QWebSocket);
+    d->setIncomingMessageRateLimit(messagesPerSecond);
+}
+
+/*!
+    \since 6.9
+    Returns the maximum number of messages received per second, or 0 if there
+    is no limit.
+
+    \sa setIncomingMessageRateLimit()
+ */
+int QWebSocket::incomingMessageRateLimit() const
+{
+    Q_D(const QWebSocket);
+    return d->incomingMessageRateLimit();
+}
+
+/*!
+    \since 6.9
+    Limits the ping and pong frames received on this socket to
+    \a framesPerSecond, with bursts of up to as many frames. Every ping is
+    answered with a pong, so this also limits the pongs sent back. Close
+    frames are not limited.
+    The default is 0, which means no limit.
+
+    \sa setIncomingRateLimitPolicy(), incomingControlFrameRateLimit()
+ */
+void QWebSocket::setIncomingControlFrameRateLimit(int framesPerSecond)
+{
+    Q_D(QWebSocket);
+    d->setIncomingControlFrameRateLimit(framesPerSecond);
+}
+
+/*!
+    \since 6.9
+    Returns the maximum number of ping and pong frames received per second,
+    or 0 if there is no limit.
+
+    \sa setIncomingControlFrameRateLimit()
+ */
+int QWebSocket::incomingControlFrameRateLimit() const
+{
+    Q_D(const QWebSocket);
+    return d->incomingControlFrameRateLimit();
+}
+
+/*!
+    \since 6.9
+    Sets what happens to incoming frames beyond the rate limits to \a policy.
+    The default is QWebSocket::DelayReading.
+
+    \sa incomingRateLimitPolicy(), incomingRateLimitHits()
+ */
+void QWebSocket::setIncomingRateLimitPolicy(RateLimitPolicy policy)
+{
+    Q_D(QWebSocket);
+    d->setIncomingRateLimitPolicy(policy);
+}
+
+/*!
+    \since 6.9
+    Returns what happens to incoming frames beyond the rate limits.
+
+    \sa setIncomingRateLimitPolicy()
+ */
+QWebSocket::RateLimitPolicy QWebSocket::incomingRateLimitPolicy() const
+{
+    Q_D(const QWebSocket);
+    return d->incomingRateLimitPolicy();
+}
+
+/*!
+    \since 6.9
+    Returns how many times the incoming rate limits have been hit on this
+    socket: how many times reading has been delayed, how many messages and
+    control frames have been dropped, or whether the connection has been
+    closed, depending on incomingRateLimitPolicy().
+
+    \sa setIncomingRateLimitPolicy()
+ */
+quint64 QWebSocket::incomingRateLimitHits() const
+{
+    Q_D(const QWebSocket);
+    return d->incomingRateLimitHits();
+}
+
+#if __has_include(<chrono>)
+/*!
+    \since 6.9
+    Makes the socket trim its buffers with trimMemory() once there has been
+    no traffic for \a interval, and at most twice as long. The socket then
+    waits for traffic before it checks again, so idle sockets do not run a
+    timer. A value of 0, the default, disables idle trimming.
+
+    \sa idleTrimInterval(), QWebSocketServer::setIdleTrimInterval()
+ */
+void QWebSocket::setIdleTrimInterval(std::chrono::milliseconds interval)
+{
+    Q_D(QWebSocket);
+    d->setIdleTrimInterval(interval);
+}
+
+/*!
+    \since 6.9
+    Returns the time without traffic after which the socket trims its
+    buffers, or 0 if it does not.
+
+    \sa setIdleTrimInterval()
+ */
+std::chrono::milliseconds QWebSocket::idleTrimInterval() const
+{
+    Q_D(const QWebSocket);
+    return d->idleTrimInterval();
+}
+#endif
+
+/*!
+    \since 6.9
+    Gives the capacity the buffers of this socket have kept from earlier
+    traffic back to the allocator, and returns the number of bytes freed.
+    Nothing that is waiting to be read or written is lost.
+
+    Buffers grow to fit bursts of traffic, and otherwise keep their capacity
+    for the next burst. On connections that are mostly idle, it is better to
+    trim them, at the cost of allocating again on the next burst. The start
+    of a frame that has not arrived completely is moved out of the read
+    buffer of the socket, so that the buffer can be freed as well.
+
+    \sa setIdleTrimInterval(), QWebSocketServer::trimMemory()
+ */
+qint64 QWebSocket::trimMemory()
+{
+    Q_D(QWebSocket);
+    return d->trimMemory();
+}
+
+/*!
+    \since 6.9
+    Makes this socket share the addresses of the hosts and the TLS sessions
+    it connects to with the other sockets using \a context, and reuse
+    theirs, so that reconnecting to the same host is faster. The context is
+    not owned by the socket, and is used from the next call to open() on.
+    Pass \nullptr to stop using a context.
+
+    \sa QWebSocketClientContext
+ */
+void QWebSocket::setClientContext(QWebSocketClientContext *context)
+{
+    Q_D(QWebSocket);
+    d->m_clientContext = context;
+}
+
+/*!
+    \since 6.9
+    Returns the client context of this socket, or \nullptr if it has none.
+
+    \sa setClientContext()
+ */
+QWebSocketClientContext *QWebSocket::clientContext() const
+{
+    Q_D(const QWebSocket);
+    return d->m_clientContext;
+}
+
 /*!
     \since 5.15
     Sets the maximum size of an outgoing websocket frame to \a outgoingFrameSize.
@@ -19,13 +19,19 @@
 
 #include <QtCore/qobject.h>
 
+#if __has_include(<chrono>)
+#include <chrono>
+#endif
+
 QT_BEGIN_NAMESPACE
 
 class QAuthenticator;
 class QTcpSocket;
+class QFile;
 class QWebSocketPrivate;
 class QMaskGenerator;
 class QWebSocketHandshakeOptions;
+class QWebSocketClientContext;
 
 class Q_WEBSOCKETS_EXPORT QWebSocket : public QObject
 {
@@ -34,6 +40,19 @@ class Q_WEBSOCKETS_EXPORT QWebSocket : public QObject
     Q_DECLARE_PRIVATE(QWebSocket)
 
 public:
+    enum MessagePriority {
+        NormalPriority,
+        HighPriority
+    };
+    Q_ENUM(MessagePriority)
+
+    enum RateLimitPolicy {
+        DelayReading,
+        DropExcess,
+        CloseConnection
+    };
+    Q_ENUM(RateLimitPolicy)
+
     explicit QWebSocket(const QString &origin = QString(),
                         QWebSocketProtocol::Version version = QWebSocketProtocol::VersionLatest,
                         QObject *parent = nullptr);
@@ -74,8 +93,21 @@ public:
     QWebSocketProtocol::CloseCode closeCode() const;
     QString closeReason() const;
 
+    // ### Qt7: Merge overloads
     qint64 sendTextMessage(const QString &message);
+    qint64 sendTextMessage(const QString &message, MessagePriority priority);
     qint64 sendBinaryMessage(const QByteArray &data);
+    qint64 sendBinaryMessage(const QByteArray &data, MessagePriority priority);
+    qint64 sendFile(QFile *file, qint64 offset = 0, qint64 length = -1);
+    void postTextMessage(const QString &message);
+    void postBinaryMessage(const QByteArray &data);
+
+    QByteArray saveState(qintptr *socketDescriptor);
+    static QWebSocket *restoreState(qintptr socketDescriptor, const QByteArray &state,
+                                    QObject *parent = nullptr);
+
+    void setRelayTarget(QWebSocket *target);
+    QWebSocket *relayTarget() const;
 
 #ifndef QT_NO_SSL
     void ignoreSslErrors(const QList<QSslError> &errors);
@@ -94,6 +126,25 @@ public:
     static quint64 maxIncomingMessageSize();
     static quint64 maxIncomingFrameSize();
 
+    void setIncomingByteRateLimit(qint64 bytesPerSecond);
+    qint64 incomingByteRateLimit() const;
+    void setIncomingMessageRateLimit(int messagesPerSecond);
+    int incomingMessageRateLimit() const;
+    void setIncomingControlFrameRateLimit(int framesPerSecond);
+    int incomingControlFrameRateLimit() const;
+    void setIncomingRateLimitPolicy(RateLimitPolicy policy);
+    RateLimitPolicy incomingRateLimitPolicy() const;
+    quint64 incomingRateLimitHits() const;
+
+#if __has_include(<chrono>) || defined(Q_QDOC)
+    void setIdleTrimInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds idleTrimInterval() const;
+#endif
+    qint64 trimMemory();
+
+    void setClientContext(QWebSocketClientContext *context);
+    QWebSocketClientContext *clientContext() const;
+
     void setOutgoingFrameSize(quint64 outgoingFrameSize);
     quint64 outgoingFrameSize() const;
     static quint64 maxOutgoingFrameSize();
@@ -127,6 +178,7 @@ Q_SIGNALS:
     void binaryFrameReceived(const QByteArray &frame, bool isLastFrame);
     void textMessageReceived(const QString &message);
     void binaryMessageReceived(const QByteArray &message);
+    void messageRelayed(const QByteArray &message, bool isBinary);
 #if QT_DEPRECATED_SINCE(6, 5)
     QT_DEPRECATED_VERSION_X_6_5("Use errorOccurred instead")
     void error(QAbstractSocket::SocketError error);
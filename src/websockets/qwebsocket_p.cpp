@@ -3,7 +3,11 @@
 
 #include "qwebsocket.h"
 #include "qwebsocket_p.h"
+#include "qwebsocketclientcontext_p.h"
 #include "qwebsocketprotocol_p.h"
+#include "qwebsocketframe_p.h"
+#include "qwebsocketbufferpool_p.h"
+#include "qwebsocketextension.h"
 #include "qwebsockethandshakerequest_p.h"
 #include "qwebsockethandshakeresponse_p.h"
 #include "qdefaultmaskgenerator_p.h"
@@ -29,13 +33,32 @@
 
 #include <QtNetwork/private/qhttpheaderparser_p.h>
 #include <QtNetwork/private/qauthenticator_p.h>
+#include <QtCore/private/qiodevice_p.h>
 
+#include <QtCore/QBuffer>
+#include <QtCore/QDataStream>
+#include <QtCore/QDeadlineTimer>
 #include <QtCore/QDebug>
+#include <QtCore/QFile>
+#include <QtCore/QMetaMethod>
+#include <QtCore/QScopeGuard>
+#include <QtCore/QScopedValueRollback>
 #include <QtCore/QTimer>
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <limits>
 #include <memory>
 
+#ifdef Q_OS_LINUX
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#endif
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#endif
+
 QT_BEGIN_NAMESPACE
 
 using namespace Qt::StringLiterals;
@@ -45,6 +68,14 @@ namespace {
 constexpr quint64 MAX_OUTGOING_FRAME_SIZE_IN_BYTES = std::numeric_limits<int>::max() - 1;
 constexpr quint64 DEFAULT_OUTGOING_FRAME_SIZE_IN_BYTES = 512 * 512 * 2; // default size of a frame when sending a message
 
+// format of the data returned by QWebSocket::saveState()
+constexpr quint32 SAVED_STATE_MAGIC = 0x51575353; // "QWSS"
+constexpr quint8 SAVED_STATE_VERSION = 1;
+// how long saveState() waits, in total, for the write buffer to drain
+constexpr int SAVE_STATE_WRITE_TIMEOUT_MS = 1000;
+// reading stops while the relay target has more than this to write
+constexpr qint64 MAX_RELAY_BACKLOG_IN_BYTES = 4 * 1024 * 1024;
+
 // Based on isSeperator() from qtbase/src/network/access/qhsts.cpp
 // https://datatracker.ietf.org/doc/html/rfc2616#section-2.2:
 //
@@ -118,7 +149,7 @@ QWebSocketPrivate::QWebSocketPrivate(const QString &origin, QWebSocketProtocol::
     m_closeReason(),
     m_pingTimer(),
     m_configuration(),
-    m_pMaskGenerator(&m_defaultMaskGenerator),
+    m_pMaskGenerator(nullptr),
     m_defaultMaskGenerator(),
     m_outgoingFrameSize(DEFAULT_OUTGOING_FRAME_SIZE_IN_BYTES)
 {
@@ -131,7 +162,7 @@ QWebSocketPrivate::QWebSocketPrivate(const QString &origin, QWebSocketProtocol::
 QWebSocketPrivate::QWebSocketPrivate(QTcpSocket *pTcpSocket, QWebSocketProtocol::Version version) :
     QObjectPrivate(),
     m_pSocket(pTcpSocket),
-    m_errorString(pTcpSocket->errorString()),
+    m_errorString(),
     m_version(version),
     m_resourceName(),
     m_request(),
@@ -149,7 +180,7 @@ QWebSocketPrivate::QWebSocketPrivate(QTcpSocket *pTcpSocket, QWebSocketProtocol:
     m_closeReason(),
     m_pingTimer(),
     m_configuration(),
-    m_pMaskGenerator(&m_defaultMaskGenerator),
+    m_pMaskGenerator(nullptr),
     m_defaultMaskGenerator(),
     m_outgoingFrameSize(DEFAULT_OUTGOING_FRAME_SIZE_IN_BYTES)
 {
@@ -162,10 +193,8 @@ QWebSocketPrivate::QWebSocketPrivate(QTcpSocket *pTcpSocket, QWebSocketProtocol:
 void QWebSocketPrivate::init()
 {
     Q_ASSERT(q_ptr);
-    Q_ASSERT(m_pMaskGenerator);
 
     m_dataProcessor->setParent(q_ptr);
-    m_pMaskGenerator->seed();
 
     if (m_pSocket) {
         makeConnections(m_pSocket);
@@ -240,27 +269,42 @@ QString QWebSocketPrivate::errorString() const
 bool QWebSocketPrivate::flush()
 {
     bool result = true;
-    if (Q_LIKELY(m_pSocket))
+    if (Q_LIKELY(m_pSocket)) {
+        writeQueuedFrames();
         result = m_pSocket->flush();
+        // keep refilling the socket for as long as it takes data without blocking
+        for (bool flushed = result; flushed && m_queuedBytes > 0; flushed = m_pSocket->flush())
+            writeQueuedFrames();
+    }
     return result;
 }
 
+/*!
+    \internal
+ */
+qint64 QWebSocketPrivate::bytesToWrite() const
+{
+    return m_pSocket ? m_pSocket->bytesToWrite() + m_queuedBytes : 0;
+}
+
 #ifndef Q_OS_WASM
 
 /*!
     \internal
  */
-qint64 QWebSocketPrivate::sendTextMessage(const QString &message)
+qint64 QWebSocketPrivate::sendTextMessage(const QString &message,
+                                          QWebSocket::MessagePriority priority)
 {
-    return doWriteFrames(message.toUtf8(), false);
+    return doWriteFrames(message.toUtf8(), false, priority);
 }
 
 /*!
     \internal
  */
-qint64 QWebSocketPrivate::sendBinaryMessage(const QByteArray &data)
+qint64 QWebSocketPrivate::sendBinaryMessage(const QByteArray &data,
+                                            QWebSocket::MessagePriority priority)
 {
-    return doWriteFrames(data, true);
+    return doWriteFrames(data, true, priority);
 }
 
 #endif
@@ -367,7 +411,9 @@ QWebSocket *QWebSocketPrivate::upgradeFrom(QTcpSocket *pTcpSocket,
             pWebSocket->setSslConfiguration(sslSock->sslConfiguration());
 #endif
         QWebSocketHandshakeOptions options;
-        options.setSubprotocols(request.protocols());
+        // avoid detaching the options for the common case of no subprotocols
+        if (!request.protocols().isEmpty())
+            options.setSubprotocols(request.protocols());
 
         pWebSocket->d_func()->setExtension(response.acceptedExtension());
         pWebSocket->d_func()->setOrigin(request.origin());
@@ -392,26 +438,23 @@ void QWebSocketPrivate::close(QWebSocketProtocol::CloseCode closeCode, QString r
         return;
     if (!m_isClosingHandshakeSent) {
         Q_Q(QWebSocket);
+        // the close frame must be the last frame we send, so everything that
+        // has been queued before goes out first
+        writeQueuedFrames(true);
         m_closeCode = closeCode;
         // 125 is the maximum length of a control frame, and 2 bytes are used for the close code:
         const QByteArray reasonUtf8 = reason.toUtf8().left(123);
         m_closeReason = QString::fromUtf8(reasonUtf8);
-        const quint16 code = qToBigEndian<quint16>(closeCode);
-        QByteArray payload;
-        payload.append(static_cast<const char *>(static_cast<const void *>(&code)), 2);
-        if (!reasonUtf8.isEmpty())
-            payload.append(reasonUtf8);
+        // control frames are small enough to be assembled on the stack
+        char payload[125];
+        qToBigEndian<quint16>(closeCode, payload);
+        memcpy(payload + 2, reasonUtf8.constData(), size_t(reasonUtf8.size()));
         quint32 maskingKey = 0;
-        if (m_mustMask) {
+        if (m_mustMask)
             maskingKey = generateMaskingKey();
-            QWebSocketProtocol::mask(payload.data(), quint64(payload.size()), maskingKey);
-        }
-        QByteArray frame = getFrameHeader(QWebSocketProtocol::OpCodeClose,
-                                          quint64(payload.size()), maskingKey, true);
-
-        Q_ASSERT(payload.size() <= 125);
-        frame.append(payload);
-        m_pSocket->write(frame);
+        QWebSocketFrame::writeFrame(m_pSocket, QWebSocketProtocol::OpCodeClose,
+                                    QByteArrayView(payload, 2 + reasonUtf8.size()),
+                                    maskingKey, true);
         m_pSocket->flush();
 
         m_isClosingHandshakeSent = true;
@@ -442,11 +485,15 @@ void QWebSocketPrivate::open(const QNetworkRequest &request,
         m_pSocket->deleteLater();
         m_pSocket = nullptr;
     }
+    clearOutgoingMessages();
     //if (m_url != url)
     if (Q_LIKELY(!m_pSocket)) {
         m_dataProcessor->clear();
+        m_pendingInput.clear();
+        m_pendingInputPosition = 0;
         m_isClosingHandshakeReceived = false;
         m_isClosingHandshakeSent = false;
+        m_isHandshakeRequestSent = false;
 
         setRequest(request, options);
         if (url.path().isEmpty())
@@ -500,7 +547,9 @@ void QWebSocketPrivate::open(const QNetworkRequest &request,
                     sslSocket->setProxy(m_configuration.m_proxy);
                     m_pSocket->setProtocolTag(QStringLiteral("https"));
     #endif
-                    sslSocket->connectToHostEncrypted(url.host(), quint16(url.port(443)));
+                    if (m_clientContext)
+                        makeClientContextConnections();
+                    connectToHost(url);
                 } else {
                     const QString message = QWebSocket::tr("Out of memory.");
                     setErrorString(message);
@@ -525,7 +574,9 @@ void QWebSocketPrivate::open(const QNetworkRequest &request,
                 m_pSocket->setProxy(m_configuration.m_proxy);
                 m_pSocket->setProtocolTag(QStringLiteral("http"));
     #endif
-                m_pSocket->connectToHost(url.host(), quint16(url.port(80)));
+                if (m_clientContext)
+                    makeClientContextConnections();
+                connectToHost(url);
             } else {
                 const QString message = QWebSocket::tr("Out of memory.");
                 setErrorString(message);
@@ -547,19 +598,15 @@ void QWebSocketPrivate::open(const QNetworkRequest &request,
  */
 void QWebSocketPrivate::ping(const QByteArray &payload)
 {
-    QByteArray payloadTruncated = payload.left(125);
     m_pingTimer.restart();
+    if (Q_UNLIKELY(!m_pSocket))
+        return;
     quint32 maskingKey = 0;
     if (m_mustMask)
         maskingKey = generateMaskingKey();
-    QByteArray pingFrame = getFrameHeader(QWebSocketProtocol::OpCodePing,
-                                          quint64(payloadTruncated.size()),
-                                          maskingKey, true);
-    if (m_mustMask)
-        QWebSocketProtocol::mask(&payloadTruncated, maskingKey);
-    pingFrame.append(payloadTruncated);
-    qint64 ret = writeFrame(pingFrame);
-    Q_UNUSED(ret);
+    QWebSocketFrame::writeFrame(m_pSocket, QWebSocketProtocol::OpCodePing,
+                                QByteArrayView(payload).first(qMin(payload.size(), qsizetype(125))),
+                                maskingKey, true);
 }
 
 /*!
@@ -622,6 +669,17 @@ void QWebSocketPrivate::setExtension(const QString &extension)
         m_extension = extension;
 }
 
+/*!
+  \internal
+  Sets the negotiated \a extensions, which encode the messages sent from now
+  on and decode the messages received.
+ */
+void QWebSocketPrivate::setActiveExtensions(const QList<QPointer<QWebSocketExtension>> &extensions)
+{
+    m_extensions = extensions;
+    m_dataProcessor->setExtensions(extensions);
+}
+
 /*!
   \internal
  */
@@ -661,6 +719,7 @@ void QWebSocketPrivate::makeConnections(QTcpSocket *pTcpSocket)
                                 &QWebSocketPrivate::processData);
 #ifndef QT_NO_SSL
         const QSslSocket * const sslSocket = qobject_cast<const QSslSocket *>(pTcpSocket);
+        m_coalesceFrames = sslSocket != nullptr;
         if (sslSocket) {
             QObject::connect(sslSocket, &QSslSocket::preSharedKeyAuthenticationRequired, q,
                              &QWebSocket::preSharedKeyAuthenticationRequired);
@@ -682,12 +741,16 @@ void QWebSocketPrivate::makeConnections(QTcpSocket *pTcpSocket)
                              q, &QWebSocket::alertReceived);
             QObject::connect(sslSocket, &QSslSocket::handshakeInterruptedOnError,
                              q, &QWebSocket::handshakeInterruptedOnError);
+            QObjectPrivate::connect(sslSocket, &QSslSocket::encryptedBytesWritten,
+                                    this, &QWebSocketPrivate::processBytesWritten);
         } else
 #endif // QT_NO_SSL
         {
             QObject::connect(pTcpSocket, &QAbstractSocket::bytesWritten, q,
                              &QWebSocket::bytesWritten);
         }
+        QObjectPrivate::connect(pTcpSocket, &QAbstractSocket::bytesWritten,
+                                this, &QWebSocketPrivate::processBytesWritten);
     }
 
     QObject::connect(m_dataProcessor, &QWebSocketDataProcessor::textFrameReceived, q,
@@ -698,6 +761,8 @@ void QWebSocketPrivate::makeConnections(QTcpSocket *pTcpSocket)
                      &QWebSocket::binaryMessageReceived);
     QObject::connect(m_dataProcessor, &QWebSocketDataProcessor::textMessageReceived, q,
                      &QWebSocket::textMessageReceived);
+    QObjectPrivate::connect(m_dataProcessor, &QWebSocketDataProcessor::dataFrameReceived, this,
+                            &QWebSocketPrivate::relayFrame);
     QObjectPrivate::connect(m_dataProcessor, &QWebSocketDataProcessor::errorEncountered, this,
                             &QWebSocketPrivate::close);
     QObjectPrivate::connect(m_dataProcessor, &QWebSocketDataProcessor::pingReceived, this,
@@ -707,9 +772,123 @@ void QWebSocketPrivate::makeConnections(QTcpSocket *pTcpSocket)
     QObjectPrivate::connect(m_dataProcessor, &QWebSocketDataProcessor::closeReceived, this,
                             &QWebSocketPrivate::processClose);
 
-    //fire readyread, in case we already have data inside the tcpSocket
+    // process the data already inside the tcpSocket, e.g. messages a client
+    // pipelined behind its handshake request, once the server has handed out
+    // the connection and its signals could be connected
     if (pTcpSocket->bytesAvailable())
-        Q_EMIT pTcpSocket->readyRead();
+        QMetaObject::invokeMethod(q, [this]() { processData(); }, Qt::QueuedConnection);
+}
+
+/*!
+ * \internal
+ * Lets the client context learn the address and the TLS session of the
+ * connection.
+ */
+void QWebSocketPrivate::makeClientContextConnections()
+{
+    Q_Q(QWebSocket);
+    QObject::connect(m_pSocket, &QAbstractSocket::connected, q, [this]() {
+        if (m_clientContext && m_canCacheAddress && !m_isUsingCachedAddress) {
+            QWebSocketClientContextPrivate::get(m_clientContext)
+                    ->cacheAddress(m_request.url().host(), m_pSocket->peerAddress());
+        }
+    });
+    QObject::connect(m_pSocket, &QAbstractSocket::errorOccurred, q, [this]() {
+        // the host may have moved since the address was cached
+        if (m_clientContext && m_isUsingCachedAddress && !m_isHandshakeRequestSent)
+            QWebSocketClientContextPrivate::get(m_clientContext)->dropAddress(m_request.url().host());
+    });
+#ifndef QT_NO_SSL
+    if (QSslSocket *sslSocket = qobject_cast<QSslSocket *>(m_pSocket)) {
+        QObject::connect(sslSocket,
+                         QOverload<const QList<QSslError>&>::of(&QSslSocket::sslErrors),
+                         q, [this]() { m_hasSslErrors = true; });
+        // with TLS 1.3, tickets arrive after the handshake
+        const auto storeSessionTicket = [this, sslSocket]() {
+            // a session with a server that was not verified must not be
+            // offered to connections that do verify it
+            if (!m_clientContext || m_hasSslErrors || m_configuration.m_ignoreSslErrors
+                || !m_configuration.m_ignoredSslErrors.isEmpty()) {
+                return;
+            }
+            QWebSocketClientContextPrivate::get(m_clientContext)
+                    ->storeSessionTicket(QWebSocketClientContextPrivate::sessionKey(m_request.url()),
+                                         sslSocket->sslConfiguration().sessionTicket());
+        };
+        QObject::connect(sslSocket, &QSslSocket::encrypted, q, storeSessionTicket);
+        QObject::connect(sslSocket, &QSslSocket::newSessionTicketReceived, q, storeSessionTicket);
+    }
+#endif
+}
+
+/*!
+ * \internal
+ * Connects the socket to the host of \a url. With a client context, a
+ * recently resolved address of the host is used, and a TLS session with
+ * the host is offered for resumption. When \a isReconnecting, e.g. to
+ * answer an authentication challenge, the connection is not counted again.
+ */
+void QWebSocketPrivate::connectToHost(const QUrl &url, bool isReconnecting)
+{
+#ifndef QT_NO_SSL
+    QSslSocket *sslSocket = qobject_cast<QSslSocket *>(m_pSocket);
+    const quint16 port = quint16(url.port(sslSocket ? 443 : 80));
+#else
+    const quint16 port = quint16(url.port(80));
+#endif
+    const QString hostName = url.host();
+    QString address = hostName;
+    m_canCacheAddress = false;
+    m_isUsingCachedAddress = false;
+    m_hasSslErrors = false;
+    if (m_clientContext) {
+        QWebSocketClientContextPrivate *context =
+                QWebSocketClientContextPrivate::get(m_clientContext);
+        // behind a proxy, the peer address is the one of the proxy
+        m_canCacheAddress = QHostAddress(hostName).isNull();
+#ifndef QT_NO_NETWORKPROXY
+        QNetworkProxy proxy = m_configuration.m_proxy;
+        if (proxy.type() == QNetworkProxy::DefaultProxy) {
+            const QNetworkProxyQuery query(hostName, port, m_pSocket->protocolTag());
+            proxy = QNetworkProxyFactory::proxyForQuery(query).value(0);
+        }
+        m_canCacheAddress = m_canCacheAddress && proxy.type() == QNetworkProxy::NoProxy;
+#endif
+        if (m_canCacheAddress) {
+            const QHostAddress cachedAddress = context->cachedAddress(hostName);
+            if (!cachedAddress.isNull()) {
+                address = cachedAddress.toString();
+                m_isUsingCachedAddress = true;
+            }
+        }
+        bool isResumingSession = false;
+#ifndef QT_NO_SSL
+        if (sslSocket) {
+            QSslConfiguration configuration = sslSocket->sslConfiguration();
+            configuration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+            const QByteArray ticket =
+                    context->sessionTicket(QWebSocketClientContextPrivate::sessionKey(url));
+            if (!ticket.isEmpty()) {
+                configuration.setSessionTicket(ticket);
+                isResumingSession = true;
+            }
+            sslSocket->setSslConfiguration(configuration);
+        }
+        if (!isReconnecting)
+            context->noteConnection(sslSocket != nullptr, isResumingSession);
+#else
+        if (!isReconnecting)
+            context->noteConnection(false, isResumingSession);
+#endif
+    }
+#ifndef QT_NO_SSL
+    if (sslSocket) {
+        // the certificate is still verified against the host name
+        sslSocket->connectToHostEncrypted(address, port, hostName);
+        return;
+    }
+#endif
+    m_pSocket->connectToHost(address, port);
 }
 
 /*!
@@ -796,117 +975,589 @@ QString QWebSocketPrivate::closeReason() const
 
 /*!
  * \internal
+ * Returns \c true if messages can be queued: once connected, or while
+ * connecting if message pipelining is enabled.
+ */
+bool QWebSocketPrivate::canSendMessages() const
+{
+    if (Q_UNLIKELY(!m_pSocket))
+        return false;
+    const QAbstractSocket::SocketState socketState = state();
+    return Q_LIKELY(socketState == QAbstractSocket::ConnectedState)
+            || (socketState == QAbstractSocket::ConnectingState
+                && m_options.isMessagePipeliningEnabled());
+}
+
+/*!
+ * \internal
+ */
+qint64 QWebSocketPrivate::doWriteFrames(const QByteArray &data, bool isBinary,
+                                        QWebSocket::MessagePriority priority)
+{
+    if (!canSendMessages())
+        return 0;
+
+    OutgoingMessage message;
+    message.payload = data;
+    message.size = data.size();
+    message.opCode = isBinary ? QWebSocketProtocol::OpCodeBinary
+                              : QWebSocketProtocol::OpCodeText;
+    encodeMessage(message);
+    enqueueMessage(std::move(message), priority);
+    return data.size();
+}
+
+/*!
+ * \internal
+ * Queues \a data for all \a recipients that are connected, and returns their
+ * number. The message is encoded once for all recipients that negotiated the
+ * same extensions, and they all share the encoded payload.
+ */
+qsizetype QWebSocketPrivate::broadcastMessage(const QByteArray &data, bool isBinary,
+                                              const QList<QWebSocket *> &recipients)
+{
+    // recipients typically negotiated the same extensions, so there are few
+    // distinct encodings
+    QList<std::pair<QList<QPointer<QWebSocketExtension>>, OutgoingMessage>> encodings;
+    qsizetype count = 0;
+    for (QWebSocket *recipient : recipients) {
+        if (Q_UNLIKELY(!recipient))
+            continue;
+        QWebSocketPrivate *d = recipient->d_func();
+        if (Q_UNLIKELY(!d->m_pSocket) || d->state() != QAbstractSocket::ConnectedState)
+            continue;
+        auto it = std::find_if(encodings.cbegin(), encodings.cend(),
+                               [d](const auto &encoding) {
+            return encoding.first == d->m_extensions;
+        });
+        if (it == encodings.cend()) {
+            OutgoingMessage message;
+            message.payload = data;
+            message.size = data.size();
+            message.opCode = isBinary ? QWebSocketProtocol::OpCodeBinary
+                                      : QWebSocketProtocol::OpCodeText;
+            d->encodeMessage(message);
+            encodings.emplaceBack(d->m_extensions, std::move(message));
+            it = std::prev(encodings.cend());
+        }
+        OutgoingMessage message = it->second;
+        d->enqueueMessage(std::move(message), QWebSocket::NormalPriority);
+        ++count;
+    }
+    return count;
+}
+
+/*!
+ * \internal
+ * Lets the negotiated extensions encode the payload of \a message, in order.
+ * An extension that does not encode the payload, e.g. because it would not
+ * get smaller, does not set its reserved bits.
+ */
+void QWebSocketPrivate::encodeMessage(OutgoingMessage &message) const
+{
+    if (Q_LIKELY(m_extensions.isEmpty()))
+        return;
+    for (const QPointer<QWebSocketExtension> &extension : m_extensions) {
+        if (!extension)
+            continue;
+        QByteArray encoded;
+        if (!extension->encode(message.payload, &encoded))
+            continue;
+        message.payload = std::move(encoded);
+        message.reservedBits |= quint8(extension->reservedBits().toInt());
+    }
+    message.size = message.payload.size();
+}
+
+#ifndef Q_OS_WASM
+
+/*!
+ * \internal
+ */
+qint64 QWebSocketPrivate::sendFile(QFile *file, qint64 offset, qint64 length)
+{
+    if (Q_UNLIKELY(!file || !file->isReadable() || file->isSequential() || offset < 0))
+        return -1;
+    const qint64 fileSize = file->size();
+    if (length < 0)
+        length = fileSize - offset;
+    if (Q_UNLIKELY(length < 0 || offset > fileSize - length))
+        return -1;
+    if (!canSendMessages())
+        return 0;
+
+    OutgoingMessage message;
+    message.file = file;
+    message.isFile = true;
+    message.fileOffset = offset;
+    message.size = length;
+    message.opCode = QWebSocketProtocol::OpCodeBinary;
+    enqueueMessage(std::move(message), QWebSocket::NormalPriority);
+    return length;
+}
+
+#endif
+
+/*!
+ * \internal
+ * Queues a message for sending; can be called from any thread. The socket's
+ * thread is only woken up if it has not been already, and then picks up all
+ * messages posted until then at once.
+ */
+void QWebSocketPrivate::postMessage(const QByteArray &data, bool isBinary)
+{
+    if (m_postedMessages.push({ data, isBinary })) {
+        Q_Q(QWebSocket);
+        QMetaObject::invokeMethod(q, [this]() { processPostedMessages(); }, Qt::QueuedConnection);
+    }
+}
+
+/*!
+ * \internal
+ */
+void QWebSocketPrivate::processPostedMessages()
+{
+    m_postedMessages.acknowledgeWakeup();
+    while (std::optional<QWebSocketMessageQueue::Message> posted = m_postedMessages.pop()) {
+#ifdef Q_OS_WASM
+        if (posted->isBinary)
+            sendBinaryMessage(posted->payload);
+        else
+            sendTextMessage(QString::fromUtf8(posted->payload));
+#else
+        if (!canSendMessages())
+            continue;
+        OutgoingMessage message;
+        message.payload = std::move(posted->payload);
+        message.size = message.payload.size();
+        message.opCode = posted->isBinary ? QWebSocketProtocol::OpCodeBinary
+                                          : QWebSocketProtocol::OpCodeText;
+        encodeMessage(message);
+        m_queuedBytes += message.size;
+        m_normalPriorityMessages.enqueue(std::move(message));
+#endif
+    }
+#ifndef Q_OS_WASM
+    writeQueuedFrames();
+    updateMemoryUsage();
+#endif
+}
+
+/*!
+ * \internal
+ * Relays the frames received from now on to \a target, see
+ * QWebSocket::setRelayTarget().
  */
-QByteArray QWebSocketPrivate::getFrameHeader(QWebSocketProtocol::OpCode opCode,
-                                             quint64 payloadLength, quint32 maskingKey,
-                                             bool lastFrame)
-{
-    QByteArray header;
-    bool ok = payloadLength <= 0x7FFFFFFFFFFFFFFFULL;
-
-    if (Q_LIKELY(ok)) {
-        //FIN, RSV1-3, opcode (RSV-1, RSV-2 and RSV-3 are zero)
-        quint8 byte = static_cast<quint8>((opCode & 0x0F) | (lastFrame ? 0x80 : 0x00));
-        header.append(static_cast<char>(byte));
-
-        byte = 0x00;
-        if (maskingKey != 0)
-            byte |= 0x80;
-        if (payloadLength <= 125) {
-            byte |= static_cast<quint8>(payloadLength);
-            header.append(static_cast<char>(byte));
-        } else if (payloadLength <= 0xFFFFU) {
-            byte |= 126;
-            header.append(static_cast<char>(byte));
-            quint16 swapped = qToBigEndian<quint16>(static_cast<quint16>(payloadLength));
-            header.append(static_cast<const char *>(static_cast<const void *>(&swapped)), 2);
-        } else if (payloadLength <= 0x7FFFFFFFFFFFFFFFULL) {
-            byte |= 127;
-            header.append(static_cast<char>(byte));
-            quint64 swapped = qToBigEndian<quint64>(payloadLength);
-            header.append(static_cast<const char *>(static_cast<const void *>(&swapped)), 8);
+void QWebSocketPrivate::setRelayTarget(QWebSocket *target)
+{
+    Q_Q(QWebSocket);
+    if (m_relayTarget == target)
+        return;
+    if (Q_UNLIKELY(target && target->thread() != q->thread())) {
+        qWarning("QWebSocket::setRelayTarget: the target must live in the same thread");
+        return;
+    }
+    QObject::disconnect(m_relayTargetConnections[0]);
+    QObject::disconnect(m_relayTargetConnections[1]);
+    m_relayTarget = target;
+    m_dataProcessor->setPassthrough(target != nullptr);
+    m_relayedMessage.clear();
+    if (target) {
+        m_relayTargetConnections[0] = QObject::connect(target, &QWebSocket::bytesWritten, q,
+                                                       [this]() { resumeRelay(); });
+        m_relayTargetConnections[1] = QObject::connect(target, &QObject::destroyed, q,
+                                                       [this]() { resumeRelay(); });
+    }
+    // frames may have been held back for the previous target
+    resumeRelay();
+}
+
+/*!
+ * \internal
+ */
+QWebSocket *QWebSocketPrivate::relayTarget() const
+{
+    return m_relayTarget;
+}
+
+/*!
+ * \internal
+ * Hands a data frame received in passthrough mode to the relay target.
+ * The message is only assembled if someone listens to messageRelayed().
+ */
+void QWebSocketPrivate::relayFrame(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                                   bool isLastFrame)
+{
+    Q_Q(QWebSocket);
+    static const QMetaMethod messageRelayedSignal =
+            QMetaMethod::fromSignal(&QWebSocket::messageRelayed);
+    if (q->isSignalConnected(messageRelayedSignal)) {
+        if (opCode != QWebSocketProtocol::OpCodeContinue)
+            m_isRelayedMessageBinary = opCode == QWebSocketProtocol::OpCodeBinary;
+        m_relayedMessage.append(payload);
+        if (isLastFrame) {
+            const QByteArray message = std::exchange(m_relayedMessage, QByteArray());
+            Q_EMIT q->messageRelayed(message, m_isRelayedMessageBinary);
         }
+    }
+    // without a target, or if it has been moved to another thread since, the
+    // frames are dropped
+    if (Q_LIKELY(m_relayTarget && m_relayTarget->thread() == q->thread()))
+        m_relayTarget->d_func()->enqueueRelayedFrame(opCode, payload, isLastFrame);
+}
 
-        if (maskingKey != 0) {
-            const quint32 mask = qToBigEndian<quint32>(maskingKey);
-            header.append(static_cast<const char *>(static_cast<const void *>(&mask)),
-                          sizeof(quint32));
+/*!
+ * \internal
+ * Queues a frame relayed from another QWebSocket. The payload is shared with
+ * the source and masked, if need be, while the frame is written. If this
+ * socket negotiated extensions, the frames are assembled and the message is
+ * encoded by them once it is complete.
+ */
+void QWebSocketPrivate::enqueueRelayedFrame(QWebSocketProtocol::OpCode opCode,
+                                            const QByteArray &payload, bool isLastFrame)
+{
+    if (Q_UNLIKELY(!m_pSocket) || (state() != QAbstractSocket::ConnectedState))
+        return;
+    OutgoingMessage message;
+    if (Q_UNLIKELY(!m_extensions.isEmpty())) {
+        if (opCode != QWebSocketProtocol::OpCodeContinue)
+            m_relayedOpCodeToEncode = opCode;
+        m_relayedMessageToEncode.append(payload);
+        m_queuedBytes += payload.size();
+        if (!isLastFrame) {
+            updateMemoryUsage();
+            return;
         }
+        message.payload = std::exchange(m_relayedMessageToEncode, QByteArray());
+        message.opCode = m_relayedOpCodeToEncode;
+        m_queuedBytes -= message.payload.size();
+        encodeMessage(message);
     } else {
-        setErrorString(QStringLiteral("WebSocket::getHeader: payload too big!"));
-        emitErrorOccurred(QAbstractSocket::DatagramTooLargeError);
+        message.payload = payload;
+        message.opCode = opCode;
+        message.isFinal = isLastFrame;
     }
+    message.size = message.payload.size();
+    m_queuedBytes += message.size;
+    m_relayedMessages.enqueue(std::move(message));
+    writeQueuedFrames();
+    updateMemoryUsage();
+}
 
-    return header;
+/*!
+ * \internal
+ * Returns \c true if the relay target has so much to write that reading
+ * should pause.
+ */
+bool QWebSocketPrivate::isRelayBackedUp() const
+{
+    Q_Q(const QWebSocket);
+    return m_relayTarget && m_relayTarget->thread() == q->thread()
+            && m_relayTarget->bytesToWrite() > MAX_RELAY_BACKLOG_IN_BYTES;
 }
 
 /*!
  * \internal
+ * Continues reading once the relay target has caught up.
  */
-qint64 QWebSocketPrivate::doWriteFrames(const QByteArray &data, bool isBinary)
+void QWebSocketPrivate::resumeRelay()
 {
-    qint64 payloadWritten = 0;
-    if (Q_UNLIKELY(!m_pSocket) || (state() != QAbstractSocket::ConnectedState))
-        return payloadWritten;
-
-    const QWebSocketProtocol::OpCode firstOpCode = isBinary ?
-                QWebSocketProtocol::OpCodeBinary : QWebSocketProtocol::OpCodeText;
-
-    int numFrames = data.size() / int(outgoingFrameSize());
-    QByteArray tmpData(data);
-    tmpData.detach();
-    char *payload = tmpData.data();
-    quint64 sizeLeft = quint64(data.size()) % outgoingFrameSize();
-    if (Q_LIKELY(sizeLeft))
-        ++numFrames;
-
-    //catch the case where the payload is zero bytes;
-    //in this case, we still need to send a frame
-    if (Q_UNLIKELY(numFrames == 0))
-        numFrames = 1;
-    quint64 currentPosition = 0;
-    quint64 bytesLeft = quint64(data.size());
-
-    for (int i = 0; i < numFrames; ++i) {
-        quint32 maskingKey = 0;
-        if (m_mustMask)
-            maskingKey = generateMaskingKey();
+    if (m_isRelayPaused && !isRelayBackedUp()) {
+        m_isRelayPaused = false;
+        processData();
+    }
+}
 
-        const bool isLastFrame = (i == (numFrames - 1));
-        const bool isFirstFrame = (i == 0);
+/*!
+ * \internal
+ * Makes the socket report the memory it holds to \a budget, replacing the
+ * budget it reported to before.
+ */
+void QWebSocketPrivate::setMemoryBudget(std::shared_ptr<QWebSocketMemoryBudget> budget)
+{
+    if (m_memoryBudget == budget)
+        return;
+    if (m_memoryBudget)
+        m_memoryBudget->removeConnection(this, m_memoryUsage.exchange(0));
+    m_memoryBudget = std::move(budget);
+    m_dataProcessor->setMemoryBudget(m_memoryBudget.get());
+    if (m_memoryBudget) {
+        m_memoryBudget->addConnection(this);
+        updateMemoryUsage();
+    } else if (m_isReadingPausedForMemoryBudget) {
+        // not processing the data here, as this is also called on destruction
+        m_isReadingPausedForMemoryBudget = false;
+        if (m_pSocket && !m_isReadingDelayedForRateLimit)
+            m_pSocket->setReadBufferSize(m_readBufferSize);
+    }
+}
 
-        const quint64 size = qMin(bytesLeft, outgoingFrameSize());
-        const QWebSocketProtocol::OpCode opcode = isFirstFrame ? firstOpCode
-                                                               : QWebSocketProtocol::OpCodeContinue;
+/*!
+ * \internal
+ * Reports a change of the memory held by this socket to the budget: the
+ * message being assembled, the data received but not parsed yet, and the
+ * data waiting to be written.
+ */
+void QWebSocketPrivate::updateMemoryUsage()
+{
+    if (Q_LIKELY(!m_memoryBudget))
+        return;
+    const qint64 usage = m_dataProcessor->bufferedBytes()
+            + (m_pSocket ? m_pSocket->bytesAvailable() + socketBytesToWrite() : 0)
+            + m_queuedBytes + m_pendingInput.size() - m_pendingInputPosition;
+    const qint64 previousUsage = m_memoryUsage.exchange(usage, std::memory_order_relaxed);
+    if (usage != previousUsage)
+        m_memoryBudget->update(this, usage, usage - previousUsage);
+}
 
-        //write header
-        m_pSocket->write(getFrameHeader(opcode, size, maskingKey, isLastFrame));
+/*!
+ * \internal
+ * Continues reading once the memory budget allows it again.
+ */
+void QWebSocketPrivate::resumeReadingForMemoryBudget()
+{
+    if (!m_isReadingPausedForMemoryBudget)
+        return;
+    m_isReadingPausedForMemoryBudget = false;
+    if (m_pSocket) {
+        if (!m_isReadingDelayedForRateLimit)
+            m_pSocket->setReadBufferSize(m_readBufferSize);
+        processData();
+    }
+}
+
+/*!
+ * \internal
+ * Closes the socket to give back the memory it holds, as the budget of the
+ * server has been exceeded. What has not been written yet is dropped, as is
+ * the message being received.
+ */
+void QWebSocketPrivate::closeForMemoryBudget()
+{
+    clearOutgoingMessages();
+    close(QWebSocketProtocol::CloseCodeTooMuchData,
+          QWebSocket::tr("Memory budget of the server exceeded."));
+    // the message being received cannot be completed anymore
+    m_dataProcessor->clear();
+    m_pendingInput.clear();
+    m_pendingInputPosition = 0;
+    updateMemoryUsage();
+}
+
+/*!
+ * \internal
+ */
+void QWebSocketPrivate::enqueueMessage(OutgoingMessage &&message,
+                                       QWebSocket::MessagePriority priority)
+{
+    m_queuedBytes += message.size;
+    if (priority == QWebSocket::HighPriority)
+        m_highPriorityMessages.enqueue(std::move(message));
+    else
+        m_normalPriorityMessages.enqueue(std::move(message));
+    writeQueuedFrames();
+    updateMemoryUsage();
+}
 
-        //write payload
-        if (Q_LIKELY(size > 0)) {
-            char *currentData = payload + currentPosition;
-            if (m_mustMask)
-                QWebSocketProtocol::mask(currentData, size, maskingKey);
-            qint64 written = m_pSocket->write(currentData, static_cast<qint64>(size));
-            if (Q_LIKELY(written > 0)) {
-                payloadWritten += written;
+/*!
+ * \internal
+ * Cuts the queued messages into frames of at most outgoingFrameSize() bytes
+ * and hands them to the socket. Unless \a drain is \c true, a frame is only
+ * written while the socket holds less than one frame, so that a control frame
+ * never waits for more than one data frame.
+ */
+void QWebSocketPrivate::writeQueuedFrames(bool drain)
+{
+    // pipelined messages must follow the handshake request
+    if (Q_UNLIKELY(state() == QAbstractSocket::ConnectingState && !m_isHandshakeRequestSent))
+        return;
+    const qint64 frameSize = qint64(outgoingFrameSize());
+    while (m_pSocket && (drain || socketBytesToWrite() < frameSize)) {
+        if (!m_currentOutgoingMessage) {
+            if (m_isRelayedMessageOpen) {
+                // the rest of the relayed message has not arrived yet
+                if (m_relayedMessages.isEmpty())
+                    break;
+                m_currentOutgoingMessage = m_relayedMessages.dequeue();
+            } else if (!m_highPriorityMessages.isEmpty()) {
+                m_currentOutgoingMessage = m_highPriorityMessages.dequeue();
+            } else if (!m_normalPriorityMessages.isEmpty()) {
+                m_currentOutgoingMessage = m_normalPriorityMessages.dequeue();
+            } else if (!m_relayedMessages.isEmpty()) {
+                m_currentOutgoingMessage = m_relayedMessages.dequeue();
             } else {
-                m_pSocket->flush();
-                setErrorString(QWebSocket::tr("Error writing bytes to socket: %1.")
-                               .arg(m_pSocket->errorString()));
-                emitErrorOccurred(QAbstractSocket::NetworkError);
                 break;
             }
         }
-        currentPosition += size;
-        bytesLeft -= size;
+        OutgoingMessage &message = *m_currentOutgoingMessage;
+        const qint64 size = qMin(message.size - message.offset, frameSize);
+        const bool isLastFrame = message.offset + size == message.size;
+        const QWebSocketProtocol::OpCode opCode =
+                message.offset == 0 ? message.opCode : QWebSocketProtocol::OpCodeContinue;
+        quint32 maskingKey = 0;
+        if (m_mustMask)
+            maskingKey = generateMaskingKey();
+
+        qint64 written = -1;
+        bool isReadError = false;
+        if (!message.isFile) {
+            //the payload is masked while the frame is assembled, so data is never modified
+            written = QWebSocketFrame::writeFrame(
+                        m_pSocket, opCode,
+                        QByteArrayView(message.payload).sliced(message.offset, qsizetype(size)),
+                        maskingKey, isLastFrame && message.isFinal, m_coalesceFrames,
+                        message.offset == 0 ? message.reservedBits : quint8(0));
+        } else if (Q_LIKELY(message.file)) {
+            written = writeFileFrame(message.file, message.fileOffset + message.offset, size,
+                                     opCode, maskingKey, isLastFrame, &isReadError);
+        } else {
+            isReadError = true;
+        }
+        if (Q_UNLIKELY(isReadError)) {
+            // the rest of the message cannot be sent, and the peer would take
+            // whatever comes next for a part of it
+            clearOutgoingMessages();
+            setErrorString(QWebSocket::tr("Error reading the file being sent."));
+            emitErrorOccurred(QAbstractSocket::UnknownSocketError);
+            if (m_pSocket)
+                m_pSocket->abort();
+            return;
+        }
+        if (Q_UNLIKELY(written < 0 || written != size)) {
+            clearOutgoingMessages();
+            m_pSocket->flush();
+            setErrorString(QWebSocket::tr("Error writing bytes to socket: %1.")
+                           .arg(m_pSocket->errorString()));
+            emitErrorOccurred(QAbstractSocket::NetworkError);
+            return;
+        }
+        message.offset += size;
+        m_queuedBytes -= size;
+        if (isLastFrame) {
+            m_isRelayedMessageOpen = !message.isFinal;
+            m_currentOutgoingMessage.reset();
+        }
     }
-    if (Q_UNLIKELY(payloadWritten != data.size())) {
-        setErrorString(QWebSocket::tr("Bytes written %1 != %2.")
-                       .arg(payloadWritten).arg(data.size()));
-        emitErrorOccurred(QAbstractSocket::NetworkError);
+}
+
+/*!
+ * \internal
+ * Writes a frame carrying \a size bytes of \a file, starting at \a position,
+ * and returns the number of payload bytes written, or -1 on error.
+ * \a isReadError is set if the file could not be read.
+ *
+ * On Linux, unmasked frames are moved from the file to an unencrypted socket
+ * with sendfile() while the write buffer of the socket is empty; whatever the
+ * kernel does not take goes through the write buffer like any other frame.
+ * These bytes are not reported by the bytesWritten() signal.
+ */
+qint64 QWebSocketPrivate::writeFileFrame(QFile *file, qint64 position, qint64 size,
+                                         QWebSocketProtocol::OpCode opCode, quint32 maskingKey,
+                                         bool isLastFrame, bool *isReadError)
+{
+    qint64 sent = 0;
+    bool isHeaderWritten = false;
+#ifdef Q_OS_LINUX
+    const qintptr descriptor = m_pSocket->socketDescriptor();
+    if (maskingKey == 0 && !m_coalesceFrames && descriptor != -1 && file->handle() != -1
+            && m_pSocket->bytesToWrite() == 0) {
+        char header[QWebSocketFrame::MaxHeaderSize];
+        const qsizetype headerSize = QWebSocketFrame::encodeHeader(header, opCode, quint64(size),
+                                                                   0, isLastFrame);
+        // errors are left to the socket, which sees them on its next write or read
+        const qsizetype headerSent = qMax(::send(int(descriptor), header, size_t(headerSize),
+                                                 MSG_NOSIGNAL | MSG_DONTWAIT | MSG_MORE),
+                                          ssize_t(0));
+        if (headerSent == headerSize) {
+            while (sent < size) {
+                off_t fileOffset = off_t(position + sent);
+                const ssize_t n = ::sendfile(int(descriptor), file->handle(), &fileOffset,
+                                             size_t(size - sent));
+                if (n <= 0)
+                    break;
+                sent += n;
+            }
+            if (sent == size)
+                return size;
+        } else if (m_pSocket->write(header + headerSent, headerSize - headerSent)
+                   != headerSize - headerSent) {
+            return -1;
+        }
+        isHeaderWritten = true;
     }
-    return payloadWritten;
+#endif
+
+    // the rest of the frame goes through a pooled buffer
+    QByteArray buffer = QWebSocketBufferPool::acquireBytes(qsizetype(size - sent));
+    if (Q_UNLIKELY(!file->seek(position + sent)
+                   || file->read(buffer.data(), buffer.size()) != buffer.size())) {
+        QWebSocketBufferPool::releaseBytes(buffer);
+        *isReadError = true;
+        return -1;
+    }
+    qint64 written;
+    if (isHeaderWritten) {
+        written = m_pSocket->write(buffer.constData(), buffer.size());
+    } else {
+        written = QWebSocketFrame::writeFrame(m_pSocket, opCode, buffer, maskingKey, isLastFrame,
+                                              m_coalesceFrames);
+    }
+    QWebSocketBufferPool::releaseBytes(buffer);
+    return written < 0 ? written : sent + written;
+}
+
+/*!
+ * \internal
+ */
+void QWebSocketPrivate::processBytesWritten()
+{
+    m_hasWrittenSinceTrim = true;
+    noteActivity();
+    writeQueuedFrames();
+    updateMemoryUsage();
+}
+
+/*!
+ * \internal
+ */
+void QWebSocketPrivate::clearOutgoingMessages()
+{
+    m_currentOutgoingMessage.reset();
+    m_highPriorityMessages.clear();
+    m_normalPriorityMessages.clear();
+    m_relayedMessages.clear();
+    m_relayedMessageToEncode.clear();
+    m_isRelayedMessageOpen = false;
+    m_queuedBytes = 0;
+}
+
+/*!
+ * \internal
+ * Returns the number of bytes the socket still has to write, including the
+ * ones that have been encrypted but not sent yet.
+ */
+qint64 QWebSocketPrivate::socketBytesToWrite() const
+{
+    qint64 bytes = m_pSocket->bytesToWrite();
+#ifndef QT_NO_SSL
+    if (const QSslSocket *sslSocket = qobject_cast<const QSslSocket *>(m_pSocket))
+        bytes += sslSocket->encryptedBytesToWrite();
+#endif
+    return bytes;
+}
+
+/*!
+    \internal
+ */
+QMaskGenerator *QWebSocketPrivate::activeMaskGenerator() const
+{
+    if (m_pMaskGenerator)
+        return m_pMaskGenerator;
+    if (!m_defaultMaskGenerator) {
+        m_defaultMaskGenerator = std::make_unique<QDefaultMaskGenerator>();
+        m_defaultMaskGenerator->seed();
+    }
+    return m_defaultMaskGenerator.get();
 }
 
 /*!
@@ -914,7 +1565,7 @@ qint64 QWebSocketPrivate::doWriteFrames(const QByteArray &data, bool isBinary)
  */
 quint32 QWebSocketPrivate::generateMaskingKey() const
 {
-    return m_pMaskGenerator->nextMask();
+    return activeMaskGenerator()->nextMask();
 }
 
 /*!
@@ -925,7 +1576,7 @@ QByteArray QWebSocketPrivate::generateKey() const
     QByteArray key;
 
     for (int i = 0; i < 4; ++i) {
-        const quint32 tmp = m_pMaskGenerator->nextMask();
+        const quint32 tmp = activeMaskGenerator()->nextMask();
         key.append(static_cast<const char *>(static_cast<const void *>(&tmp)), sizeof(quint32));
     }
 
@@ -943,31 +1594,6 @@ QString QWebSocketPrivate::calculateAcceptKey(const QByteArray &key) const
     return QString::fromLatin1(hash);
 }
 
-/*!
-    \internal
- */
-qint64 QWebSocketPrivate::writeFrames(const QList<QByteArray> &frames)
-{
-    qint64 written = 0;
-    if (Q_LIKELY(m_pSocket)) {
-        QList<QByteArray>::const_iterator it;
-        for (it = frames.cbegin(); it < frames.cend(); ++it)
-            written += writeFrame(*it);
-    }
-    return written;
-}
-
-/*!
-    \internal
- */
-qint64 QWebSocketPrivate::writeFrame(const QByteArray &frame)
-{
-    qint64 written = 0;
-    if (Q_LIKELY(m_pSocket))
-        written = m_pSocket->write(frame);
-    return written;
-}
-
 static QString msgUnsupportedAuthenticateChallenges(qsizetype count)
 {
     // Keep the error on a single line so it can easily be searched for:
@@ -1038,10 +1664,37 @@ void QWebSocketPrivate::processHandshake(QTcpSocket *pSocket)
                                 QByteArrayLiteral("upgrade")));
     const QString connection = QString::fromLatin1(parser.combinedHeaderValue(
                                 QByteArrayLiteral("connection")));
-#if 0 // unused for the moment
     const QString extensions = QString::fromLatin1(parser.combinedHeaderValue(
-                                QByteArrayLiteral("sec-websocket-extensions"));
-#endif
+                                QByteArrayLiteral("sec-websocket-extensions")));
+    QList<QPointer<QWebSocketExtension>> acceptedExtensions;
+    if (!extensions.isEmpty()) {
+        const QList<QWebSocketExtension *> offeredExtensions = m_options.extensions();
+        const QStringList names = extensions.split(u',', Qt::SkipEmptyParts);
+        quint8 reservedBits = 0;
+        for (const QString &entry : names) {
+            const QString name = entry.section(u';', 0, 0).trimmed();
+            const auto it = std::find_if(offeredExtensions.cbegin(), offeredExtensions.cend(),
+                                         [&name](const QWebSocketExtension *extension) {
+                return extension && extension->name() == name;
+            });
+            if (it == offeredExtensions.cend()) {
+                setErrorString(QWebSocket::tr("WebSocket server has chosen extension %1 which "
+                                              "has not been offered")
+                                       .arg(name));
+                emitErrorOccurred(QAbstractSocket::ConnectionRefusedError);
+                return;
+            }
+            const quint8 extensionBits = quint8((*it)->reservedBits().toInt());
+            if (reservedBits & extensionBits) {
+                setErrorString(QWebSocket::tr("WebSocket server has chosen extensions that use "
+                                              "the same reserved bits"));
+                emitErrorOccurred(QAbstractSocket::ConnectionRefusedError);
+                return;
+            }
+            reservedBits |= extensionBits;
+            acceptedExtensions.append(*it);
+        }
+    }
     const QString protocol = QString::fromLatin1(parser.combinedHeaderValue(
                                 QByteArrayLiteral("sec-websocket-protocol")));
     if (!protocol.isEmpty() && !requestedSubProtocols().contains(protocol)) {
@@ -1106,6 +1759,14 @@ void QWebSocketPrivate::processHandshake(QTcpSocket *pSocket)
     }
     case 401: {
         // HTTP/1.1 401 UNAUTHORIZED
+        if (m_options.isMessagePipeliningEnabled()) {
+            // the pipelined messages have gone out behind the first request
+            // already, they cannot be sent again with the next one
+            errorDescription = QWebSocket::tr(
+                    "QWebSocket::processHandshake: Host requires authentication, "
+                    "which is not supported with message pipelining");
+            break;
+        }
         if (m_authenticator.isNull())
             m_authenticator.detach();
         auto *priv = QAuthenticatorPrivate::getPrivate(m_authenticator);
@@ -1156,6 +1817,8 @@ void QWebSocketPrivate::processHandshake(QTcpSocket *pSocket)
     if (ok) {
         // handshake succeeded
         setProtocol(protocol);
+        setExtension(extensions);
+        setActiveExtensions(acceptedExtensions);
         setSocketState(QAbstractSocket::ConnectedState);
         Q_EMIT q->connected();
     } else if (m_needsResendWithCredentials) {
@@ -1172,8 +1835,14 @@ void QWebSocketPrivate::processHandshake(QTcpSocket *pSocket)
         // handshake failed
         setErrorString(errorDescription);
         emitErrorOccurred(QAbstractSocket::ConnectionRefusedError);
-        if (m_pSocket->state() != QAbstractSocket::UnconnectedState)
+        if (m_options.isMessagePipeliningEnabled()) {
+            // the pipelined messages that have not been sent yet are dropped
+            clearOutgoingMessages();
+            if (m_pSocket->state() != QAbstractSocket::UnconnectedState)
+                m_pSocket->abort();
+        } else if (m_pSocket->state() != QAbstractSocket::UnconnectedState) {
             m_pSocket->disconnectFromHost();
+        }
     }
 }
 
@@ -1234,10 +1903,17 @@ void QWebSocketPrivate::processStateChanged(QAbstractSocket::SocketState socketS
                                 | QUrl::RemovePath | QUrl::RemoveQuery
                                 | QUrl::RemoveFragment;
             const QString host = m_request.url().toString(format).mid(2);
+            const QList<QWebSocketExtension *> offeredExtensions = m_options.extensions();
+            QStringList extensionNames;
+            for (const QWebSocketExtension *extension : offeredExtensions) {
+                if (extension)
+                    extensionNames.append(extension->name());
+            }
             const QString handshake = createHandShakeRequest(m_resourceName,
                                                              host,
                                                              origin(),
-                                                             QString(),
+                                                             extensionNames.join(
+                                                                     QLatin1String(", ")),
                                                              subProtocols,
                                                              m_key,
                                                              headers);
@@ -1247,6 +1923,9 @@ void QWebSocketPrivate::processStateChanged(QAbstractSocket::SocketState socketS
                 return;
             }
             m_pSocket->write(handshake.toLatin1());
+            m_isHandshakeRequestSent = true;
+            // messages pipelined meanwhile go out right behind the request
+            writeQueuedFrames();
         }
         break;
 
@@ -1261,23 +1940,15 @@ void QWebSocketPrivate::processStateChanged(QAbstractSocket::SocketState socketS
             // isn't done cleaning up yet...
             auto reconnect = [this]() {
                 m_needsReconnect = false;
-                const QUrl url = m_request.url();
-#if QT_CONFIG(ssl)
-                const bool isEncrypted = url.scheme().compare(u"wss", Qt::CaseInsensitive) == 0;
-                if (isEncrypted) {
-                    // This has to work because we did it earlier; this is just us
-                    // reconnecting!
-                    auto *sslSocket = qobject_cast<QSslSocket *>(m_pSocket);
-                    Q_ASSERT(sslSocket);
-                    sslSocket->connectToHostEncrypted(url.host(), quint16(url.port(443)));
-                } else
-#endif
-                {
-                    m_pSocket->connectToHost(url.host(), quint16(url.port(80)));
-                }
+                m_isHandshakeRequestSent = false;
+                // This has to work because we did it earlier; this is just us
+                // reconnecting!
+                connectToHost(m_request.url(), true);
             };
             QMetaObject::invokeMethod(q, reconnect, Qt::QueuedConnection);
         } else if (webSocketState != QAbstractSocket::UnconnectedState) {
+            clearOutgoingMessages();
+            updateMemoryUsage();
             setSocketState(QAbstractSocket::UnconnectedState);
             Q_EMIT q->disconnected();
         }
@@ -1296,8 +1967,79 @@ void QWebSocketPrivate::processStateChanged(QAbstractSocket::SocketState socketS
 void QWebSocketPrivate::socketDestroyed(QObject *socket)
 {
     Q_ASSERT(m_pSocket);
-    if (m_pSocket == socket)
+    if (m_pSocket == socket) {
         m_pSocket = nullptr;
+        clearOutgoingMessages();
+    }
+}
+
+/*!
+ * \internal
+ * Lets go of the socket of a closed connection, as if it had been destroyed,
+ * so that the server can reuse it for another connection. The server removes
+ * the signal connections of the socket.
+ */
+void QWebSocketPrivate::detachSocket()
+{
+    if (m_pSocket)
+        socketDestroyed(m_pSocket);
+}
+
+/*!
+ * \internal
+ * Stops reading from the network for \a msecs milliseconds, as the incoming
+ * rate limits are exhausted. The socket keeps at most a byte meanwhile, so
+ * that the peer is slowed down by TCP flow control.
+ */
+void QWebSocketPrivate::delayReadingForRateLimit(qint64 msecs)
+{
+    Q_Q(QWebSocket);
+    m_isReadingDelayedForRateLimit = true;
+    m_pSocket->setReadBufferSize(1);
+    QTimer::singleShot(std::chrono::milliseconds(msecs), q,
+                       [this]() { resumeReadingForRateLimit(); });
+}
+
+/*!
+ * \internal
+ * Continues reading once the incoming rate limits allow it again.
+ */
+void QWebSocketPrivate::resumeReadingForRateLimit()
+{
+    if (!m_isReadingDelayedForRateLimit)
+        return;
+    m_isReadingDelayedForRateLimit = false;
+    if (m_pSocket) {
+        if (!m_isReadingPausedForMemoryBudget)
+            m_pSocket->setReadBufferSize(m_readBufferSize);
+        processData();
+    }
+}
+
+/*!
+ \internal
+ Restarts the idle trim timer, if it has stopped after trimming.
+ */
+void QWebSocketPrivate::noteActivity()
+{
+    if (Q_LIKELY(!m_idleTrimTimer))
+        return;
+    m_isActiveSinceTrimCheck = true;
+    if (!m_idleTrimTimer->isActive())
+        m_idleTrimTimer->start();
+}
+
+/*!
+ \internal
+ Trims the buffers if there has been no traffic during a whole interval of
+ the idle trim timer; the timer then stops until there is traffic again.
+ */
+void QWebSocketPrivate::trimIfIdle()
+{
+    if (std::exchange(m_isActiveSinceTrimCheck, false))
+        return;
+    m_idleTrimTimer->stop();
+    trimMemory();
 }
 
 /*!
@@ -1307,6 +2049,8 @@ void QWebSocketPrivate::processData()
 {
     if (!m_pSocket) // disconnected with data still in-bound
         return;
+    m_hasReadSinceTrim = true;
+    noteActivity();
     if (state() == QAbstractSocket::ConnectingState) {
         if (m_bytesToSkipBeforeNewResponse > 0)
             m_bytesToSkipBeforeNewResponse -= m_pSocket->skip(m_bytesToSkipBeforeNewResponse);
@@ -1316,13 +2060,224 @@ void QWebSocketPrivate::processData()
        // That may have changed state(), recheck in the next 'if' below.
     }
     if (state() != QAbstractSocket::ConnectingState) {
-        while (m_pSocket->bytesAvailable()) {
-            if (!m_dataProcessor->process(m_pSocket))
+        const auto reportMemoryUsage = qScopeGuard([this]() { updateMemoryUsage(); });
+        const QScopedValueRollback<bool> processing(m_isProcessingData, true);
+        if (Q_UNLIKELY(m_isReadingPausedForMemoryBudget || m_isReadingDelayedForRateLimit))
+            return;
+        while (Q_UNLIKELY(!m_pendingInput.isEmpty()) || m_pSocket->bytesAvailable()) {
+            if (Q_UNLIKELY(isRelayBackedUp())) {
+                // resumed by the bytesWritten() signal of the relay target
+                m_isRelayPaused = true;
+                return;
+            }
+            if (Q_UNLIKELY(m_memoryBudget && m_memoryBudget->isExceeded())
+                    && m_memoryBudget->pauseReading(this)) {
+                // the socket stops reading from the network once it holds
+                // a byte, until the budget resumes it
+                m_isReadingPausedForMemoryBudget = true;
+                m_pSocket->setReadBufferSize(1);
+                return;
+            }
+            if (const qint64 delay = m_dataProcessor->readingDelay(); Q_UNLIKELY(delay > 0)) {
+                delayReadingForRateLimit(delay);
+                return;
+            }
+            if (Q_UNLIKELY(!m_pendingInput.isEmpty())) {
+                if (!processPendingInput())
+                    return;
+            } else if (!m_dataProcessor->process(m_pSocket)) {
                 return;
+            }
         }
     }
 }
 
+/*!
+ \internal
+ Parses the next frame of the data taken out of the socket. A frame that
+ continues on the socket is completed with only the bytes it is missing, so
+ that the socket is read directly again once that data has been used up.
+ Returns \c false if the frame has to wait for more data.
+ */
+bool QWebSocketPrivate::processPendingInput()
+{
+    QBuffer buffer(&m_pendingInput);
+    buffer.open(QIODevice::ReadOnly);
+    buffer.seek(m_pendingInputPosition);
+    const bool isDone = m_dataProcessor->process(&buffer);
+    m_pendingInputPosition = qsizetype(buffer.pos());
+    const qint64 remaining = buffer.bytesAvailable();
+    buffer.close();
+    if (remaining == 0) {
+        m_pendingInput.clear();
+        m_pendingInputPosition = 0;
+        return true;
+    }
+    if (isDone || !m_pSocket)
+        return isDone;
+    const qint64 size = qMin(m_dataProcessor->missingBytes(remaining),
+                             m_pSocket->bytesAvailable());
+    if (size <= 0)
+        return false;
+    // the consumed part is dropped once per frame, not on every read
+    m_pendingInput.remove(0, m_pendingInputPosition);
+    m_pendingInputPosition = 0;
+    const qsizetype previousSize = m_pendingInput.size();
+    m_pendingInput.resize(previousSize + qsizetype(size));
+    const qint64 read = m_pSocket->read(m_pendingInput.data() + previousSize, size);
+    m_pendingInput.resize(previousSize + qsizetype(qMax(read, qint64(0))));
+    return read > 0;
+}
+
+/*!
+ \internal
+ Hands the connection over to another QWebSocket, which may live in another
+ process: returns the state needed to continue the connection, and stores a
+ duplicate of the socket descriptor in \a socketDescriptor. This socket is
+ closed without a close frame; the duplicated descriptor keeps the
+ connection open.
+ */
+QByteArray QWebSocketPrivate::saveState(qintptr *socketDescriptor)
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_WASM)
+    if (Q_UNLIKELY(!socketDescriptor || !m_pSocket
+                   || state() != QAbstractSocket::ConnectedState
+                   || m_isClosingHandshakeSent || m_isClosingHandshakeReceived)) {
+        return QByteArray();
+    }
+#ifndef QT_NO_SSL
+    // the TLS session cannot be handed over
+    if (qobject_cast<QSslSocket *>(m_pSocket))
+        return QByteArray();
+#endif
+    // neither can the extension objects, which the new socket would need
+    if (!m_extensions.isEmpty())
+        return QByteArray();
+    // what has been sent on this side is written out before the handover
+    writeQueuedFrames(true);
+    const QDeadlineTimer deadline(SAVE_STATE_WRITE_TIMEOUT_MS);
+    while (m_pSocket && m_pSocket->bytesToWrite() > 0) {
+        if (deadline.hasExpired()
+            || !m_pSocket->waitForBytesWritten(int(deadline.remainingTime()))) {
+            return QByteArray();
+        }
+    }
+    if (Q_UNLIKELY(!m_pSocket || m_pSocket->state() != QAbstractSocket::ConnectedState))
+        return QByteArray();
+
+    const int descriptor = ::fcntl(int(m_pSocket->socketDescriptor()), F_DUPFD_CLOEXEC, 0);
+    if (Q_UNLIKELY(descriptor < 0))
+        return QByteArray();
+
+    QList<std::pair<QByteArray, QByteArray>> headers;
+    const QHttpHeaders requestHeaders = m_request.headers();
+    headers.reserve(requestHeaders.size());
+    for (qsizetype i = 0; i < requestHeaders.size(); ++i) {
+        const QLatin1StringView name = requestHeaders.nameAt(i);
+        headers.append({ QByteArray(name.data(), name.size()),
+                         requestHeaders.valueAt(i).toByteArray() });
+    }
+    // the part of the frame and of the message that has been parsed comes
+    // first, then what is left of a previous handover, then what has been
+    // read from the socket; the kernel's receive buffer goes with the
+    // descriptor
+    QByteArray input = m_dataProcessor->pendingData();
+    input.append(QByteArrayView(m_pendingInput).sliced(m_pendingInputPosition));
+    input.append(m_pSocket->readAll());
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << SAVED_STATE_MAGIC << SAVED_STATE_VERSION << qint32(m_version) << m_resourceName
+           << m_request.url() << headers << m_options.subprotocols() << m_origin << m_protocol
+           << m_extension << m_mustMask << quint64(m_outgoingFrameSize)
+           << quint64(m_dataProcessor->maxAllowedFrameSize())
+           << quint64(m_dataProcessor->maxAllowedMessageSize()) << input;
+
+    m_dataProcessor->clear();
+    m_pendingInput.clear();
+    m_pendingInputPosition = 0;
+    m_pSocket->abort();
+    *socketDescriptor = descriptor;
+    return state;
+#else
+    Q_UNUSED(socketDescriptor);
+    return QByteArray();
+#endif
+}
+
+/*!
+ \internal
+ Creates a QWebSocket that continues the connection of \a socketDescriptor,
+ which has been handed over with \a state by saveState().
+ Returns \nullptr if \a state is invalid or the descriptor cannot be used;
+ the descriptor is then not taken over.
+ */
+QWebSocket *QWebSocketPrivate::restoreState(qintptr socketDescriptor, const QByteArray &state,
+                                            QObject *parent)
+{
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint8 formatVersion = 0;
+    stream >> magic >> formatVersion;
+    if (Q_UNLIKELY(magic != SAVED_STATE_MAGIC || formatVersion != SAVED_STATE_VERSION))
+        return nullptr;
+
+    qint32 version = 0;
+    QString resourceName;
+    QUrl url;
+    QList<std::pair<QByteArray, QByteArray>> headers;
+    QStringList subprotocols;
+    QString origin;
+    QString protocol;
+    QString extension;
+    bool mustMask = true;
+    quint64 outgoingFrameSize = 0;
+    quint64 maxAllowedFrameSize = 0;
+    quint64 maxAllowedMessageSize = 0;
+    QByteArray input;
+    stream >> version >> resourceName >> url >> headers >> subprotocols >> origin >> protocol
+           >> extension >> mustMask >> outgoingFrameSize >> maxAllowedFrameSize
+           >> maxAllowedMessageSize >> input;
+    if (Q_UNLIKELY(stream.status() != QDataStream::Ok))
+        return nullptr;
+
+    auto pTcpSocket = std::make_unique<QTcpSocket>();
+    if (Q_UNLIKELY(!pTcpSocket->setSocketDescriptor(socketDescriptor)))
+        return nullptr;
+    QWebSocket *pWebSocket = new QWebSocket(pTcpSocket.get(),
+                                            QWebSocketProtocol::Version(version), parent);
+    pTcpSocket.release()->setParent(pWebSocket);
+
+    QHttpHeaders requestHeaders;
+    for (const auto &header : std::as_const(headers))
+        requestHeaders.append(header.first, header.second);
+    QNetworkRequest request(url);
+    request.setHeaders(std::move(requestHeaders));
+    QWebSocketHandshakeOptions options;
+    if (!subprotocols.isEmpty())
+        options.setSubprotocols(subprotocols);
+
+    QWebSocketPrivate *d = pWebSocket->d_func();
+    d->setExtension(extension);
+    d->setOrigin(origin);
+    d->setRequest(request, options);
+    d->setProtocol(protocol);
+    d->setResourceName(resourceName);
+    d->enableMasking(mustMask);
+    d->setOutgoingFrameSize(outgoingFrameSize);
+    d->setMaxAllowedIncomingFrameSize(maxAllowedFrameSize);
+    d->setMaxAllowedIncomingMessageSize(maxAllowedMessageSize);
+    if (!input.isEmpty()) {
+        d->m_pendingInput = std::move(input);
+        // give the caller the chance to connect to the signals first
+        QMetaObject::invokeMethod(pWebSocket, [d]() { d->processData(); },
+                                  Qt::QueuedConnection);
+    }
+    return pWebSocket;
+}
+
 /*!
  \internal
  */
@@ -1332,16 +2287,7 @@ void QWebSocketPrivate::processPing(const QByteArray &data)
     quint32 maskingKey = 0;
     if (m_mustMask)
         maskingKey = generateMaskingKey();
-    m_pSocket->write(getFrameHeader(QWebSocketProtocol::OpCodePong,
-                                    unsigned(data.size()),
-                                    maskingKey,
-                                    true));
-    if (data.size() > 0) {
-        QByteArray maskedData = data;
-        if (m_mustMask)
-            QWebSocketProtocol::mask(&maskedData, maskingKey);
-        m_pSocket->write(maskedData);
-    }
+    QWebSocketFrame::writeFrame(m_pSocket, QWebSocketProtocol::OpCodePong, data, maskingKey, true);
 }
 
 /*!
@@ -1485,6 +2431,162 @@ quint64 QWebSocketPrivate::maxAllowedIncomingMessageSize() const
     return m_dataProcessor->maxAllowedMessageSize();
 }
 
+/*!
+    \internal
+ */
+void QWebSocketPrivate::setIncomingByteRateLimit(qint64 bytesPerSecond)
+{
+    m_dataProcessor->setByteRateLimit(bytesPerSecond);
+}
+
+/*!
+    \internal
+ */
+qint64 QWebSocketPrivate::incomingByteRateLimit() const
+{
+    return m_dataProcessor->byteRateLimit();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketPrivate::setIncomingMessageRateLimit(int messagesPerSecond)
+{
+    m_dataProcessor->setMessageRateLimit(messagesPerSecond);
+}
+
+/*!
+    \internal
+ */
+int QWebSocketPrivate::incomingMessageRateLimit() const
+{
+    return m_dataProcessor->messageRateLimit();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketPrivate::setIncomingControlFrameRateLimit(int framesPerSecond)
+{
+    m_dataProcessor->setControlFrameRateLimit(framesPerSecond);
+}
+
+/*!
+    \internal
+ */
+int QWebSocketPrivate::incomingControlFrameRateLimit() const
+{
+    return m_dataProcessor->controlFrameRateLimit();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketPrivate::setIncomingRateLimitPolicy(QWebSocket::RateLimitPolicy policy)
+{
+    m_dataProcessor->setRateLimitPolicy(policy);
+    // reading delayed so far goes on until the timer resumes it
+}
+
+/*!
+    \internal
+ */
+QWebSocket::RateLimitPolicy QWebSocketPrivate::incomingRateLimitPolicy() const
+{
+    return m_dataProcessor->rateLimitPolicy();
+}
+
+/*!
+    \internal
+ */
+quint64 QWebSocketPrivate::incomingRateLimitHits() const
+{
+    return m_dataProcessor->rateLimitHits();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketPrivate::setIdleTrimInterval(std::chrono::milliseconds interval)
+{
+    Q_Q(QWebSocket);
+    if (interval <= std::chrono::milliseconds::zero()) {
+        delete std::exchange(m_idleTrimTimer, nullptr);
+        return;
+    }
+    if (!m_idleTrimTimer) {
+        m_idleTrimTimer = new QTimer(q);
+        m_idleTrimTimer->setTimerType(Qt::VeryCoarseTimer);
+        QObject::connect(m_idleTrimTimer, &QTimer::timeout, q, [this]() { trimIfIdle(); });
+    }
+    m_idleTrimTimer->setInterval(interval);
+    m_isActiveSinceTrimCheck = false;
+    m_idleTrimTimer->start();
+}
+
+/*!
+    \internal
+ */
+std::chrono::milliseconds QWebSocketPrivate::idleTrimInterval() const
+{
+    return m_idleTrimTimer ? m_idleTrimTimer->intervalAsDuration()
+                           : std::chrono::milliseconds::zero();
+}
+
+/*!
+    \internal
+    Gives the spare capacity of the buffers of this connection back to the
+    allocator, and returns the number of bytes freed. The buffers of the
+    socket count with the size of the chunk they keep, as their capacity
+    cannot be queried.
+ */
+qint64 QWebSocketPrivate::trimMemory()
+{
+    qint64 freed = 0;
+    const auto release = [&freed](auto &buffer) {
+        if (buffer.isEmpty() && buffer.capacity() > 0) {
+            freed += qint64(buffer.capacity()) * qint64(sizeof(*buffer.constData()));
+            buffer = std::remove_reference_t<decltype(buffer)>();
+        }
+    };
+    release(m_highPriorityMessages);
+    release(m_normalPriorityMessages);
+    release(m_relayedMessages);
+    release(m_relayedMessage);
+    release(m_relayedMessageToEncode);
+    release(m_pendingInput);
+    if (m_pSocket && m_pSocket->isOpen()) {
+        auto *socketPrivate = static_cast<QIODevicePrivate *>(QObjectPrivate::get(m_pSocket));
+        if (m_hasReadSinceTrim && m_pendingInput.isEmpty() && !m_isProcessingData
+            && state() == QAbstractSocket::ConnectedState && !m_isReadingPausedForMemoryBudget
+            && !m_isReadingDelayedForRateLimit && !m_isRelayPaused) {
+            // what is left in the read buffer is the start of a frame that
+            // has not arrived completely; only its bytes are kept, so that
+            // the chunk can go
+            const qint64 available = m_pSocket->bytesAvailable();
+            if (available > 0 && available < socketPrivate->buffer.chunkSize()) {
+                m_pendingInput = m_pSocket->read(available);
+                freed -= available;
+            }
+        }
+        if (m_hasReadSinceTrim && m_pSocket->bytesAvailable() == 0) {
+            // QIODevice keeps the last chunk it read into for the next read
+            freed += socketPrivate->buffer.chunkSize();
+            socketPrivate->buffer.clear();
+            m_hasReadSinceTrim = false;
+        }
+        if (m_hasWrittenSinceTrim && m_pSocket->bytesToWrite() == 0) {
+            // QIODevice keeps the last chunk unless it grew beyond the chunk size
+            freed += socketPrivate->writeBuffer.chunkSize();
+            socketPrivate->writeBuffer.clear();
+            m_hasWrittenSinceTrim = false;
+        }
+    }
+    if (m_memoryBudget)
+        m_memoryBudget->addTrimmedBytes(freed);
+    return freed;
+}
+
 /*!
     \internal
  */
@@ -1623,9 +2725,7 @@ void QWebSocketPrivate::setProxy(const QNetworkProxy &networkProxy)
  */
 void QWebSocketPrivate::setMaskGenerator(const QMaskGenerator *maskGenerator)
 {
-    if (!maskGenerator)
-        m_pMaskGenerator = &m_defaultMaskGenerator;
-    else if (maskGenerator != m_pMaskGenerator)
+    if (maskGenerator != m_pMaskGenerator)
         m_pMaskGenerator = const_cast<QMaskGenerator *>(maskGenerator);
 }
 
@@ -1634,8 +2734,7 @@ void QWebSocketPrivate::setMaskGenerator(const QMaskGenerator *maskGenerator)
  */
 const QMaskGenerator *QWebSocketPrivate::maskGenerator() const
 {
-    Q_ASSERT(m_pMaskGenerator);
-    return m_pMaskGenerator;
+    return activeMaskGenerator();
 }
 
 /*!
@@ -1671,8 +2770,11 @@ void QWebSocketPrivate::setPauseMode(QAbstractSocket::PauseModes pauseMode)
 void QWebSocketPrivate::setReadBufferSize(qint64 size)
 {
     m_readBufferSize = size;
-    if (Q_LIKELY(m_pSocket))
+    // applied when reading resumes
+    if (Q_LIKELY(m_pSocket) && !m_isReadingPausedForMemoryBudget
+            && !m_isReadingDelayedForRateLimit) {
         m_pSocket->setReadBufferSize(m_readBufferSize);
+    }
 }
 
 void QWebSocketPrivate::emitErrorOccurred(QAbstractSocket::SocketError error)
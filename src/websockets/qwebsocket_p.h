@@ -27,12 +27,23 @@
 #include <QtNetwork/QSslSocket>
 #endif
 #include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QPointer>
+#include <QtCore/QQueue>
 #include <private/qobject_p.h>
 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+
 #include "qwebsocket.h"
+#include "qwebsocketclientcontext.h"
 #include "qwebsockethandshakeoptions.h"
 #include "qwebsocketprotocol.h"
 #include "qwebsocketdataprocessor_p.h"
+#include "qwebsocketmemorybudget_p.h"
+#include "qwebsocketmessagequeue_p.h"
 #include "qdefaultmaskgenerator_p.h"
 
 #ifdef Q_OS_WASM
@@ -46,6 +57,7 @@ class QWebSocketHandshakeResponse;
 class QTcpSocket;
 class QWebSocket;
 class QMaskGenerator;
+class QTimer;
 
 struct QWebSocketConfiguration
 {
@@ -116,8 +128,22 @@ public:
     QWebSocketProtocol::CloseCode closeCode() const;
     QString closeReason() const;
 
-    qint64 sendTextMessage(const QString &message);
-    qint64 sendBinaryMessage(const QByteArray &data);
+    qint64 sendTextMessage(const QString &message,
+                           QWebSocket::MessagePriority priority = QWebSocket::NormalPriority);
+    qint64 sendBinaryMessage(const QByteArray &data,
+                             QWebSocket::MessagePriority priority = QWebSocket::NormalPriority);
+    qint64 sendFile(QFile *file, qint64 offset, qint64 length);
+    void postMessage(const QByteArray &data, bool isBinary);
+    static qsizetype broadcastMessage(const QByteArray &data, bool isBinary,
+                                      const QList<QWebSocket *> &recipients);
+    QByteArray saveState(qintptr *socketDescriptor);
+    Q_REQUIRED_RESULT static QWebSocket *restoreState(qintptr socketDescriptor,
+                                                      const QByteArray &state,
+                                                      QObject *parent = nullptr);
+    void setRelayTarget(QWebSocket *target);
+    QWebSocket *relayTarget() const;
+    qint64 bytesToWrite() const;
+    void setMemoryBudget(std::shared_ptr<QWebSocketMemoryBudget> budget);
 
 #ifndef QT_NO_SSL
     void ignoreSslErrors(const QList<QSslError> &errors);
@@ -141,6 +167,22 @@ public:
     static quint64 maxIncomingMessageSize();
     static quint64 maxIncomingFrameSize();
 
+    void setIncomingByteRateLimit(qint64 bytesPerSecond);
+    qint64 incomingByteRateLimit() const;
+    void setIncomingMessageRateLimit(int messagesPerSecond);
+    int incomingMessageRateLimit() const;
+    void setIncomingControlFrameRateLimit(int framesPerSecond);
+    int incomingControlFrameRateLimit() const;
+    void setIncomingRateLimitPolicy(QWebSocket::RateLimitPolicy policy);
+    QWebSocket::RateLimitPolicy incomingRateLimitPolicy() const;
+    quint64 incomingRateLimitHits() const;
+
+    void setIdleTrimInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds idleTrimInterval() const;
+    qint64 trimMemory();
+
+    void detachSocket();
+
     void setOutgoingFrameSize(quint64 outgoingFrameSize);
     quint64 outgoingFrameSize() const;
     static quint64 maxOutgoingFrameSize();
@@ -149,6 +191,22 @@ public:
     QString closeCodeToString(QWebSocketProtocol::CloseCode code);
 #endif
 private:
+    struct OutgoingMessage
+    {
+        QByteArray payload;
+        // file messages send size bytes of file, starting at fileOffset
+        QPointer<QFile> file;
+        qint64 fileOffset = 0;
+        qint64 size = 0;
+        qint64 offset = 0;
+        QWebSocketProtocol::OpCode opCode = QWebSocketProtocol::OpCodeBinary;
+        bool isFile = false;
+        // relayed frames may be a part of a message only
+        bool isFinal = true;
+        // set by the extensions that encoded the payload
+        quint8 reservedBits = 0;
+    };
+
     QWebSocketPrivate(QTcpSocket *pTcpSocket, QWebSocketProtocol::Version version);
     void setVersion(QWebSocketProtocol::Version version);
     void setResourceName(const QString &resourceName);
@@ -156,6 +214,7 @@ private:
     void setOrigin(const QString &origin);
     void setProtocol(const QString &protocol);
     void setExtension(const QString &extension);
+    void setActiveExtensions(const QList<QPointer<QWebSocketExtension>> &extensions);
     void enableMasking(bool enable);
     void setErrorString(const QString &errorString);
 
@@ -164,19 +223,45 @@ private:
     void socketDestroyed(QObject *socket);
 
     void processData();
+    bool processPendingInput();
     void processPing(const QByteArray &data);
     void processPong(const QByteArray &data);
     void processClose(QWebSocketProtocol::CloseCode closeCode, QString closeReason);
     void processHandshake(QTcpSocket *pSocket);
     void processStateChanged(QAbstractSocket::SocketState socketState);
 
-    Q_REQUIRED_RESULT qint64 doWriteFrames(const QByteArray &data, bool isBinary);
+    bool canSendMessages() const;
+    Q_REQUIRED_RESULT qint64 doWriteFrames(const QByteArray &data, bool isBinary,
+                                           QWebSocket::MessagePriority priority);
+    void encodeMessage(OutgoingMessage &message) const;
+    void enqueueMessage(OutgoingMessage &&message, QWebSocket::MessagePriority priority);
+    void writeQueuedFrames(bool drain = false);
+    qint64 writeFileFrame(QFile *file, qint64 position, qint64 size,
+                          QWebSocketProtocol::OpCode opCode, quint32 maskingKey,
+                          bool isLastFrame, bool *isReadError);
+    void processBytesWritten();
+    void processPostedMessages();
+    void relayFrame(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                    bool isLastFrame);
+    void enqueueRelayedFrame(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                             bool isLastFrame);
+    bool isRelayBackedUp() const;
+    void resumeRelay();
+    void updateMemoryUsage();
+    void resumeReadingForMemoryBudget();
+    void closeForMemoryBudget();
+    void delayReadingForRateLimit(qint64 msecs);
+    void resumeReadingForRateLimit();
+    void noteActivity();
+    void trimIfIdle();
+    void clearOutgoingMessages();
+    qint64 socketBytesToWrite() const;
 
     void makeConnections(QTcpSocket *pTcpSocket);
+    void makeClientContextConnections();
+    void connectToHost(const QUrl &url, bool isReconnecting = false);
     void releaseConnections(const QTcpSocket *pTcpSocket);
 
-    QByteArray getFrameHeader(QWebSocketProtocol::OpCode opCode, quint64 payloadLength,
-                              quint32 maskingKey, bool lastFrame);
     QString calculateAcceptKey(const QByteArray &key) const;
     QString createHandShakeRequest(QString resourceName,
                                    QString host,
@@ -192,10 +277,9 @@ private:
                 const QWebSocketHandshakeResponse &response,
                 QObject *parent = nullptr);
 
+    QMaskGenerator *activeMaskGenerator() const;
     quint32 generateMaskingKey() const;
     QByteArray generateKey() const;
-    Q_REQUIRED_RESULT qint64 writeFrames(const QList<QByteArray> &frames);
-    Q_REQUIRED_RESULT qint64 writeFrame(const QByteArray &frame);
     void emitErrorOccurred(QAbstractSocket::SocketError error);
 
     QTcpSocket *m_pSocket;
@@ -208,6 +292,8 @@ private:
     QString m_origin;
     QString m_protocol;
     QString m_extension;
+    // the negotiated extensions, in the order in which they encode messages
+    QList<QPointer<QWebSocketExtension>> m_extensions;
     QAbstractSocket::SocketState m_socketState;
     QAbstractSocket::PauseModes m_pauseMode;
     qint64 m_readBufferSize;
@@ -222,6 +308,8 @@ private:
 
     bool m_isClosingHandshakeSent;
     bool m_isClosingHandshakeReceived;
+    // pipelined messages are held back until the handshake request is written
+    bool m_isHandshakeRequestSent = false;
 
     // For WWW-Authenticate handling
     bool m_needsResendWithCredentials = false;
@@ -235,12 +323,78 @@ private:
     QWebSocketDataProcessor *m_dataProcessor = new QWebSocketDataProcessor();
     QWebSocketConfiguration m_configuration;
 
+    // Only clients mask their frames, so the default generator is created on first use.
     QMaskGenerator *m_pMaskGenerator;
-    QDefaultMaskGenerator m_defaultMaskGenerator;
+    mutable std::unique_ptr<QDefaultMaskGenerator> m_defaultMaskGenerator;
 
     quint64 m_outgoingFrameSize;
 
+    // Data messages are queued and cut into frames only when the socket has
+    // room for them, so that control frames and high priority messages get
+    // onto the wire at the next frame boundary instead of behind the whole
+    // queue. The message being fragmented always has to be finished first,
+    // as data frames of different messages must not be interleaved.
+    std::optional<OutgoingMessage> m_currentOutgoingMessage;
+    QQueue<OutgoingMessage> m_highPriorityMessages;
+    QQueue<OutgoingMessage> m_normalPriorityMessages;
+    qint64 m_queuedBytes = 0;
+    // header and payload go into one write, so they end up in the same TLS record
+    bool m_coalesceFrames = false;
+    // messages posted from other threads, moved to the normal priority queue
+    // in one batch per wakeup of the socket's thread
+    QWebSocketMessageQueue m_postedMessages;
+    // data taken out of the socket: received before the connection was
+    // handed over to this socket, or an incomplete frame moved out of the
+    // socket's read buffer when trimming; it is parsed ahead of the data
+    // arriving on the socket, up to m_pendingInputPosition so far
+    QByteArray m_pendingInput;
+    qsizetype m_pendingInputPosition = 0;
+
+    // Frames received while a relay target is set are queued on the target
+    // as they are, without assembling the messages. A message being relayed
+    // has to be finished before anything else is written, as it may arrive
+    // in several frames. Reading pauses while the target is backed up.
+    QPointer<QWebSocket> m_relayTarget;
+    QMetaObject::Connection m_relayTargetConnections[2];
+    QQueue<OutgoingMessage> m_relayedMessages;
+    QByteArray m_relayedMessage;
+    // with negotiated extensions, which encode whole messages, the frames
+    // relayed to this socket are assembled first
+    QByteArray m_relayedMessageToEncode;
+    QWebSocketProtocol::OpCode m_relayedOpCodeToEncode = QWebSocketProtocol::OpCodeBinary;
+    bool m_isRelayedMessageBinary = false;
+    bool m_isRelayedMessageOpen = false;
+    bool m_isRelayPaused = false;
+
+    // Server connections report the memory they hold to the server-wide
+    // budget; m_memoryUsage is the usage reported last, which the budget
+    // reads from other threads to pick the connections to close.
+    std::shared_ptr<QWebSocketMemoryBudget> m_memoryBudget;
+    std::atomic<qint64> m_memoryUsage = 0;
+    bool m_isReadingPausedForMemoryBudget = false;
+
+    // Reading pauses the same way while the incoming rate limits delay it.
+    bool m_isReadingDelayedForRateLimit = false;
+
+    // The buffers are trimmed once the connection has been idle for a whole
+    // interval of the timer, which only runs while there is traffic.
+    QTimer *m_idleTrimTimer = nullptr;
+    bool m_isActiveSinceTrimCheck = false;
+    // the read buffer is not touched by trimming while frames are read from it
+    bool m_isProcessingData = false;
+    bool m_hasReadSinceTrim = false;
+    bool m_hasWrittenSinceTrim = false;
+
+    // Clients that share a context reuse recently resolved addresses and TLS
+    // sessions; an address that fails is dropped from the cache, and the
+    // session of a connection whose certificate was not verified is not kept.
+    QPointer<QWebSocketClientContext> m_clientContext;
+    bool m_canCacheAddress = false;
+    bool m_isUsingCachedAddress = false;
+    bool m_hasSslErrors = false;
+
     friend class QWebSocketServerPrivate;
+    friend class QWebSocketMemoryBudget;
 #ifdef Q_OS_WASM
     EMSCRIPTEN_WEBSOCKET_T m_socketContext = 0;
     uint16_t m_readyState = 0;
@@ -74,8 +74,11 @@ static EM_BOOL q_onWebSocketIncomingMessageCallback(int eventType,
     return 0;
 }
 
-qint64 QWebSocketPrivate::sendTextMessage(const QString &message)
+qint64 QWebSocketPrivate::sendTextMessage(const QString &message,
+                                          QWebSocket::MessagePriority priority)
 {
+    // the browser owns the outgoing queue
+    Q_UNUSED(priority);
     int result = 0;
     emscripten_websocket_get_ready_state(m_socketContext, &m_readyState);
 
@@ -92,8 +95,10 @@ qint64 QWebSocketPrivate::sendTextMessage(const QString &message)
     return result;
 }
 
-qint64 QWebSocketPrivate::sendBinaryMessage(const QByteArray &data)
+qint64 QWebSocketPrivate::sendBinaryMessage(const QByteArray &data,
+                                            QWebSocket::MessagePriority priority)
 {
+    Q_UNUSED(priority);
     int result = 0;
     emscripten_websocket_get_ready_state(m_socketContext, &m_readyState);
     if (m_readyState == 1) {
@@ -110,6 +115,38 @@ qint64 QWebSocketPrivate::sendBinaryMessage(const QByteArray &data)
     return result;
 }
 
+qsizetype QWebSocketPrivate::broadcastMessage(const QByteArray &data, bool isBinary,
+                                              const QList<QWebSocket *> &recipients)
+{
+    // the browser frames each message itself
+    qsizetype count = 0;
+    for (QWebSocket *recipient : recipients) {
+        if (!recipient || recipient->state() != QAbstractSocket::ConnectedState)
+            continue;
+        QWebSocketPrivate *d = recipient->d_func();
+        if (isBinary)
+            d->sendBinaryMessage(data);
+        else
+            d->sendTextMessage(QString::fromUtf8(data));
+        ++count;
+    }
+    return count;
+}
+
+qint64 QWebSocketPrivate::sendFile(QFile *file, qint64 offset, qint64 length)
+{
+    if (!file || !file->isReadable() || file->isSequential() || offset < 0)
+        return -1;
+    if (length < 0)
+        length = file->size() - offset;
+    if (length < 0 || offset > file->size() - length || !file->seek(offset))
+        return -1;
+    const QByteArray data = file->read(length);
+    if (data.size() != length)
+        return -1;
+    return sendBinaryMessage(data);
+}
+
 void QWebSocketPrivate::close(QWebSocketProtocol::CloseCode closeCode, QString reason)
 {
     Q_Q(QWebSocket);
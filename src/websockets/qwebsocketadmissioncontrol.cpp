@@ -0,0 +1,175 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qwebsocketadmissioncontrol_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QWebSocketAdmissionControl
+    \internal
+
+    Admission control of QWebSocketServer. It only looks at the peer address
+    of a connection, so that connections can be refused before a handshake
+    timer is started or anything is parsed.
+ */
+
+/*!
+    \internal
+ */
+QWebSocketAdmissionControl::QWebSocketAdmissionControl()
+{
+    m_clock.start();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketAdmissionControl::setHandshakeRate(int handshakesPerSecond)
+{
+    m_handshakes.setRate(qMax(handshakesPerSecond, 0), m_clock.elapsed());
+}
+
+/*!
+    \internal
+ */
+int QWebSocketAdmissionControl::handshakeRate() const
+{
+    return int(m_handshakes.rate());
+}
+
+/*!
+    \internal
+ */
+void QWebSocketAdmissionControl::setMaxConnectionsPerAddress(int maxConnections)
+{
+    m_maxConnectionsPerAddress = qMax(maxConnections, 0);
+}
+
+/*!
+    \internal
+ */
+int QWebSocketAdmissionControl::maxConnectionsPerAddress() const
+{
+    return m_maxConnectionsPerAddress;
+}
+
+/*!
+    \internal
+ */
+void QWebSocketAdmissionControl::setHandshakeRatePerAddress(int handshakesPerSecond)
+{
+    m_handshakeRatePerAddress = qMax(handshakesPerSecond, 0);
+    const qint64 now = m_clock.elapsed();
+    for (AddressState &state : m_addresses)
+        state.handshakes.setRate(m_handshakeRatePerAddress, now);
+}
+
+/*!
+    \internal
+ */
+int QWebSocketAdmissionControl::handshakeRatePerAddress() const
+{
+    return m_handshakeRatePerAddress;
+}
+
+/*!
+    \internal
+    Returns \c true if connections have to be reported with admit() and
+    release(), because there are limits per address.
+ */
+bool QWebSocketAdmissionControl::tracksAddresses() const
+{
+    return m_maxConnectionsPerAddress > 0 || m_handshakeRatePerAddress > 0;
+}
+
+/*!
+    \internal
+    Returns \c true if a new connection from \a address is admitted; it then
+    has to be release()d once it is closed, if tracksAddresses() is \c true.
+    Otherwise, sets \a retryAfterSeconds to the time after which the peer
+    should try again.
+ */
+bool QWebSocketAdmissionControl::admit(const QHostAddress &address, int *retryAfterSeconds)
+{
+    const qint64 now = m_clock.elapsed();
+    m_handshakes.refill(now);
+    qint64 retryAfter = m_handshakes.msecsUntilAvailable();
+
+    AddressState *state = nullptr;
+    if (tracksAddresses()) {
+        const QHostAddress key = normalized(address);
+        auto it = m_addresses.find(key);
+        if (it == m_addresses.end()) {
+            if (m_addresses.size() >= m_pruneThreshold)
+                prune();
+            it = m_addresses.insert(key, AddressState());
+            it->handshakes.setRate(m_handshakeRatePerAddress, now);
+        }
+        state = &*it;
+        state->handshakes.refill(now);
+        retryAfter = qMax(retryAfter, state->handshakes.msecsUntilAvailable());
+        if (m_maxConnectionsPerAddress > 0 && state->connections >= m_maxConnectionsPerAddress)
+            retryAfter = qMax(retryAfter, qint64(1000));
+    }
+
+    if (retryAfter > 0) {
+        *retryAfterSeconds = int(qMax((retryAfter + 999) / 1000, qint64(1)));
+        return false;
+    }
+    m_handshakes.take();
+    if (state) {
+        state->handshakes.take();
+        ++state->connections;
+    }
+    return true;
+}
+
+/*!
+    \internal
+    Reports that a connection from \a address that was admitted is closed.
+ */
+void QWebSocketAdmissionControl::release(const QHostAddress &address)
+{
+    const auto it = m_addresses.find(normalized(address));
+    if (it == m_addresses.end())
+        return;
+    if (it->connections > 0)
+        --it->connections;
+    if (it->connections == 0) {
+        it->handshakes.refill(m_clock.elapsed());
+        if (it->handshakes.isFull())
+            m_addresses.erase(it);
+    }
+}
+
+/*!
+    \internal
+    Returns \a address with IPv4 addresses mapped to IPv6 converted to IPv4,
+    so that a peer is counted once whatever the protocol of the server.
+ */
+QHostAddress QWebSocketAdmissionControl::normalized(const QHostAddress &address)
+{
+    bool isIPv4 = false;
+    const quint32 ipv4 = address.toIPv4Address(&isIPv4);
+    return isIPv4 ? QHostAddress(ipv4) : address;
+}
+
+/*!
+    \internal
+    Forgets the addresses that have no connection and whose handshake budget
+    has been refilled; they are in the same state as unknown addresses.
+ */
+void QWebSocketAdmissionControl::prune()
+{
+    const qint64 now = m_clock.elapsed();
+    m_addresses.removeIf([now](QHash<QHostAddress, AddressState>::iterator it) {
+        AddressState &state = it.value();
+        state.handshakes.refill(now);
+        return state.connections == 0 && state.handshakes.isFull();
+    });
+    // do not prune on every new address while many are active
+    m_pruneThreshold = qMax(qsizetype(1024), 2 * m_addresses.size());
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,65 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETADMISSIONCONTROL_P_H
+#define QWEBSOCKETADMISSIONCONTROL_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtNetwork/QHostAddress>
+
+#include "qwebsockettokenbucket_p.h"
+
+QT_BEGIN_NAMESPACE
+
+// Decides whether a QWebSocketServer takes on a new connection, before
+// anything is read from it: limits the rate of handshakes of the server, and
+// the number of connections and the rate of handshakes per peer address.
+class QWebSocketAdmissionControl
+{
+public:
+    QWebSocketAdmissionControl();
+
+    void setHandshakeRate(int handshakesPerSecond);
+    int handshakeRate() const;
+    void setMaxConnectionsPerAddress(int maxConnections);
+    int maxConnectionsPerAddress() const;
+    void setHandshakeRatePerAddress(int handshakesPerSecond);
+    int handshakeRatePerAddress() const;
+
+    bool tracksAddresses() const;
+    bool admit(const QHostAddress &address, int *retryAfterSeconds);
+    void release(const QHostAddress &address);
+
+    static QHostAddress normalized(const QHostAddress &address);
+
+private:
+    struct AddressState
+    {
+        int connections = 0;
+        QWebSocketTokenBucket handshakes;
+    };
+
+    void prune();
+
+    QElapsedTimer m_clock;
+    QWebSocketTokenBucket m_handshakes;
+    QHash<QHostAddress, AddressState> m_addresses;
+    qsizetype m_pruneThreshold = 1024;
+    int m_maxConnectionsPerAddress = 0;
+    int m_handshakeRatePerAddress = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETADMISSIONCONTROL_P_H
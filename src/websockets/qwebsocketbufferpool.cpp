@@ -0,0 +1,227 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+/*!
+    \class QWebSocketBufferPool
+    The class QWebSocketBufferPool keeps per-thread free lists of byte and
+    string buffers, organised in power-of-two size classes ranging from
+    MinimumBufferSize up to MaximumBufferSize.
+
+    Frame payloads, message assembly and outgoing frame assembly take their
+    buffers from the pool of the current thread and hand them back when they
+    are done, so steady-state traffic does not need to allocate.
+    A buffer is only taken back when nobody else shares it; requests larger
+    than MaximumBufferSize are always served by a plain allocation.
+
+    statistics() reports how many requests were served from the pool and how
+    many had to allocate.
+
+    \internal
+*/
+
+#include "qwebsocketbufferpool_p.h"
+
+#include <QtCore/QVarLengthArray>
+
+#include <array>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// 128 bytes, 256 bytes, ..., 1 MiB
+constexpr int SizeClassCount = 14;
+static_assert((QWebSocketBufferPool::MinimumBufferSize << (SizeClassCount - 1))
+              == QWebSocketBufferPool::MaximumBufferSize);
+
+constexpr qsizetype capacityOf(int sizeClass)
+{
+    return QWebSocketBufferPool::MinimumBufferSize << sizeClass;
+}
+
+// keep more of the small buffers around than of the large ones
+constexpr qsizetype maxBuffersFor(int sizeClass)
+{
+    return sizeClass < 6 ? 8 : (sizeClass < 10 ? 4 : 2);
+}
+
+// smallest size class that can hold size elements, or -1 if there is none
+int sizeClassFor(qsizetype size)
+{
+    if (size > QWebSocketBufferPool::MaximumBufferSize)
+        return -1;
+    int sizeClass = 0;
+    while (capacityOf(sizeClass) < size)
+        ++sizeClass;
+    return sizeClass;
+}
+
+// size class a buffer with the given capacity can serve, or -1 if it
+// is too small or too large to be kept
+int sizeClassOfCapacity(qsizetype capacity)
+{
+    if (capacity < QWebSocketBufferPool::MinimumBufferSize)
+        return -1;
+    int sizeClass = 0;
+    while (sizeClass + 1 < SizeClassCount && capacityOf(sizeClass + 1) <= capacity)
+        ++sizeClass;
+    // do not hoard buffers that grew far beyond the largest size class
+    if (capacity >= 2 * capacityOf(sizeClass))
+        return -1;
+    return sizeClass;
+}
+
+template <typename T>
+using FreeLists = std::array<QVarLengthArray<T, 8>, SizeClassCount>;
+
+// Sockets can outlive the pool of their thread, e.g. when they are destroyed
+// while thread-local storage is torn down; the pool is bypassed from then on.
+thread_local bool threadPoolDestroyed = false;
+
+struct ThreadPool
+{
+    ~ThreadPool() { threadPoolDestroyed = true; }
+
+    FreeLists<QByteArray> bytes;
+    FreeLists<QString> strings;
+    QWebSocketBufferPool::Statistics statistics;
+
+    FreeLists<QByteArray> &freeLists(const QByteArray *) { return bytes; }
+    FreeLists<QString> &freeLists(const QString *) { return strings; }
+};
+
+ThreadPool *threadPool()
+{
+    if (Q_UNLIKELY(threadPoolDestroyed))
+        return nullptr;
+    static thread_local ThreadPool pool;
+    return &pool;
+}
+
+template <typename T>
+T acquire(qsizetype size)
+{
+    ThreadPool *pool = threadPool();
+    const int sizeClass = pool ? sizeClassFor(size) : -1;
+    T buffer;
+    if (sizeClass >= 0) {
+        auto &freeList = pool->freeLists(&buffer)[sizeClass];
+        if (!freeList.isEmpty()) {
+            buffer = std::move(freeList.last());
+            freeList.removeLast();
+            ++pool->statistics.hits;
+            buffer.resize(size);
+            return buffer;
+        }
+        buffer.reserve(capacityOf(sizeClass));
+    }
+    if (pool)
+        ++pool->statistics.misses;
+    buffer.resize(size);
+    return buffer;
+}
+
+template <typename T>
+void release(T &buffer)
+{
+    const int sizeClass = buffer.isDetached() ? sizeClassOfCapacity(buffer.capacity()) : -1;
+    ThreadPool *pool = sizeClass >= 0 ? threadPool() : nullptr;
+    if (pool) {
+        auto &freeList = pool->freeLists(&buffer)[sizeClass];
+        if (freeList.size() < maxBuffersFor(sizeClass)) {
+            // resizing to zero keeps the allocation
+            buffer.resize(0);
+            freeList.append(std::move(buffer));
+            ++pool->statistics.recycled;
+        }
+    }
+    buffer = T();
+}
+
+template <typename T>
+qsizetype trimFreeLists(FreeLists<T> &freeLists)
+{
+    qsizetype freed = 0;
+    for (auto &freeList : freeLists) {
+        for (const T &buffer : std::as_const(freeList))
+            freed += buffer.capacity() * qsizetype(sizeof(typename T::value_type));
+        freeList.clear();
+    }
+    return freed;
+}
+
+} // namespace
+
+/*!
+    \internal
+
+    Returns a buffer of \a size bytes with undefined contents.
+ */
+QByteArray QWebSocketBufferPool::acquireBytes(qsizetype size)
+{
+    return acquire<QByteArray>(size);
+}
+
+/*!
+    \internal
+
+    Hands \a buffer back to the pool of the current thread and leaves it null.
+ */
+void QWebSocketBufferPool::releaseBytes(QByteArray &buffer)
+{
+    release(buffer);
+}
+
+/*!
+    \internal
+
+    Returns a string of \a size characters with undefined contents.
+ */
+QString QWebSocketBufferPool::acquireString(qsizetype size)
+{
+    return acquire<QString>(size);
+}
+
+/*!
+    \internal
+
+    Hands \a buffer back to the pool of the current thread and leaves it null.
+ */
+void QWebSocketBufferPool::releaseString(QString &buffer)
+{
+    release(buffer);
+}
+
+/*!
+    \internal
+
+    Returns the counters of the pool of the current thread.
+ */
+QWebSocketBufferPool::Statistics QWebSocketBufferPool::statistics()
+{
+    const ThreadPool *pool = threadPool();
+    return pool ? pool->statistics : Statistics();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketBufferPool::resetStatistics()
+{
+    if (ThreadPool *pool = threadPool())
+        pool->statistics = {};
+}
+
+/*!
+    \internal
+
+    Frees all buffers kept by the pool of the current thread and returns the
+    number of bytes that were released.
+ */
+qsizetype QWebSocketBufferPool::trim()
+{
+    ThreadPool *pool = threadPool();
+    return pool ? trimFreeLists(pool->bytes) + trimFreeLists(pool->strings) : 0;
+}
+
+QT_END_NAMESPACE
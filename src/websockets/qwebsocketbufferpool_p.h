@@ -0,0 +1,53 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETBUFFERPOOL_P_H
+#define QWEBSOCKETBUFFERPOOL_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+#include "qwebsockets_global.h"
+
+QT_BEGIN_NAMESPACE
+
+class Q_AUTOTEST_EXPORT QWebSocketBufferPool
+{
+public:
+    struct Statistics
+    {
+        quint64 hits = 0;       // buffers handed out from the pool
+        quint64 misses = 0;     // buffers that had to be allocated
+        quint64 recycled = 0;   // buffers taken back into the pool
+    };
+
+    static constexpr qsizetype MinimumBufferSize = 128;
+    static constexpr qsizetype MaximumBufferSize = 1024 * 1024;
+
+    static QByteArray acquireBytes(qsizetype size);
+    static void releaseBytes(QByteArray &buffer);
+    static QString acquireString(qsizetype size);
+    static void releaseString(QString &buffer);
+
+    static Statistics statistics();
+    static void resetStatistics();
+    static qsizetype trim();
+
+private:
+    QWebSocketBufferPool() = delete;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETBUFFERPOOL_P_H
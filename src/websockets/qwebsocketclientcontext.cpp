@@ -0,0 +1,273 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+/*!
+    \class QWebSocketClientContext
+
+    \inmodule QtWebSockets
+    \since 6.9
+
+    \brief The QWebSocketClientContext class shares what clients learn about
+    the servers they connect to, so that reconnecting is faster.
+
+    Every QWebSocket::open() on its own looks up the address of the host, and
+    does a full TLS handshake for a \c wss URL, even if the same process has
+    connected to the same host a moment ago. Clients that share a
+    QWebSocketClientContext, set with QWebSocket::setClientContext(), reuse
+    instead:
+
+    \list
+        \li the address a host name has recently been resolved to, for
+            addressCacheTimeout(). Connections through a proxy do not use
+            the cache, and an address a connection could not be established
+            to is dropped from the cache.
+        \li the TLS session of the last secure connection to the same host
+            and port, which the server can resume with an abbreviated
+            handshake if it supports session tickets. Sessions of connections
+            that ignored SSL errors are not kept.
+    \endlist
+
+    The addresses and the sessions of at most 256 hosts each are kept.
+
+    The statistics of the context, such as sessionResumptionRate(), tell how
+    often these are reused.
+
+    A QWebSocketClientContext can be shared by clients living in different
+    threads, and has to outlive them.
+
+    \sa QWebSocket::setClientContext()
+*/
+
+#include "qwebsocketclientcontext.h"
+#include "qwebsocketclientcontext_p.h"
+
+#include <QtCore/QMutexLocker>
+#include <QtCore/QUrl>
+
+QT_BEGIN_NAMESPACE
+
+// how many hosts the address cache and the session cache each hold at most
+constexpr qsizetype MAX_CACHED_HOSTS = 256;
+
+/*!
+    \internal
+ */
+QWebSocketClientContextPrivate::QWebSocketClientContextPrivate()
+{
+    m_clock.start();
+}
+
+/*!
+    \internal
+    Returns the address \a hostName has been resolved to, if it has been
+    within the address cache timeout, and counts the cache hit. Otherwise,
+    returns a null address.
+ */
+QHostAddress QWebSocketClientContextPrivate::cachedAddress(const QString &hostName)
+{
+    QMutexLocker locker(&m_mutex);
+    const auto it = m_addresses.constFind(hostName);
+    if (it == m_addresses.cend())
+        return QHostAddress();
+    if (it->expiry <= m_clock.elapsed()) {
+        m_addresses.erase(it);
+        return QHostAddress();
+    }
+    ++m_addressCacheHits;
+    return it->address;
+}
+
+/*!
+    \internal
+ */
+void QWebSocketClientContextPrivate::cacheAddress(const QString &hostName,
+                                                  const QHostAddress &address)
+{
+    QMutexLocker locker(&m_mutex);
+    if (address.isNull() || m_addressCacheTimeout <= std::chrono::milliseconds::zero())
+        return;
+    const qint64 now = m_clock.elapsed();
+    if (m_addresses.size() >= MAX_CACHED_HOSTS && !m_addresses.contains(hostName)) {
+        // make room by sweeping the expired addresses, or evicting any
+        m_addresses.removeIf([now](QHash<QString, CachedAddress>::iterator it) {
+            return it->expiry <= now;
+        });
+        if (m_addresses.size() >= MAX_CACHED_HOSTS)
+            m_addresses.erase(m_addresses.cbegin());
+    }
+    m_addresses.insert(hostName, { address, now + m_addressCacheTimeout.count() });
+}
+
+/*!
+    \internal
+ */
+void QWebSocketClientContextPrivate::dropAddress(const QString &hostName)
+{
+    QMutexLocker locker(&m_mutex);
+    m_addresses.remove(hostName);
+}
+
+/*!
+    \internal
+    Returns the key of the TLS sessions with the server of \a url.
+ */
+QString QWebSocketClientContextPrivate::sessionKey(const QUrl &url)
+{
+    return url.host() + QLatin1Char(':') + QString::number(url.port(443));
+}
+
+/*!
+    \internal
+ */
+QByteArray QWebSocketClientContextPrivate::sessionTicket(const QString &key)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_sessionTickets.value(key);
+}
+
+/*!
+    \internal
+ */
+void QWebSocketClientContextPrivate::storeSessionTicket(const QString &key,
+                                                        const QByteArray &ticket)
+{
+    QMutexLocker locker(&m_mutex);
+    if (ticket.isEmpty())
+        return;
+    if (m_sessionTickets.size() >= MAX_CACHED_HOSTS && !m_sessionTickets.contains(key))
+        m_sessionTickets.erase(m_sessionTickets.cbegin());
+    m_sessionTickets.insert(key, ticket);
+}
+
+/*!
+    \internal
+ */
+void QWebSocketClientContextPrivate::noteConnection(bool isSecure, bool isResumingSession)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_connectionCount;
+    if (isSecure)
+        ++m_secureConnectionCount;
+    if (isResumingSession)
+        ++m_sessionResumptionCount;
+}
+
+/*!
+    Creates a QWebSocketClientContext with the given \a parent.
+ */
+QWebSocketClientContext::QWebSocketClientContext(QObject *parent) :
+    QObject(*(new QWebSocketClientContextPrivate), parent)
+{
+}
+
+/*!
+    Destroys the QWebSocketClientContext.
+ */
+QWebSocketClientContext::~QWebSocketClientContext()
+{
+}
+
+#if __has_include(<chrono>)
+/*!
+    Keeps the address a host name has been resolved to for \a timeout. The
+    default is one minute; a value of 0 disables the address cache.
+
+    \sa addressCacheTimeout()
+ */
+void QWebSocketClientContext::setAddressCacheTimeout(std::chrono::milliseconds timeout)
+{
+    Q_D(QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    d->m_addressCacheTimeout = qMax(timeout, std::chrono::milliseconds::zero());
+    if (d->m_addressCacheTimeout == std::chrono::milliseconds::zero())
+        d->m_addresses.clear();
+}
+
+/*!
+    Returns how long the address a host name has been resolved to is kept.
+
+    \sa setAddressCacheTimeout()
+ */
+std::chrono::milliseconds QWebSocketClientContext::addressCacheTimeout() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_addressCacheTimeout;
+}
+#endif
+
+/*!
+    Forgets all cached addresses and TLS sessions. The statistics are kept.
+ */
+void QWebSocketClientContext::clear()
+{
+    Q_D(QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    d->m_addresses.clear();
+    d->m_sessionTickets.clear();
+}
+
+/*!
+    Returns the number of connections opened with this context.
+ */
+quint64 QWebSocketClientContext::connectionCount() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_connectionCount;
+}
+
+/*!
+    Returns the number of connections that used a cached address instead of
+    looking up the host name.
+ */
+quint64 QWebSocketClientContext::addressCacheHits() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_addressCacheHits;
+}
+
+/*!
+    Returns the number of secure connections opened with this context.
+ */
+quint64 QWebSocketClientContext::secureConnectionCount() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_secureConnectionCount;
+}
+
+/*!
+    Returns the number of secure connections that offered the server a TLS
+    session to resume.
+
+    \note Whether the server accepted to resume the session is not reported
+    by QSslSocket; servers that do not support session tickets do a full
+    handshake.
+
+    \sa sessionResumptionRate()
+ */
+quint64 QWebSocketClientContext::sessionResumptionCount() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    return d->m_sessionResumptionCount;
+}
+
+/*!
+    Returns the share of secure connections that offered the server a TLS
+    session to resume, between 0 and 1.
+
+    \sa sessionResumptionCount(), secureConnectionCount()
+ */
+qreal QWebSocketClientContext::sessionResumptionRate() const
+{
+    Q_D(const QWebSocketClientContext);
+    QMutexLocker locker(&d->m_mutex);
+    if (d->m_secureConnectionCount == 0)
+        return 0;
+    return qreal(d->m_sessionResumptionCount) / qreal(d->m_secureConnectionCount);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,43 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETCLIENTCONTEXT_H
+#define QWEBSOCKETCLIENTCONTEXT_H
+
+#include <QtCore/QObject>
+#include "QtWebSockets/qwebsockets_global.h"
+
+#if __has_include(<chrono>)
+#include <chrono>
+#endif
+
+QT_BEGIN_NAMESPACE
+
+class QWebSocketClientContextPrivate;
+
+class Q_WEBSOCKETS_EXPORT QWebSocketClientContext : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(QWebSocketClientContext)
+    Q_DECLARE_PRIVATE(QWebSocketClientContext)
+
+public:
+    explicit QWebSocketClientContext(QObject *parent = nullptr);
+    ~QWebSocketClientContext() override;
+
+#if __has_include(<chrono>) || defined(Q_QDOC)
+    void setAddressCacheTimeout(std::chrono::milliseconds timeout);
+    std::chrono::milliseconds addressCacheTimeout() const;
+#endif
+    void clear();
+
+    quint64 connectionCount() const;
+    quint64 addressCacheHits() const;
+    quint64 secureConnectionCount() const;
+    quint64 sessionResumptionCount() const;
+    qreal sessionResumptionRate() const;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETCLIENTCONTEXT_H
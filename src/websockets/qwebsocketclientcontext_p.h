@@ -0,0 +1,71 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETCLIENTCONTEXT_P_H
+#define QWEBSOCKETCLIENTCONTEXT_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <QtNetwork/QHostAddress>
+#include <private/qobject_p.h>
+
+#include "qwebsocketclientcontext.h"
+
+#include <chrono>
+
+QT_BEGIN_NAMESPACE
+
+class QUrl;
+
+class QWebSocketClientContextPrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QWebSocketClientContext)
+
+public:
+    QWebSocketClientContextPrivate();
+
+    static QWebSocketClientContextPrivate *get(QWebSocketClientContext *context)
+    { return context->d_func(); }
+
+    QHostAddress cachedAddress(const QString &hostName);
+    void cacheAddress(const QString &hostName, const QHostAddress &address);
+    void dropAddress(const QString &hostName);
+
+    static QString sessionKey(const QUrl &url);
+    QByteArray sessionTicket(const QString &key);
+    void storeSessionTicket(const QString &key, const QByteArray &ticket);
+
+    void noteConnection(bool isSecure, bool isResumingSession);
+
+    struct CachedAddress
+    {
+        QHostAddress address;
+        qint64 expiry = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QElapsedTimer m_clock;
+    std::chrono::milliseconds m_addressCacheTimeout{ 60000 };
+    QHash<QString, CachedAddress> m_addresses;
+    QHash<QString, QByteArray> m_sessionTickets;
+    quint64 m_connectionCount = 0;
+    quint64 m_addressCacheHits = 0;
+    quint64 m_secureConnectionCount = 0;
+    quint64 m_sessionResumptionCount = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETCLIENTCONTEXT_P_H
@@ -0,0 +1,198 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qwebsocketcompression_p.h"
+
+#include <QtCore/QtEndian>
+
+#if QT_CONFIG(websockets_lz4)
+#include <lz4.h>
+#endif
+#if QT_CONFIG(websockets_zstd)
+#include <zstd.h>
+#endif
+
+#include <limits>
+
+QT_BEGIN_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+#if QT_CONFIG(websockets_lz4)
+
+/*!
+    \internal
+    \class QWebSocketLz4Extension
+
+    Creates an extension compressing with the given \a acceleration; higher
+    values are faster and compress less.
+ */
+QWebSocketLz4Extension::QWebSocketLz4Extension(int acceleration, QObject *parent) :
+    QWebSocketExtension(parent),
+    m_acceleration(qMax(acceleration, 1))
+{
+}
+
+/*!
+    \internal
+ */
+QString QWebSocketLz4Extension::name() const
+{
+    return u"x-qt-lz4"_s;
+}
+
+/*!
+    \internal
+ */
+QWebSocketExtension::ReservedBits QWebSocketLz4Extension::reservedBits() const
+{
+    return Rsv2;
+}
+
+/*!
+    \internal
+ */
+bool QWebSocketLz4Extension::encode(const QByteArray &payload, QByteArray *encoded) const
+{
+    if (payload.size() < MIN_COMPRESSED_MESSAGE_SIZE || payload.size() > LZ4_MAX_INPUT_SIZE)
+        return false;
+    const int bound = LZ4_compressBound(int(payload.size()));
+    QByteArray result(qsizetype(sizeof(quint32)) + bound, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(payload.size()), result.data());
+    const int size = LZ4_compress_fast(payload.constData(), result.data() + sizeof(quint32),
+                                       int(payload.size()), bound, m_acceleration);
+    // sent as it is if it does not get any smaller
+    if (size <= 0 || qsizetype(sizeof(quint32)) + size >= payload.size())
+        return false;
+    result.truncate(qsizetype(sizeof(quint32)) + size);
+    *encoded = std::move(result);
+    return true;
+}
+
+/*!
+    \internal
+ */
+bool QWebSocketLz4Extension::decode(const QByteArray &payload, qint64 maxSize,
+                                    QByteArray *decoded) const
+{
+    if (payload.size() < qsizetype(sizeof(quint32)))
+        return false;
+    const quint32 size = qFromLittleEndian<quint32>(payload.constData());
+    // checked before anything is allocated
+    if (qint64(size) > maxSize || size > quint32(std::numeric_limits<int>::max()))
+        return false;
+    QByteArray result(qsizetype(size), Qt::Uninitialized);
+    const int decodedSize = LZ4_decompress_safe(payload.constData() + sizeof(quint32),
+                                                result.data(),
+                                                int(payload.size() - sizeof(quint32)), int(size));
+    if (decodedSize != int(size))
+        return false;
+    *decoded = std::move(result);
+    return true;
+}
+
+#endif // QT_CONFIG(websockets_lz4)
+
+#if QT_CONFIG(websockets_zstd)
+
+namespace {
+
+// the contexts are kept per thread, as an extension may be used by the
+// connections of several threads at once
+struct ZstdContexts
+{
+    ZstdContexts() = default;
+    Q_DISABLE_COPY_MOVE(ZstdContexts)
+    ~ZstdContexts()
+    {
+        ZSTD_freeCCtx(compression);
+        ZSTD_freeDCtx(decompression);
+    }
+
+    ZSTD_CCtx *compression = ZSTD_createCCtx();
+    ZSTD_DCtx *decompression = ZSTD_createDCtx();
+};
+
+ZstdContexts &zstdContexts()
+{
+    thread_local ZstdContexts contexts;
+    return contexts;
+}
+
+} // namespace
+
+/*!
+    \internal
+    \class QWebSocketZstdExtension
+
+    Creates an extension compressing at the given \a level; -1 selects the
+    default level of the library.
+ */
+QWebSocketZstdExtension::QWebSocketZstdExtension(int level, QObject *parent) :
+    QWebSocketExtension(parent),
+    m_level(level == -1 ? ZSTD_CLEVEL_DEFAULT : qBound(ZSTD_minCLevel(), level, ZSTD_maxCLevel()))
+{
+}
+
+/*!
+    \internal
+ */
+QString QWebSocketZstdExtension::name() const
+{
+    return u"x-qt-zstd"_s;
+}
+
+/*!
+    \internal
+ */
+QWebSocketExtension::ReservedBits QWebSocketZstdExtension::reservedBits() const
+{
+    return Rsv3;
+}
+
+/*!
+    \internal
+ */
+bool QWebSocketZstdExtension::encode(const QByteArray &payload, QByteArray *encoded) const
+{
+    if (payload.size() < MIN_COMPRESSED_MESSAGE_SIZE)
+        return false;
+    const size_t bound = ZSTD_compressBound(size_t(payload.size()));
+    QByteArray result(qsizetype(bound), Qt::Uninitialized);
+    const size_t size = ZSTD_compressCCtx(zstdContexts().compression, result.data(), bound,
+                                          payload.constData(), size_t(payload.size()), m_level);
+    // sent as it is if it does not get any smaller
+    if (ZSTD_isError(size) || size >= size_t(payload.size()))
+        return false;
+    result.truncate(qsizetype(size));
+    *encoded = std::move(result);
+    return true;
+}
+
+/*!
+    \internal
+ */
+bool QWebSocketZstdExtension::decode(const QByteArray &payload, qint64 maxSize,
+                                     QByteArray *decoded) const
+{
+    const unsigned long long size = ZSTD_getFrameContentSize(payload.constData(),
+                                                             size_t(payload.size()));
+    // checked before anything is allocated
+    if (size == ZSTD_CONTENTSIZE_UNKNOWN || size == ZSTD_CONTENTSIZE_ERROR
+            || size > quint64(qMax(maxSize, qint64(0)))
+            || size > quint64(std::numeric_limits<int>::max())) {
+        return false;
+    }
+    QByteArray result(qsizetype(size), Qt::Uninitialized);
+    const size_t decodedSize = ZSTD_decompressDCtx(zstdContexts().decompression, result.data(),
+                                                   size_t(size), payload.constData(),
+                                                   size_t(payload.size()));
+    if (ZSTD_isError(decodedSize) || decodedSize != size)
+        return false;
+    *decoded = std::move(result);
+    return true;
+}
+
+#endif // QT_CONFIG(websockets_zstd)
+
+QT_END_NAMESPACE
@@ -0,0 +1,69 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETCOMPRESSION_P_H
+#define QWEBSOCKETCOMPRESSION_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtWebSockets/private/qtwebsockets-config_p.h>
+
+#include "qwebsocketextension.h"
+
+QT_BEGIN_NAMESPACE
+
+// Messages shorter than this are not worth compressing.
+constexpr qsizetype MIN_COMPRESSED_MESSAGE_SIZE = 64;
+
+#if QT_CONFIG(websockets_lz4)
+// Compresses each message into one LZ4 block, preceded by the size of the
+// message as a 32-bit little endian number, as the block format does not
+// record it.
+class QWebSocketLz4Extension : public QWebSocketExtension
+{
+    Q_OBJECT
+
+public:
+    explicit QWebSocketLz4Extension(int acceleration, QObject *parent = nullptr);
+
+    QString name() const override;
+    ReservedBits reservedBits() const override;
+    bool encode(const QByteArray &payload, QByteArray *encoded) const override;
+    bool decode(const QByteArray &payload, qint64 maxSize, QByteArray *decoded) const override;
+
+private:
+    int m_acceleration;
+};
+#endif // QT_CONFIG(websockets_lz4)
+
+#if QT_CONFIG(websockets_zstd)
+// Compresses each message into one Zstandard frame, which records the size of
+// the message.
+class QWebSocketZstdExtension : public QWebSocketExtension
+{
+    Q_OBJECT
+
+public:
+    explicit QWebSocketZstdExtension(int level, QObject *parent = nullptr);
+
+    QString name() const override;
+    ReservedBits reservedBits() const override;
+    bool encode(const QByteArray &payload, QByteArray *encoded) const override;
+    bool decode(const QByteArray &payload, qint64 maxSize, QByteArray *decoded) const override;
+
+private:
+    int m_level;
+};
+#endif // QT_CONFIG(websockets_zstd)
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETCOMPRESSION_P_H
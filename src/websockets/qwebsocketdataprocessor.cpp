@@ -19,19 +19,68 @@
     \internal
 */
 #include "qwebsocketdataprocessor_p.h"
+#include "qwebsocketextension.h"
 #include "qwebsocketprotocol.h"
 #include "qwebsocketprotocol_p.h"
 #include "qwebsocketframe_p.h"
+#include "qwebsocketbufferpool_p.h"
+#include "qwebsocketmemorybudget_p.h"
 
 #include <QtCore/QtEndian>
 #include <QtCore/QDebug>
 #include <QtCore/QIODevice>
 #include <QtCore/QStringDecoder>
+#include <QtCore/QTimerEvent>
 
 #include <limits.h>
 
 QT_BEGIN_NAMESPACE
 
+namespace {
+
+void acquireBuffer(QByteArray &buffer, qsizetype size)
+{
+    buffer = QWebSocketBufferPool::acquireBytes(size);
+}
+
+void acquireBuffer(QString &buffer, qsizetype size)
+{
+    buffer = QWebSocketBufferPool::acquireString(size);
+}
+
+void releaseBuffer(QByteArray &buffer)
+{
+    QWebSocketBufferPool::releaseBytes(buffer);
+}
+
+void releaseBuffer(QString &buffer)
+{
+    QWebSocketBufferPool::releaseString(buffer);
+}
+
+// The first fragment of a message is shared rather than copied; when more
+// fragments follow, the message grows into buffers taken from the pool.
+template <typename T>
+void appendToMessage(T &message, const T &fragment)
+{
+    if (message.isNull()) {
+        message = fragment;
+        return;
+    }
+    const qsizetype requiredSize = message.size() + fragment.size();
+    if (!message.isDetached() || requiredSize > message.capacity()) {
+        T grown;
+        acquireBuffer(grown, qMax(requiredSize, 2 * message.size()));
+        std::copy(message.cbegin(), message.cend(), grown.begin());
+        grown.resize(message.size());
+        releaseBuffer(message);
+        message = std::move(grown);
+    }
+    message.append(fragment);
+}
+
+} // namespace
+
 /*!
     \internal
  */
@@ -49,14 +98,11 @@ QWebSocketDataProcessor::QWebSocketDataProcessor(QObject *parent) :
     m_payloadLength(0),
     m_decoder(QStringDecoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless
         | QStringDecoder::Flag::ConvertInvalidToNull)),
-    m_waitTimer(new QChronoTimer(this))
+    m_waitTimer(),
+    m_idleTimeout(std::chrono::seconds(5))
 {
+    m_rateLimitClock.start();
     clear();
-    // initialize the internal timeout timer
-    using namespace std::chrono_literals;
-    m_waitTimer->setInterval(5s);
-    m_waitTimer->setSingleShot(true);
-    m_waitTimer->callOnTimeout(this, &QWebSocketDataProcessor::timeout);
 }
 
 /*!
@@ -115,8 +161,8 @@ quint64 QWebSocketDataProcessor::maxFrameSize()
 */
 void QWebSocketDataProcessor::setIdleTimeout(std::chrono::milliseconds timeout)
 {
-    Q_ASSERT(!m_waitTimer->isActive());
-    m_waitTimer->setInterval(timeout);
+    Q_ASSERT(!m_waitTimer.isActive());
+    m_idleTimeout = timeout;
 }
 
 /*!
@@ -124,8 +170,276 @@ void QWebSocketDataProcessor::setIdleTimeout(std::chrono::milliseconds timeout)
 */
 std::chrono::milliseconds QWebSocketDataProcessor::idleTimeout() const
 {
-    using namespace std::chrono;
-    return duration_cast<milliseconds>(m_waitTimer->interval());
+    return m_idleTimeout;
+}
+
+/*!
+    \internal
+
+    In passthrough mode, data frames are emitted with dataFrameReceived() as
+    they arrive, instead of being assembled into messages; text frames are
+    not decoded. Control frames are processed as usual.
+    This must only be changed between messages.
+*/
+void QWebSocketDataProcessor::setPassthrough(bool passthrough)
+{
+    m_isPassthrough = passthrough;
+}
+
+/*!
+    \internal
+*/
+bool QWebSocketDataProcessor::isPassthrough() const
+{
+    return m_isPassthrough;
+}
+
+/*!
+    \internal
+
+    Sets the memory \a budget of the server this processor belongs to. While
+    the budget is exceeded, it may reject messages that are too large.
+*/
+void QWebSocketDataProcessor::setMemoryBudget(const QWebSocketMemoryBudget *budget)
+{
+    m_memoryBudget = budget;
+}
+
+/*!
+    \internal
+
+    Returns the number of bytes held by the message being assembled.
+*/
+qint64 QWebSocketDataProcessor::bufferedBytes() const
+{
+    return qint64(m_textMessage.size()) * qint64(sizeof(QChar)) + m_binaryMessage.size()
+            + m_encodedMessage.size();
+}
+
+/*!
+    \internal
+
+    Sets the \a extensions negotiated for the connection, in the order in
+    which they encode outgoing messages. Data frames may only have the
+    reserved bits of these extensions set; messages that have them set are
+    decoded in reverse order once they are complete, and are then delivered
+    as a single frame.
+    This must only be changed between messages.
+*/
+void QWebSocketDataProcessor::setExtensions(const QList<QPointer<QWebSocketExtension>> &extensions)
+{
+    m_extensions = extensions;
+    quint8 reservedBits = 0;
+    for (const QPointer<QWebSocketExtension> &extension : extensions) {
+        if (extension)
+            reservedBits |= quint8(extension->reservedBits().toInt());
+    }
+    frame.setAllowedReservedBits(reservedBits);
+}
+
+/*!
+    \internal
+
+    Limits the payload of the incoming frames to \a bytesPerSecond; 0 means
+    no limit.
+*/
+void QWebSocketDataProcessor::setByteRateLimit(qint64 bytesPerSecond)
+{
+    m_byteBucket.setRate(qMax(bytesPerSecond, qint64(0)), m_rateLimitClock.elapsed());
+}
+
+/*!
+    \internal
+*/
+qint64 QWebSocketDataProcessor::byteRateLimit() const
+{
+    return m_byteBucket.rate();
+}
+
+/*!
+    \internal
+
+    Limits the incoming data messages to \a messagesPerSecond; 0 means no
+    limit.
+*/
+void QWebSocketDataProcessor::setMessageRateLimit(int messagesPerSecond)
+{
+    m_messageBucket.setRate(qMax(messagesPerSecond, 0), m_rateLimitClock.elapsed());
+}
+
+/*!
+    \internal
+*/
+int QWebSocketDataProcessor::messageRateLimit() const
+{
+    return int(m_messageBucket.rate());
+}
+
+/*!
+    \internal
+
+    Limits the incoming ping and pong frames to \a framesPerSecond; 0 means
+    no limit. Close frames are never limited.
+*/
+void QWebSocketDataProcessor::setControlFrameRateLimit(int framesPerSecond)
+{
+    m_controlFrameBucket.setRate(qMax(framesPerSecond, 0), m_rateLimitClock.elapsed());
+}
+
+/*!
+    \internal
+*/
+int QWebSocketDataProcessor::controlFrameRateLimit() const
+{
+    return int(m_controlFrameBucket.rate());
+}
+
+/*!
+    \internal
+
+    Sets what happens to frames beyond the rate limits to \a policy.
+*/
+void QWebSocketDataProcessor::setRateLimitPolicy(QWebSocket::RateLimitPolicy policy)
+{
+    m_rateLimitPolicy = policy;
+}
+
+/*!
+    \internal
+*/
+QWebSocket::RateLimitPolicy QWebSocketDataProcessor::rateLimitPolicy() const
+{
+    return m_rateLimitPolicy;
+}
+
+/*!
+    \internal
+
+    Returns how many times a rate limit has been hit: how many times reading
+    has been delayed, or how many frames or messages have been dropped or
+    closed on, depending on the policy.
+*/
+quint64 QWebSocketDataProcessor::rateLimitHits() const
+{
+    return m_rateLimitHits;
+}
+
+/*!
+    \internal
+
+    Returns the number of milliseconds the caller has to wait before handing
+    more data to process(), if reading is delayed by the rate limits, and
+    counts a hit if it has to wait; otherwise returns 0.
+*/
+qint64 QWebSocketDataProcessor::readingDelay()
+{
+    if (Q_LIKELY(m_rateLimitPolicy != QWebSocket::DelayReading || !hasRateLimits()))
+        return 0;
+    refillRateLimits();
+    const qint64 delay = qMax(m_byteBucket.msecsUntilAvailable(),
+                              qMax(m_messageBucket.msecsUntilAvailable(),
+                                   m_controlFrameBucket.msecsUntilAvailable()));
+    if (delay > 0)
+        ++m_rateLimitHits;
+    return delay;
+}
+
+/*!
+    \internal
+*/
+bool QWebSocketDataProcessor::hasRateLimits() const
+{
+    return m_byteBucket.isLimited() || m_messageBucket.isLimited()
+            || m_controlFrameBucket.isLimited();
+}
+
+/*!
+    \internal
+*/
+void QWebSocketDataProcessor::refillRateLimits()
+{
+    const qint64 now = m_rateLimitClock.elapsed();
+    m_byteBucket.refill(now);
+    m_messageBucket.refill(now);
+    m_controlFrameBucket.refill(now);
+}
+
+/*!
+    \internal
+
+    Charges the complete \a frame to the rate limits, and returns \c true;
+    the buckets may go into debt, which delays the next frames. Returns
+    \c false, without charging it, if the frame is beyond the limits and has
+    to be dropped or closed on according to the policy.
+
+    When reading is delayed, the caller checks readingDelay() before every
+    frame instead. When dropping, only the first frame of a message is
+    checked, so that messages are dropped as a whole.
+*/
+bool QWebSocketDataProcessor::chargeRateLimits(const QWebSocketFrame &frame)
+{
+    if (Q_LIKELY(!hasRateLimits()))
+        return true;
+    refillRateLimits();
+    const bool isFirstFrame = !frame.isControlFrame() && !frame.isContinuationFrame();
+    const bool isChecked = m_rateLimitPolicy == QWebSocket::CloseConnection
+            || (m_rateLimitPolicy == QWebSocket::DropExcess
+                && (isFirstFrame || frame.isControlFrame()));
+    if (isChecked) {
+        const bool isAvailable = frame.isControlFrame()
+                ? m_controlFrameBucket.isAvailable()
+                : m_byteBucket.isAvailable() && (!isFirstFrame || m_messageBucket.isAvailable());
+        if (Q_UNLIKELY(!isAvailable)) {
+            ++m_rateLimitHits;
+            return false;
+        }
+    }
+    m_byteBucket.take(frame.payload().size());
+    if (frame.isControlFrame())
+        m_controlFrameBucket.take();
+    else if (isFirstFrame)
+        m_messageBucket.take();
+    return true;
+}
+
+/*!
+    \internal
+
+    Returns how many bytes have to be available, on top of \a bytesAvailable,
+    before process() can get any further with the frame being received.
+*/
+qint64 QWebSocketDataProcessor::missingBytes(qint64 bytesAvailable) const
+{
+    return frame.missingBytes(bytesAvailable);
+}
+
+/*!
+    \internal
+
+    Returns the data that has been consumed for the message and the frame
+    being received, encoded as frames again, so that another processor can
+    continue where this one stopped. The fragments received so far are joined
+    into one frame, which is not masked.
+*/
+QByteArray QWebSocketDataProcessor::pendingData() const
+{
+    QByteArray data;
+    if (m_isFragmented) {
+        const QByteArray payload = m_messageReservedBits != 0
+                ? m_encodedMessage
+                : m_opCode == QWebSocketProtocol::OpCodeText
+                  ? m_textMessage.toUtf8() : m_binaryMessage;
+        char header[QWebSocketFrame::MaxHeaderSize];
+        const qsizetype headerSize = QWebSocketFrame::encodeHeader(header, m_opCode,
+                                                                   quint64(payload.size()),
+                                                                   0, false,
+                                                                   m_messageReservedBits);
+        data.reserve(headerSize + payload.size() + QWebSocketFrame::MaxHeaderSize);
+        data.append(header, headerSize);
+        data.append(payload);
+    }
+    data.append(frame.pendingHeader());
+    return data;
 }
 
 /*!
@@ -133,22 +447,35 @@ std::chrono::milliseconds QWebSocketDataProcessor::idleTimeout() const
 
     Returns \c true if a complete websocket frame has been processed;
     otherwise returns \c false.
+
+    The idle timeout only runs while a frame is partially received; it is
+    stopped as soon as new data is handed to process().
  */
 bool QWebSocketDataProcessor::process(QIODevice *pIoDevice)
 {
     bool isDone = false;
 
+    m_waitTimer.stop();
     while (!isDone) {
         frame.readFrame(pIoDevice);
         if (!frame.isDone()) {
             // waiting for more data available
-            QObject::connect(pIoDevice, &QIODevice::readyRead,
-                             m_waitTimer, &QChronoTimer::stop, Qt::UniqueConnection);
-            m_waitTimer->start();
+            m_waitTimer.start(m_idleTimeout, this);
             return false;
         } else if (Q_LIKELY(frame.isValid())) {
             if (frame.isControlFrame()) {
-                isDone = processControlFrame(frame);
+                if (Q_LIKELY(frame.opCode() == QWebSocketProtocol::OpCodeClose
+                             || chargeRateLimits(frame))) {
+                    isDone = processControlFrame(frame);
+                } else if (m_rateLimitPolicy == QWebSocket::CloseConnection) {
+                    clear();
+                    Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodePolicyViolated,
+                                            tr("Rate limit exceeded."));
+                    return true;
+                } else {
+                    // dropped: a ping is not answered
+                    isDone = true;
+                }
             } else {
                 //we have a dataframe; opcode can be OC_CONTINUE, OC_TEXT or OC_BINARY
                 if (Q_UNLIKELY(!m_isFragmented && frame.isContinuationFrame())) {
@@ -166,13 +493,48 @@ bool QWebSocketDataProcessor::process(QIODevice *pIoDevice)
                                                "must have opcode 0 (continuation)."));
                     return true;
                 }
+                if (Q_UNLIKELY(m_isDroppingMessage)) {
+                    // the rest of a message dropped for the rate limits
+                    if (frame.isFinalFrame()) {
+                        m_isDroppingMessage = false;
+                        m_isFragmented = false;
+                        isDone = true;
+                    }
+                    frame.clear();
+                    continue;
+                }
+                if (Q_UNLIKELY(!chargeRateLimits(frame))) {
+                    if (m_rateLimitPolicy == QWebSocket::CloseConnection) {
+                        clear();
+                        Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodePolicyViolated,
+                                                tr("Rate limit exceeded."));
+                        return true;
+                    }
+                    // only the first frame of a message is dropped here
+                    m_isFragmented = !frame.isFinalFrame();
+                    m_isDroppingMessage = m_isFragmented;
+                    isDone = !m_isFragmented;
+                    frame.clear();
+                    continue;
+                }
                 if (!frame.isContinuationFrame()) {
                     m_opCode = frame.opCode();
                     m_isFragmented = !frame.isFinalFrame();
+                    m_messageReservedBits = frame.reservedBits();
+                } else if (Q_UNLIKELY(frame.reservedBits() != 0)) {
+                    clear();
+                    Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeProtocolError,
+                                            tr("Rsv field is non-zero on a continuation " \
+                                               "frame."));
+                    return true;
                 }
-                quint64 messageLength = m_opCode == QWebSocketProtocol::OpCodeText
-                        ? quint64(m_textMessage.size())
-                        : quint64(m_binaryMessage.size());
+                quint64 messageLength = m_messageReservedBits != 0
+                        ? quint64(m_encodedMessage.size())
+                        : m_isPassthrough
+                          ? m_passthroughLength
+                          : m_opCode == QWebSocketProtocol::OpCodeText
+                            ? quint64(m_textMessage.size())
+                            : quint64(m_binaryMessage.size());
                 if (Q_UNLIKELY((messageLength + quint64(frame.payload().size())) >
                                maxAllowedMessageSize())) {
                     clear();
@@ -180,37 +542,83 @@ bool QWebSocketDataProcessor::process(QIODevice *pIoDevice)
                                             tr("Received message is too big."));
                     return true;
                 }
+                if (Q_UNLIKELY(m_memoryBudget && m_memoryBudget->rejectsMessage(
+                                   qint64(messageLength) + frame.payload().size()))) {
+                    clear();
+                    Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeTooMuchData,
+                                            tr("Memory budget of the server exceeded."));
+                    return true;
+                }
 
                 bool isFinalFrame = frame.isFinalFrame();
+                if (m_messageReservedBits != 0) {
+                    QByteArray payload = frame.payload();
+                    frame.clear();
+                    appendToMessage(m_encodedMessage, payload);
+                    QWebSocketBufferPool::releaseBytes(payload);
+                    if (isFinalFrame) {
+                        isDone = true;
+                        if (!processEncodedMessage())
+                            return true;
+                    }
+                    continue;
+                }
+                if (m_isPassthrough) {
+                    QByteArray payload = frame.payload();
+                    const QWebSocketProtocol::OpCode opCode = frame.opCode();
+                    frame.clear();
+                    m_passthroughLength = isFinalFrame
+                            ? 0 : m_passthroughLength + quint64(payload.size());
+                    if (isFinalFrame) {
+                        m_isFragmented = false;
+                        isDone = true;
+                    }
+                    Q_EMIT dataFrameReceived(opCode, payload, isFinalFrame);
+                    // only recycled if the receivers did not keep it
+                    QWebSocketBufferPool::releaseBytes(payload);
+                    continue;
+                }
                 if (m_opCode == QWebSocketProtocol::OpCodeText) {
-                    QString frameTxt = m_decoder(frame.payload());
+                    QByteArray payload = frame.payload();
+                    // UTF-8 never decodes to more UTF-16 code units than it has bytes
+                    QString frameTxt = QWebSocketBufferPool::acquireString(payload.size());
+                    const QChar *end = m_decoder.appendToBuffer(frameTxt.data(), payload);
+                    frameTxt.resize(end - frameTxt.constData());
+                    frame.clear();
+                    QWebSocketBufferPool::releaseBytes(payload);
                     if (Q_UNLIKELY(m_decoder.hasError())) {
+                        QWebSocketBufferPool::releaseString(frameTxt);
                         clear();
                         Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeWrongDatatype,
                                                 tr("Invalid UTF-8 code encountered."));
                         return true;
                     } else {
-                        m_textMessage.append(frameTxt);
-                        frame.clear();
+                        appendToMessage(m_textMessage, frameTxt);
                         Q_EMIT textFrameReceived(frameTxt, isFinalFrame);
+                        QWebSocketBufferPool::releaseString(frameTxt);
                     }
                 } else {
-                    m_binaryMessage.append(frame.payload());
                     QByteArray payload = frame.payload();
+                    appendToMessage(m_binaryMessage, payload);
                     frame.clear();
                     Q_EMIT binaryFrameReceived(payload, isFinalFrame);
+                    QWebSocketBufferPool::releaseBytes(payload);
                 }
 
                 if (isFinalFrame) {
                     isDone = true;
+                    // hand the message buffers back to the pool once the
+                    // receivers are done with them
                     if (m_opCode == QWebSocketProtocol::OpCodeText) {
-                        const QString textMessage(m_textMessage);
+                        QString textMessage = std::exchange(m_textMessage, QString());
                         clear();
                         Q_EMIT textMessageReceived(textMessage);
+                        QWebSocketBufferPool::releaseString(textMessage);
                     } else {
-                        const QByteArray binaryMessage(m_binaryMessage);
+                        QByteArray binaryMessage = std::exchange(m_binaryMessage, QByteArray());
                         clear();
                         Q_EMIT binaryMessageReceived(binaryMessage);
+                        QWebSocketBufferPool::releaseBytes(binaryMessage);
                     }
                 }
             }
@@ -235,13 +643,83 @@ void QWebSocketDataProcessor::clear()
     m_opCode = QWebSocketProtocol::OpCodeClose;
     m_hasMask = false;
     m_mask = 0;
-    m_binaryMessage.clear();
-    m_textMessage.clear();
+    QWebSocketBufferPool::releaseBytes(m_binaryMessage);
+    QWebSocketBufferPool::releaseString(m_textMessage);
+    QWebSocketBufferPool::releaseBytes(m_encodedMessage);
+    m_messageReservedBits = 0;
+    m_isDroppingMessage = false;
     m_payloadLength = 0;
+    m_passthroughLength = 0;
     m_decoder.resetState();
     frame.clear();
 }
 
+/*!
+    \internal
+
+    Decodes the complete encoded message and delivers it. Returns \c false if
+    an error has been emitted.
+ */
+bool QWebSocketDataProcessor::processEncodedMessage()
+{
+    const QWebSocketProtocol::OpCode opCode = m_opCode;
+    const quint8 reservedBits = m_messageReservedBits;
+    QByteArray message = std::exchange(m_encodedMessage, QByteArray());
+    quint8 decodedBits = 0;
+    for (auto it = m_extensions.crbegin(); it != m_extensions.crend(); ++it) {
+        const QWebSocketExtension *extension = *it;
+        if (!extension)
+            continue;
+        const quint8 extensionBits = quint8(extension->reservedBits().toInt());
+        if ((reservedBits & extensionBits) == 0)
+            continue;
+        QByteArray decoded;
+        if (Q_UNLIKELY(!extension->decode(message, qint64(maxAllowedMessageSize()),
+                                          &decoded))) {
+            clear();
+            Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeProtocolError,
+                                    tr("Message could not be decoded by extension %1.")
+                                    .arg(extension->name()));
+            return false;
+        }
+        QWebSocketBufferPool::releaseBytes(message);
+        message = std::move(decoded);
+        decodedBits |= extensionBits;
+    }
+    if (Q_UNLIKELY(decodedBits != reservedBits)) {
+        clear();
+        Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeProtocolError,
+                                tr("Rsv field is non-zero"));
+        return false;
+    }
+    if (Q_UNLIKELY(quint64(message.size()) > maxAllowedMessageSize())) {
+        clear();
+        Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeTooMuchData,
+                                tr("Received message is too big."));
+        return false;
+    }
+
+    clear();
+    if (m_isPassthrough) {
+        Q_EMIT dataFrameReceived(opCode, message, true);
+    } else if (opCode == QWebSocketProtocol::OpCodeText) {
+        const QString textMessage = m_decoder(message);
+        if (Q_UNLIKELY(m_decoder.hasError())) {
+            m_decoder.resetState();
+            Q_EMIT errorEncountered(QWebSocketProtocol::CloseCodeWrongDatatype,
+                                    tr("Invalid UTF-8 code encountered."));
+            return false;
+        }
+        Q_EMIT textFrameReceived(textMessage, true);
+        Q_EMIT textMessageReceived(textMessage);
+    } else {
+        Q_EMIT binaryFrameReceived(message, true);
+        Q_EMIT binaryMessageReceived(message);
+    }
+    QWebSocketBufferPool::releaseBytes(message);
+    return true;
+}
+
 /*!
     \internal
  */
@@ -315,6 +793,19 @@ bool QWebSocketDataProcessor::processControlFrame(const QWebSocketFrame &frame)
     return mustStopProcessing;
 }
 
+/*!
+    \internal
+ */
+void QWebSocketDataProcessor::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_waitTimer.timerId()) {
+        m_waitTimer.stop();
+        timeout();
+    } else {
+        QObject::timerEvent(event);
+    }
+}
+
 /*!
     \internal
  */
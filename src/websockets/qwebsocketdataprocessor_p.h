@@ -17,17 +17,24 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QByteArray>
+#include <QtCore/QList>
+#include <QtCore/QPointer>
 #include <QtCore/QString>
 #include <QtCore/QStringDecoder>
-#include <QtCore/QChronoTimer>
+#include <QtCore/QBasicTimer>
+#include <QtCore/QElapsedTimer>
+#include "qwebsocket.h"
 #include "qwebsocketframe_p.h"
 #include "qwebsocketprotocol.h"
 #include "qwebsocketprotocol_p.h"
+#include "qwebsockettokenbucket_p.h"
 
 QT_BEGIN_NAMESPACE
 
 class QIODevice;
 class QWebSocketFrame;
+class QWebSocketMemoryBudget;
+class QWebSocketExtension;
 
 const quint64 MAX_MESSAGE_SIZE_IN_BYTES = std::numeric_limits<int>::max() - 1;
 
@@ -50,6 +57,28 @@ public:
     void setIdleTimeout(std::chrono::milliseconds timeout);
     std::chrono::milliseconds idleTimeout() const;
 
+    QByteArray pendingData() const;
+    qint64 missingBytes(qint64 bytesAvailable) const;
+
+    void setPassthrough(bool passthrough);
+    bool isPassthrough() const;
+
+    void setMemoryBudget(const QWebSocketMemoryBudget *budget);
+    qint64 bufferedBytes() const;
+
+    void setExtensions(const QList<QPointer<QWebSocketExtension>> &extensions);
+
+    void setByteRateLimit(qint64 bytesPerSecond);
+    qint64 byteRateLimit() const;
+    void setMessageRateLimit(int messagesPerSecond);
+    int messageRateLimit() const;
+    void setControlFrameRateLimit(int framesPerSecond);
+    int controlFrameRateLimit() const;
+    void setRateLimitPolicy(QWebSocket::RateLimitPolicy policy);
+    QWebSocket::RateLimitPolicy rateLimitPolicy() const;
+    quint64 rateLimitHits() const;
+    qint64 readingDelay();
+
 Q_SIGNALS:
     void pingReceived(const QByteArray &data);
     void pongReceived(const QByteArray &data);
@@ -58,6 +87,8 @@ Q_SIGNALS:
     void binaryFrameReceived(const QByteArray &frame, bool lastFrame);
     void textMessageReceived(const QString &message);
     void binaryMessageReceived(const QByteArray &message);
+    void dataFrameReceived(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                           bool lastFrame);
     void errorEncountered(QWebSocketProtocol::CloseCode code, const QString &description);
 
 public Q_SLOTS:
@@ -86,11 +117,37 @@ private:
     quint64 m_payloadLength;
     QStringDecoder m_decoder;
     QWebSocketFrame frame;
-    QChronoTimer *m_waitTimer;
+    QBasicTimer m_waitTimer;
+    std::chrono::milliseconds m_idleTimeout;
     quint64 m_maxAllowedMessageSize = MAX_MESSAGE_SIZE_IN_BYTES;
-
+    // in passthrough mode, data frames are handed on as they arrive, and only
+    // the length of the message is kept
+    quint64 m_passthroughLength = 0;
+    bool m_isPassthrough = false;
+    const QWebSocketMemoryBudget *m_memoryBudget = nullptr;
+    // messages with reserved bits set are encoded by extensions; their
+    // payload is kept as received until the message is complete
+    QList<QPointer<QWebSocketExtension>> m_extensions;
+    QByteArray m_encodedMessage;
+    quint8 m_messageReservedBits = 0;
+    // incoming rate limits; a message that is dropped is dropped as a whole
+    QElapsedTimer m_rateLimitClock;
+    QWebSocketTokenBucket m_byteBucket;
+    QWebSocketTokenBucket m_messageBucket;
+    QWebSocketTokenBucket m_controlFrameBucket;
+    QWebSocket::RateLimitPolicy m_rateLimitPolicy = QWebSocket::DelayReading;
+    quint64 m_rateLimitHits = 0;
+    bool m_isDroppingMessage = false;
+
+    bool hasRateLimits() const;
+    void refillRateLimits();
+    bool chargeRateLimits(const QWebSocketFrame &frame);
     bool processControlFrame(const QWebSocketFrame &frame);
+    bool processEncodedMessage();
     void timeout();
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
 };
 
 QT_END_NAMESPACE
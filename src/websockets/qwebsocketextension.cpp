@@ -0,0 +1,159 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+/*!
+    \class QWebSocketExtension
+
+    \inmodule QtWebSockets
+    \since 6.9
+
+    \brief The QWebSocketExtension class provides an abstract base for
+    extensions that transform the payload of messages.
+
+    \l {WebSocket Extensions} are negotiated in the opening handshake: a
+    client offers them with QWebSocketHandshakeOptions::setExtensions(), and
+    QWebSocketServer accepts those that are also among its
+    \l{QWebSocketServer::}{supportedExtensions()}, matching them by name().
+    Parameters of the offered extensions are ignored.
+
+    Each extension claims one or more of the reserved bits of the frame
+    header. When a message is sent, the accepted extensions encode() it in
+    the order in which they were offered, and the bits of those that did are
+    set in the first frame. When a message with reserved bits set is
+    received, it is assembled as a whole and decode()d by the extensions that
+    claim these bits, in reverse order. Control frames are never encoded.
+
+    The extensions are not owned by the sockets using them, and the same
+    extension may be used by many connections, in different threads; encode()
+    and decode() therefore have to be reentrant, and each message must be
+    encoded on its own.
+
+    QtWebSockets comes with compressing extensions that can be created with
+    createCodec(), if it was built with the libraries they need. They are not
+    standardized, so both ends of the connection need to use QtWebSockets.
+
+    \sa QWebSocketServer::setSupportedExtensions()
+*/
+
+/*!
+    \enum QWebSocketExtension::ReservedBit
+
+    The reserved bits of the frame header an extension can claim.
+
+    \value Rsv1 The first reserved bit, also used by the \e permessage-deflate
+           extension.
+    \value Rsv2 The second reserved bit.
+    \value Rsv3 The third reserved bit.
+*/
+
+/*!
+    \enum QWebSocketExtension::Codec
+
+    The compressing extensions that come with QtWebSockets.
+
+    \value Lz4 Compresses messages with LZ4, which is very fast but compresses
+           less. It is negotiated as \c x-qt-lz4 and claims Rsv2.
+    \value Zstd Compresses messages with Zstandard, which compresses much
+           better at a moderate cost. It is negotiated as \c x-qt-zstd and
+           claims Rsv3.
+*/
+
+/*!
+    \fn QString QWebSocketExtension::name() const
+
+    Returns the name the extension is negotiated with in the
+    \c Sec-WebSocket-Extensions header.
+*/
+
+/*!
+    \fn QWebSocketExtension::ReservedBits QWebSocketExtension::reservedBits() const
+
+    Returns the reserved bits that mark the messages encoded by this
+    extension. The extensions used on a connection must claim different bits.
+*/
+
+/*!
+    \fn bool QWebSocketExtension::encode(const QByteArray &payload, QByteArray *encoded) const
+
+    Encodes the \a payload of a message into \a encoded and returns \c true.
+    Returns \c false if the message is to be sent as it is, for instance
+    because it would not get any smaller.
+*/
+
+/*!
+    \fn bool QWebSocketExtension::decode(const QByteArray &payload, qint64 maxSize, QByteArray *decoded) const
+
+    Decodes the \a payload of a message received with the reservedBits() set
+    into \a decoded and returns \c true. Returns \c false if the payload
+    cannot be decoded, or if it would decode to more than \a maxSize bytes;
+    the connection is then closed. Implementations should check the size
+    before allocating memory for it.
+*/
+
+#include "qwebsocketextension.h"
+#include "qwebsocketcompression_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    Creates a new QWebSocketExtension object with the given optional QObject \a parent.
+ */
+QWebSocketExtension::QWebSocketExtension(QObject *parent) :
+    QObject(parent)
+{
+}
+
+/*!
+    Destroys the QWebSocketExtension object.
+ */
+QWebSocketExtension::~QWebSocketExtension()
+{}
+
+/*!
+    Returns \c true if QtWebSockets has been built with support for \a codec.
+
+    \sa createCodec()
+ */
+bool QWebSocketExtension::isCodecAvailable(Codec codec)
+{
+    switch (codec) {
+    case Codec::Lz4:
+        return QT_CONFIG(websockets_lz4);
+    case Codec::Zstd:
+        return QT_CONFIG(websockets_zstd);
+    }
+    return false;
+}
+
+/*!
+    Creates an extension compressing messages with \a codec, with the given
+    \a parent. The meaning of \a level depends on the codec: for Lz4 it is the
+    acceleration, where higher values are faster and compress less; for Zstd
+    it is the compression level. -1 selects the default of the codec.
+
+    Returns \nullptr if \a codec is not available.
+
+    \sa isCodecAvailable()
+ */
+QWebSocketExtension *QWebSocketExtension::createCodec(Codec codec, int level, QObject *parent)
+{
+    switch (codec) {
+    case Codec::Lz4:
+#if QT_CONFIG(websockets_lz4)
+        return new QWebSocketLz4Extension(level, parent);
+#else
+        break;
+#endif
+    case Codec::Zstd:
+#if QT_CONFIG(websockets_zstd)
+        return new QWebSocketZstdExtension(level, parent);
+#else
+        break;
+#endif
+    }
+    Q_UNUSED(level);
+    Q_UNUSED(parent);
+    return nullptr;
+}
+
+QT_END_NAMESPACE
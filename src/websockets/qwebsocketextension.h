@@ -0,0 +1,51 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETEXTENSION_H
+#define QWEBSOCKETEXTENSION_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include "QtWebSockets/qwebsockets_global.h"
+
+QT_BEGIN_NAMESPACE
+
+class Q_WEBSOCKETS_EXPORT QWebSocketExtension : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(QWebSocketExtension)
+
+public:
+    enum ReservedBit {
+        Rsv1 = 0x40,
+        Rsv2 = 0x20,
+        Rsv3 = 0x10
+    };
+    Q_DECLARE_FLAGS(ReservedBits, ReservedBit)
+    Q_FLAG(ReservedBits)
+
+    enum class Codec {
+        Lz4,
+        Zstd
+    };
+    Q_ENUM(Codec)
+
+    explicit QWebSocketExtension(QObject *parent = nullptr);
+    ~QWebSocketExtension() override;
+
+    virtual QString name() const = 0;
+    virtual ReservedBits reservedBits() const = 0;
+    virtual bool encode(const QByteArray &payload, QByteArray *encoded) const = 0;
+    virtual bool decode(const QByteArray &payload, qint64 maxSize, QByteArray *decoded) const = 0;
+
+    static bool isCodecAvailable(Codec codec);
+    static QWebSocketExtension *createCodec(Codec codec, int level = -1,
+                                            QObject *parent = nullptr);
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(QWebSocketExtension::ReservedBits)
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETEXTENSION_H
@@ -19,11 +19,14 @@
 
 #include "qwebsocketframe_p.h"
 #include "qwebsocketprotocol_p.h"
+#include "qwebsocketbufferpool_p.h"
 
 #include <QtCore/QtEndian>
 #include <QtCore/QDebug>
 #include <QtCore/QIODevice>
 
+#include <cstring>
+
 QT_BEGIN_NAMESPACE
 
 /*!
@@ -115,6 +118,26 @@ quint32 QWebSocketFrame::mask() const
     return m_mask;
 }
 
+/*!
+    \internal
+    Returns the reserved bits of the frame, in their position in the first
+    byte of the header.
+ */
+quint8 QWebSocketFrame::reservedBits() const
+{
+    return (m_rsv1 ? 0x40 : 0x00) | (m_rsv2 ? 0x20 : 0x00) | (m_rsv3 ? 0x10 : 0x00);
+}
+
+/*!
+    \internal
+    Sets the \a reservedBits that data frames may have set, because an
+    extension claims them; any other reserved bit makes the frame invalid.
+ */
+void QWebSocketFrame::setAllowedReservedBits(quint8 reservedBits)
+{
+    m_allowedReservedBits = reservedBits & 0x70;
+}
+
 /*!
     \internal
  */
@@ -147,7 +170,7 @@ void QWebSocketFrame::clear()
     m_rsv3 = false;
     m_opCode = QWebSocketProtocol::OpCodeReservedC;
     m_length = 0;
-    m_payload.clear();
+    QWebSocketBufferPool::releaseBytes(m_payload);
     m_isValid = false;
     m_processingState = PS_READ_HEADER;
 }
@@ -219,54 +242,160 @@ void QWebSocketFrame::readFrame(QIODevice *pIoDevice)
 
 /*!
     \internal
+
+    Returns how many bytes have to be available to the reader, on top of
+    \a bytesAvailable, before the frame being read can get any further.
+    While the header is read, that is what the largest header may still be
+    missing.
+ */
+qint64 QWebSocketFrame::missingBytes(qint64 bytesAvailable) const
+{
+    if (m_processingState == PS_READ_PAYLOAD)
+        return qMax(qint64(m_length) - bytesAvailable, qint64(0));
+    return qMax(qint64(MaxHeaderSize) - bytesAvailable, qint64(1));
+}
+
+/*!
+    \internal
+
+    Returns the bytes of the header that have been consumed for the frame
+    being read, so that the frame can be continued by another reader. The
+    payload is only consumed once it is complete, so nothing of it is lost.
+ */
+QByteArray QWebSocketFrame::pendingHeader() const
+{
+    char header[MaxHeaderSize];
+    qsizetype size = 0;
+    switch (m_processingState) {
+    case PS_READ_PAYLOAD_LENGTH:
+        // only the first two bytes have been read; m_length is 126 or 127
+        header[0] = static_cast<char>((m_isFinalFrame ? 0x80 : 0x00) | (m_opCode & 0x0F));
+        header[1] = static_cast<char>((hasMask() ? 0x80 : 0x00) | quint8(m_length));
+        size = 2;
+        break;
+    case PS_READ_MASK:
+        // the length has been read, the masking key has not; lengths are
+        // always encoded in the minimal number of bytes, so they come out
+        // as they were received
+        size = encodeHeader(header, m_opCode, m_length, 1, m_isFinalFrame) - 4;
+        break;
+    case PS_READ_PAYLOAD:
+        size = encodeHeader(header, m_opCode, m_length, m_mask, m_isFinalFrame);
+        break;
+    default:
+        return QByteArray();
+    }
+    header[0] |= static_cast<char>(reservedBits());
+    return QByteArray(header, size);
+}
+
+/*!
+    \internal
+
+    The whole header is usually available at once, so it is peeked at and
+    decoded in a single pass. Otherwise only the first two bytes are consumed,
+    and the payload length and the mask are read once they have arrived.
  */
 QWebSocketFrame::ProcessingState QWebSocketFrame::readFrameHeader(QIODevice *pIoDevice)
 {
-    if (Q_LIKELY(pIoDevice->bytesAvailable() >= 2)) {
-        // FIN, RSV1-3, Opcode
-        char header[2] = {0};
-        if (Q_UNLIKELY(pIoDevice->read(header, 2) < 2)) {
-            setError(QWebSocketProtocol::CloseCodeGoingAway,
-                     tr("Error occurred while reading header from the network: %1")
-                        .arg(pIoDevice->errorString()));
-            return PS_DISPATCH_RESULT;
+    char header[MaxHeaderSize];
+    const qint64 available = pIoDevice->peek(header, MaxHeaderSize);
+    if (available < 2)
+        return PS_WAIT_FOR_MORE_DATA;
+
+    // FIN, RSV1-3, Opcode
+    m_isFinalFrame = (header[0] & 0x80) != 0;
+    m_rsv1 = (header[0] & 0x40);
+    m_rsv2 = (header[0] & 0x20);
+    m_rsv3 = (header[0] & 0x10);
+    m_opCode = static_cast<QWebSocketProtocol::OpCode>(header[0] & 0x0F);
+
+    // Mask
+    // Use zero as mask value to mean there's no mask to read.
+    // When the mask value is read, it over-writes this non-zero value.
+    m_mask = header[1] & 0x80;
+    // PayloadLength
+    m_length = (header[1] & 0x7F);
+
+    const qsizetype lengthSize = m_length == 126 ? 2 : (m_length == 127 ? 8 : 0);
+    const qsizetype maskSize = hasMask() ? 4 : 0;
+    const qsizetype headerSize = 2 + lengthSize + maskSize;
+    const bool isComplete = available >= headerSize;
+
+    ProcessingState nextState = PS_READ_PAYLOAD;
+    qsizetype consumed = 2;
+    if (!checkValidity()) {
+        nextState = PS_DISPATCH_RESULT;
+    } else if (!isComplete) {
+        if (lengthSize)
+            nextState = PS_READ_PAYLOAD_LENGTH;
+        else if (maskSize)
+            nextState = PS_READ_MASK;
+    } else {
+        if (lengthSize) {
+            nextState = decodePayloadLength(reinterpret_cast<const uchar *>(header + 2));
+            consumed += lengthSize;
         }
-        m_isFinalFrame = (header[0] & 0x80) != 0;
-        m_rsv1 = (header[0] & 0x40);
-        m_rsv2 = (header[0] & 0x20);
-        m_rsv3 = (header[0] & 0x10);
-        m_opCode = static_cast<QWebSocketProtocol::OpCode>(header[0] & 0x0F);
-
-        // Mask
-        // Use zero as mask value to mean there's no mask to read.
-        // When the mask value is read, it over-writes this non-zero value.
-        m_mask = header[1] & 0x80;
-        // PayloadLength
-        m_length = (header[1] & 0x7F);
-
-        if (!checkValidity())
-            return PS_DISPATCH_RESULT;
-
-        switch (m_length) {
-        case 126:
-        case 127:
-            return PS_READ_PAYLOAD_LENGTH;
-        default:
-            return hasMask() ? PS_READ_MASK : PS_READ_PAYLOAD;
+        if (nextState != PS_DISPATCH_RESULT) {
+            if (maskSize)
+                m_mask = qFromBigEndian<quint32>(header + consumed);
+            consumed = headerSize;
+            nextState = PS_READ_PAYLOAD;
         }
     }
-    return PS_WAIT_FOR_MORE_DATA;
+
+    if (Q_UNLIKELY(pIoDevice->skip(consumed) != consumed)) {
+        setError(QWebSocketProtocol::CloseCodeGoingAway,
+                 tr("Error occurred while reading header from the network: %1")
+                    .arg(pIoDevice->errorString()));
+        return PS_DISPATCH_RESULT;
+    }
+    return nextState;
 }
 
 /*!
     \internal
+
+    Decodes the extended payload length, which \a length holds in 2 or 8 bytes
+    depending on the 7-bit payload length already read.
  */
-QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayloadLength(QIODevice *pIoDevice)
+QWebSocketFrame::ProcessingState QWebSocketFrame::decodePayloadLength(const uchar *length)
 {
     // see https://tools.ietf.org/html/rfc6455#page-28 paragraph 5.2
     // in all cases, the minimal number of bytes MUST be used to encode the length,
     // for example, the length of a 124-byte-long string can't be encoded as the
     // sequence 126, 0, 124"
+    if (m_length == 126) {
+        m_length = qFromBigEndian<quint16>(length);
+        if (Q_UNLIKELY(m_length < 126)) {
+            setError(QWebSocketProtocol::CloseCodeProtocolError,
+                        tr("Lengths smaller than 126 must be expressed as one byte."));
+            return PS_DISPATCH_RESULT;
+        }
+    } else {
+        Q_ASSERT(m_length == 127);
+        // Most significant bit must be set to 0 as
+        // per https://tools.ietf.org/html/rfc6455#section-5.2
+        m_length = qFromBigEndian<quint64>(length);
+        if (Q_UNLIKELY(m_length & (quint64(1) << 63))) {
+            setError(QWebSocketProtocol::CloseCodeProtocolError,
+                        tr("Highest bit of payload length is not 0."));
+            return PS_DISPATCH_RESULT;
+        }
+        if (Q_UNLIKELY(m_length <= 0xFFFFu)) {
+            setError(QWebSocketProtocol::CloseCodeProtocolError,
+                        tr("Lengths smaller than 65536 (2^16) must be expressed as 2 bytes."));
+            return PS_DISPATCH_RESULT;
+        }
+    }
+    return hasMask() ? PS_READ_MASK : PS_READ_PAYLOAD;
+}
+
+/*!
+    \internal
+ */
+QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayloadLength(QIODevice *pIoDevice)
+{
     switch (m_length) {
     case 126:
         if (Q_LIKELY(pIoDevice->bytesAvailable() >= 2)) {
@@ -277,14 +406,7 @@ QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayloadLength(QIODevi
                             .arg(pIoDevice->errorString()));
                 return PS_DISPATCH_RESULT;
             }
-            m_length = qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(length));
-            if (Q_UNLIKELY(m_length < 126)) {
-
-                setError(QWebSocketProtocol::CloseCodeProtocolError,
-                            tr("Lengths smaller than 126 must be expressed as one byte."));
-                return PS_DISPATCH_RESULT;
-            }
-            return hasMask() ? PS_READ_MASK : PS_READ_PAYLOAD;
+            return decodePayloadLength(length);
         }
         break;
     case 127:
@@ -295,20 +417,7 @@ QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayloadLength(QIODevi
                          tr("Something went wrong during reading from the network."));
                 return PS_DISPATCH_RESULT;
             }
-            // Most significant bit must be set to 0 as
-            // per https://tools.ietf.org/html/rfc6455#section-5.2
-            m_length = qFromBigEndian<quint64>(length);
-            if (Q_UNLIKELY(m_length & (quint64(1) << 63))) {
-                setError(QWebSocketProtocol::CloseCodeProtocolError,
-                            tr("Highest bit of payload length is not 0."));
-                return PS_DISPATCH_RESULT;
-            }
-            if (Q_UNLIKELY(m_length <= 0xFFFFu)) {
-                setError(QWebSocketProtocol::CloseCodeProtocolError,
-                            tr("Lengths smaller than 65536 (2^16) must be expressed as 2 bytes."));
-                return PS_DISPATCH_RESULT;
-            }
-            return hasMask() ? PS_READ_MASK : PS_READ_PAYLOAD;
+            return decodePayloadLength(length);
         }
         break;
     default:
@@ -348,10 +457,10 @@ QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayload(QIODevice *pI
         return PS_DISPATCH_RESULT;
     }
     if (quint64(pIoDevice->bytesAvailable()) >= m_length) {
-        m_payload = pIoDevice->read(int(m_length));
         // m_length can be safely cast to an integer,
         // because MAX_FRAME_SIZE_IN_BYTES = MAX_INT
-        if (Q_UNLIKELY(m_payload.size() != int(m_length))) {
+        m_payload = QWebSocketBufferPool::acquireBytes(qsizetype(m_length));
+        if (Q_UNLIKELY(pIoDevice->read(m_payload.data(), qint64(m_length)) != qint64(m_length))) {
             // some error occurred; refer to the Qt documentation of QIODevice::read()
             setError(QWebSocketProtocol::CloseCodeAbnormalDisconnection,
                      tr("Some serious error occurred while reading from the network."));
@@ -363,6 +472,99 @@ QWebSocketFrame::ProcessingState QWebSocketFrame::readFramePayload(QIODevice *pI
     return PS_WAIT_FOR_MORE_DATA;
 }
 
+/*!
+    \internal
+
+    Encodes the header of a frame into \a header, which must have room for
+    MaxHeaderSize bytes, and returns the number of bytes used.
+    A \a maskingKey of 0 means that the payload is not masked. \a reservedBits
+    are set as they are given, in their position in the first byte.
+ */
+qsizetype QWebSocketFrame::encodeHeader(char *header, QWebSocketProtocol::OpCode opCode,
+                                        quint64 payloadLength, quint32 maskingKey,
+                                        bool lastFrame, quint8 reservedBits)
+{
+    Q_ASSERT(payloadLength <= 0x7FFFFFFFFFFFFFFFULL);
+
+    qsizetype size = 0;
+    //FIN, RSV1-3, opcode (RSV1-3 are only set by extensions)
+    header[size++] = static_cast<char>((opCode & 0x0F) | (lastFrame ? 0x80 : 0x00)
+                                       | (reservedBits & 0x70));
+
+    const quint8 maskBit = maskingKey != 0 ? 0x80 : 0x00;
+    if (payloadLength <= 125) {
+        header[size++] = static_cast<char>(maskBit | static_cast<quint8>(payloadLength));
+    } else if (payloadLength <= 0xFFFFU) {
+        header[size++] = static_cast<char>(maskBit | 126);
+        qToBigEndian<quint16>(static_cast<quint16>(payloadLength), header + size);
+        size += 2;
+    } else {
+        header[size++] = static_cast<char>(maskBit | 127);
+        qToBigEndian<quint64>(payloadLength, header + size);
+        size += 8;
+    }
+
+    if (maskingKey != 0) {
+        qToBigEndian<quint32>(maskingKey, header + size);
+        size += 4;
+    }
+    return size;
+}
+
+/*!
+    \internal
+
+    Writes a single frame carrying \a payload to \a pIoDevice, masking the
+    payload with \a maskingKey unless it is 0.
+    Returns the number of payload bytes written, or -1 on error.
+
+    Small frames and masked frames are assembled in one buffer and written
+    with a single call; the buffer comes from the stack or from the buffer
+    pool, so no memory is allocated in the steady state.
+    If \a contiguous is \c true, unmasked frames are assembled as well. This
+    is meant for encrypting devices, which would otherwise put the header into
+    a TLS record of its own. \a reservedBits are set in the header.
+ */
+qint64 QWebSocketFrame::writeFrame(QIODevice *pIoDevice, QWebSocketProtocol::OpCode opCode,
+                                   QByteArrayView payload, quint32 maskingKey, bool lastFrame,
+                                   bool contiguous, quint8 reservedBits)
+{
+    // large enough for any control frame
+    constexpr qsizetype StackFrameSize = MaxHeaderSize + 125;
+
+    char header[MaxHeaderSize];
+    const qsizetype headerSize = encodeHeader(header, opCode, quint64(payload.size()),
+                                              maskingKey, lastFrame, reservedBits);
+    const qsizetype frameSize = headerSize + payload.size();
+
+    const auto writeAssembled = [&](char *frame) -> qint64 {
+        memcpy(frame, header, size_t(headerSize));
+        if (!payload.isEmpty()) {
+            memcpy(frame + headerSize, payload.data(), size_t(payload.size()));
+            if (maskingKey != 0)
+                QWebSocketProtocol::mask(frame + headerSize, quint64(payload.size()), maskingKey);
+        }
+        const qint64 written = pIoDevice->write(frame, frameSize);
+        return written < 0 ? written : written - headerSize;
+    };
+
+    if (frameSize <= StackFrameSize) {
+        char frame[StackFrameSize];
+        return writeAssembled(frame);
+    }
+    if (maskingKey != 0 || contiguous) {
+        QByteArray frame = QWebSocketBufferPool::acquireBytes(frameSize);
+        const qint64 written = writeAssembled(frame.data());
+        QWebSocketBufferPool::releaseBytes(frame);
+        return written;
+    }
+
+    // unmasked payloads are written as they are, without an intermediate copy
+    if (Q_UNLIKELY(pIoDevice->write(header, headerSize) != headerSize))
+        return -1;
+    return pIoDevice->write(payload.data(), payload.size());
+}
+
 /*!
     \internal
  */
@@ -379,7 +581,9 @@ void QWebSocketFrame::setError(QWebSocketProtocol::CloseCode code, const QString
  */
 bool QWebSocketFrame::checkValidity()
 {
-    if (Q_UNLIKELY(m_rsv1 || m_rsv2 || m_rsv3)) {
+    const quint8 reservedBits = this->reservedBits();
+    if (Q_UNLIKELY(reservedBits != 0
+                   && (isControlFrame() || (reservedBits & ~m_allowedReservedBits) != 0))) {
         setError(QWebSocketProtocol::CloseCodeProtocolError, tr("Rsv field is non-zero"));
     } else if (Q_UNLIKELY(QWebSocketProtocol::isOpCodeReserved(m_opCode))) {
         setError(QWebSocketProtocol::CloseCodeProtocolError, tr("Used reserved opcode"));
@@ -37,6 +37,9 @@ class Q_AUTOTEST_EXPORT QWebSocketFrame
 public:
     QWebSocketFrame() = default;
 
+    // FIN/opcode, 64-bit payload length and masking key
+    static constexpr qsizetype MaxHeaderSize = 14;
+
     void setMaxAllowedFrameSize(quint64 maxAllowedFrameSize);
     quint64 maxAllowedFrameSize() const;
     static quint64 maxFrameSize();
@@ -52,6 +55,8 @@ public:
     inline bool rsv1() const { return m_rsv1; }
     inline bool rsv2() const { return m_rsv2; }
     inline bool rsv3() const { return m_rsv3; }
+    quint8 reservedBits() const;
+    void setAllowedReservedBits(quint8 reservedBits);
     QWebSocketProtocol::OpCode opCode() const;
     QByteArray payload() const;
 
@@ -61,6 +66,15 @@ public:
     bool isDone() const;
 
     void readFrame(QIODevice *pIoDevice);
+    QByteArray pendingHeader() const;
+    qint64 missingBytes(qint64 bytesAvailable) const;
+
+    static qsizetype encodeHeader(char *header, QWebSocketProtocol::OpCode opCode,
+                                  quint64 payloadLength, quint32 maskingKey, bool lastFrame,
+                                  quint8 reservedBits = 0);
+    static qint64 writeFrame(QIODevice *pIoDevice, QWebSocketProtocol::OpCode opCode,
+                             QByteArrayView payload, quint32 maskingKey, bool lastFrame,
+                             bool contiguous = false, quint8 reservedBits = 0);
 
 private:
     QString m_closeReason;
@@ -85,9 +99,12 @@ private:
     bool m_rsv2 = false;
     bool m_rsv3 = false;
     bool m_isValid = false;
+    // the bits claimed by the extensions in use, in header position
+    quint8 m_allowedReservedBits = 0;
     quint64 m_maxAllowedFrameSize = MAX_FRAME_SIZE_IN_BYTES;
 
     ProcessingState readFrameHeader(QIODevice *pIoDevice);
+    ProcessingState decodePayloadLength(const uchar *length);
     ProcessingState readFramePayloadLength(QIODevice *pIoDevice);
     ProcessingState readFrameMask(QIODevice *pIoDevice);
     ProcessingState readFramePayload(QIODevice *pIoDevice);
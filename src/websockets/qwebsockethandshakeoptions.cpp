@@ -16,7 +16,9 @@ QT_BEGIN_NAMESPACE
     WebSocket handshake, such as WebSocket subprotocols and WebSocket
     Extensions.
 
-    At the moment, only WebSocket subprotocols are supported.
+    Since Qt 6.9, WebSocket extensions can be offered with setExtensions(),
+    and messages can be sent along with the handshake with
+    setMessagePipeliningEnabled().
 
     \sa QWebSocket::open()
 */
@@ -91,6 +93,71 @@ void QWebSocketHandshakeOptions::setSubprotocols(const QStringList &protocols)
     d->subprotocols = protocols;
 }
 
+/*!
+    \since 6.9
+    \brief Returns the list of WebSocket extensions to offer in the websocket
+           handshake.
+*/
+QList<QWebSocketExtension *> QWebSocketHandshakeOptions::extensions() const
+{
+    return d->extensions;
+}
+
+/*!
+    \since 6.9
+    \brief Sets the list of WebSocket \a extensions to offer in the websocket
+           handshake.
+
+    The extensions are offered in the order of the list, and those the server
+    accepts are used in that order. They are not owned by this object or by
+    the socket, and must stay alive while the connection uses them.
+
+    \sa QWebSocketExtension
+*/
+void QWebSocketHandshakeOptions::setExtensions(const QList<QWebSocketExtension *> &extensions)
+{
+    d->extensions = extensions;
+}
+
+/*!
+    \since 6.9
+    \brief Returns \c true if messages sent while the socket is connecting
+           are written right after the handshake request.
+
+    \sa setMessagePipeliningEnabled()
+*/
+bool QWebSocketHandshakeOptions::isMessagePipeliningEnabled() const
+{
+    return d->isMessagePipeliningEnabled;
+}
+
+/*!
+    \since 6.9
+    \brief Enables sending messages before the handshake has completed if
+           \a enabled is \c true.
+
+    By default, QWebSocket only sends messages once the server has accepted
+    the handshake, and QWebSocket::sendTextMessage() and
+    QWebSocket::sendBinaryMessage() send nothing while the socket is in
+    QAbstractSocket::ConnectingState. With message pipelining enabled, the
+    messages sent in that state are queued, and written right after the
+    handshake request, so that they reach the server a round trip earlier.
+    This suits short request/response exchanges.
+
+    The pipelined messages are sent before any extension has been
+    negotiated, so they are never compressed. If the handshake fails, the
+    messages that have not been sent yet are discarded; the server may have
+    received the others, but does not process them. As the pipelined
+    messages go out with the first request only, the handshake cannot be
+    repeated: it fails if the server asks for authentication.
+
+    Message pipelining is disabled by default.
+*/
+void QWebSocketHandshakeOptions::setMessagePipeliningEnabled(bool enabled)
+{
+    d->isMessagePipeliningEnabled = enabled;
+}
+
 bool QWebSocketHandshakeOptions::equals(const QWebSocketHandshakeOptions &other) const
 {
     return *d == *other.d;
@@ -5,6 +5,7 @@
 #ifndef QWEBSOCKETHANDSHAKEOPTIONS_H
 #define QWEBSOCKETHANDSHAKEOPTIONS_H
 
+#include <QtCore/QList>
 #include <QtCore/QSharedDataPointer>
 #include <QtCore/QStringList>
 
@@ -13,6 +14,7 @@
 QT_BEGIN_NAMESPACE
 
 class QWebSocketHandshakeOptionsPrivate;
+class QWebSocketExtension;
 
 QT_DECLARE_QSDP_SPECIALIZATION_DTOR_WITH_EXPORT(QWebSocketHandshakeOptionsPrivate, Q_WEBSOCKETS_EXPORT)
 
@@ -32,6 +34,12 @@ public:
     QStringList subprotocols() const;
     void setSubprotocols(const QStringList &protocols);
 
+    QList<QWebSocketExtension *> extensions() const;
+    void setExtensions(const QList<QWebSocketExtension *> &extensions);
+
+    bool isMessagePipeliningEnabled() const;
+    void setMessagePipeliningEnabled(bool enabled);
+
 private:
     bool equals(const QWebSocketHandshakeOptions &other) const;
 
@@ -25,9 +25,14 @@ class Q_AUTOTEST_EXPORT QWebSocketHandshakeOptionsPrivate : public QSharedData
 {
 public:
     inline bool operator==(const QWebSocketHandshakeOptionsPrivate &other) const
-    { return subprotocols == other.subprotocols; }
+    {
+        return subprotocols == other.subprotocols && extensions == other.extensions
+                && isMessagePipeliningEnabled == other.isMessagePipeliningEnabled;
+    }
 
     QStringList subprotocols;
+    QList<QWebSocketExtension *> extensions;
+    bool isMessagePipeliningEnabled = false;
 };
 
 QT_END_NAMESPACE
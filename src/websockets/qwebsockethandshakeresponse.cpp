@@ -32,7 +32,8 @@ QWebSocketHandshakeResponse::QWebSocketHandshakeResponse(
         bool isOriginAllowed,
         const QList<QWebSocketProtocol::Version> &supportedVersions,
         const QList<QString> &supportedProtocols,
-        const QList<QString> &supportedExtensions) :
+        const QList<QString> &supportedExtensions,
+        const QHttpHeaders &extraHeaders) :
     m_isValid(false),
     m_canUpgrade(false),
     m_response(),
@@ -44,7 +45,7 @@ QWebSocketHandshakeResponse::QWebSocketHandshakeResponse(
 {
     m_response = getHandshakeResponse(request, serverName,
                                       isOriginAllowed, supportedVersions,
-                                      supportedProtocols, supportedExtensions);
+                                      supportedProtocols, supportedExtensions, extraHeaders);
     m_isValid = true;
 }
 
@@ -111,16 +112,26 @@ QString QWebSocketHandshakeResponse::getHandshakeResponse(
         bool isOriginAllowed,
         const QList<QWebSocketProtocol::Version> &supportedVersions,
         const QList<QString> &supportedProtocols,
-        const QList<QString> &supportedExtensions)
+        const QList<QString> &supportedExtensions,
+        const QHttpHeaders &extraHeaders)
 {
     QStringList response;
     m_canUpgrade = false;
+    // the names and values of QHttpHeaders are validated, so they cannot
+    // smuggle in a newline
+    const auto appendExtraHeaders = [&response, &extraHeaders]() {
+        for (qsizetype i = 0; i < extraHeaders.size(); ++i) {
+            response << QString(extraHeaders.nameAt(i)) % QStringLiteral(": ")
+                            % QString::fromLatin1(extraHeaders.valueAt(i));
+        }
+    };
 
     if (!isOriginAllowed) {
         if (!m_canUpgrade) {
             m_error = QWebSocketProtocol::CloseCodePolicyViolated;
             m_errorString = tr("Access forbidden.");
             response << QStringLiteral("HTTP/1.1 403 Access Forbidden");
+            appendExtraHeaders();
         }
     } else {
         if (request.isValid()) {
@@ -140,11 +151,15 @@ QString QWebSocketHandshakeResponse::getHandshakeResponse(
                 return it == clientProtocols.constEnd() ? QString() : *it;
             }();
 
-            //TODO: extensions must be kept in the order in which they arrive
-            //cannot use set.intersect() to get the supported extensions
-            const QList<QString> matchingExtensions =
-                listIntersection(supportedExtensions, request.extensions(),
-                                 std::less<QString>());
+            // Accept the supported extensions in the order the client offers
+            // them, as this is the order in which they are applied.
+            // Parameters are not supported, so they are ignored.
+            QStringList matchingExtensions;
+            for (const QString &extension : request.extensions()) {
+                const QString name = extension.section(u';', 0, 0).trimmed();
+                if (supportedExtensions.contains(name) && !matchingExtensions.contains(name))
+                    matchingExtensions.append(name);
+            }
             const QList<QWebSocketProtocol::Version> matchingVersions =
                 listIntersection(supportedVersions, request.versions(),
                                  std::greater<QWebSocketProtocol::Version>()); //sort in descending order
@@ -163,7 +178,7 @@ QString QWebSocketHandshakeResponse::getHandshakeResponse(
                     response << QStringLiteral("Sec-WebSocket-Protocol: ") % m_acceptedProtocol;
                 }
                 if (!matchingExtensions.isEmpty()) {
-                    m_acceptedExtension = matchingExtensions.first();
+                    m_acceptedExtension = matchingExtensions.join(QLatin1String(", "));
                     response << QStringLiteral("Sec-WebSocket-Extensions: ") % m_acceptedExtension;
                 }
                 QString origin = request.origin().trimmed();
@@ -185,6 +200,7 @@ QString QWebSocketHandshakeResponse::getHandshakeResponse(
                                 QStringLiteral("Access-Control-Allow-Origin: ") % origin     <<
                                 QStringLiteral("Date: ") % QLocale::c()
                                     .toString(datetime, QStringLiteral("ddd, dd MMM yyyy hh:mm:ss 'GMT'"));
+                    appendExtraHeaders();
 
 
                     m_acceptedVersion = QWebSocketProtocol::currentVersion();
@@ -16,6 +16,7 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QList>
+#include <QtNetwork/qhttpheaders.h>
 #include "qwebsocketprotocol.h"
 #include "private/qglobal_p.h"
 
@@ -36,7 +37,8 @@ public:
                       bool isOriginAllowed,
                       const QList<QWebSocketProtocol::Version> &supportedVersions,
                       const QList<QString> &supportedProtocols,
-                      const QList<QString> &supportedExtensions);
+                      const QList<QString> &supportedExtensions,
+                      const QHttpHeaders &extraHeaders = {});
 
     ~QWebSocketHandshakeResponse() override;
 
@@ -65,7 +67,8 @@ private:
                                  bool isOriginAllowed,
                                  const QList<QWebSocketProtocol::Version> &supportedVersions,
                                  const QList<QString> &supportedProtocols,
-                                 const QList<QString> &supportedExtensions);
+                                 const QList<QString> &supportedExtensions,
+                                 const QHttpHeaders &extraHeaders);
 
     QTextStream &writeToStream(QTextStream &textStream) const;
     Q_AUTOTEST_EXPORT friend QTextStream & operator <<(QTextStream &stream,
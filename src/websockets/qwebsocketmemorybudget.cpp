@@ -0,0 +1,267 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qwebsocketmemorybudget_p.h"
+#include "qwebsocket_p.h"
+#include "qwebsocketbufferpool_p.h"
+
+#include <QtCore/QList>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+
+#include <algorithm>
+#include <utility>
+
+QT_BEGIN_NAMESPACE
+
+// how long the PauseReading policy waits for the usage to go back within the
+// limit, before it closes the connections holding the most memory
+constexpr int PAUSE_READING_GRACE_PERIOD_MS = 3000;
+
+/*!
+    \internal
+    \class QWebSocketMemoryBudget
+
+    Sets the number of bytes the connections may hold to \a limit; 0 means
+    that there is no limit.
+ */
+void QWebSocketMemoryBudget::setLimit(qint64 limit)
+{
+    m_limit.store(qMax(limit, qint64(0)), std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+ */
+void QWebSocketMemoryBudget::setPolicy(QWebSocketServer::MemoryBudgetPolicy policy)
+{
+    m_policy.store(int(policy), std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+    Returns the part of the limit that falls to one connection.
+ */
+qint64 QWebSocketMemoryBudget::share() const
+{
+    const qsizetype count = m_connectionCount.load(std::memory_order_relaxed);
+    return limit() / qMax(count, qsizetype(1));
+}
+
+/*!
+    \internal
+    Returns \c true if an incoming message of \a size bytes has to be rejected.
+ */
+bool QWebSocketMemoryBudget::rejectsMessage(qint64 size) const
+{
+    return policy() == QWebSocketServer::RejectLargeMessages && isExceeded() && size > share();
+}
+
+/*!
+    \internal
+    Sets the \a server that is told when the limit has been exceeded.
+ */
+void QWebSocketMemoryBudget::setServer(QWebSocketServer *server)
+{
+    QMutexLocker locker(&m_mutex);
+    m_server = server;
+}
+
+/*!
+    \internal
+ */
+void QWebSocketMemoryBudget::addConnection(QWebSocketPrivate *connection)
+{
+    QMutexLocker locker(&m_mutex);
+    m_connections.insert(connection);
+    m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+    Forgets \a connection, along with the \a usage it reported last.
+    After this, no calls are queued to the connection anymore.
+ */
+void QWebSocketMemoryBudget::removeConnection(QWebSocketPrivate *connection, qint64 usage)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_connections.remove(connection);
+        m_pausedConnections.remove(connection);
+        m_closingConnections.remove(connection);
+        m_connectionCount.store(m_connections.size(), std::memory_order_relaxed);
+    }
+    update(connection, 0, -usage);
+}
+
+/*!
+    \internal
+    Records that the usage of \a connection changed by \a delta to \a usage,
+    and applies the policy if the limit has been crossed.
+ */
+void QWebSocketMemoryBudget::update(QWebSocketPrivate *connection, qint64 usage, qint64 delta)
+{
+    const qint64 total = m_usage.fetch_add(delta, std::memory_order_relaxed) + delta;
+    const qint64 limit = this->limit();
+    if (limit <= 0 || delta == 0)
+        return;
+    const qint64 previousTotal = total - delta;
+    if (previousTotal <= limit && total > limit) {
+        QMutexLocker locker(&m_mutex);
+        ++m_exceededGeneration;
+        if (m_server) {
+            QMetaObject::invokeMethod(m_server, [server = m_server, total]() {
+                Q_EMIT server->memoryBudgetExceeded(total);
+            }, Qt::QueuedConnection);
+            if (policy() == QWebSocketServer::PauseReading)
+                startPauseReadingGracePeriod(m_exceededGeneration);
+        }
+        if (policy() == QWebSocketServer::CloseLargestConsumers)
+            closeLargestConnections(total - limit);
+    } else if (previousTotal > limit && total <= limit) {
+        QMutexLocker locker(&m_mutex);
+        ++m_exceededGeneration;
+        for (QWebSocketPrivate *paused : std::as_const(m_pausedConnections)) {
+            QMetaObject::invokeMethod(paused->q_func(), [paused]() {
+                paused->resumeReadingForMemoryBudget();
+            }, Qt::QueuedConnection);
+        }
+        m_pausedConnections.clear();
+    } else if (total > limit && delta > 0 && usage > share()
+               && policy() == QWebSocketServer::CloseLargestConsumers) {
+        // still over the limit, and this connection keeps growing
+        QMutexLocker locker(&m_mutex);
+        if (m_connections.contains(connection))
+            closeConnection(connection);
+    }
+}
+
+/*!
+    \internal
+    Returns \c true if \a connection has to stop reading, in which case it is
+    resumed once the usage is back within the limit.
+ */
+bool QWebSocketMemoryBudget::pauseReading(QWebSocketPrivate *connection)
+{
+    QMutexLocker locker(&m_mutex);
+    if (policy() != QWebSocketServer::PauseReading || !isExceeded()
+            || !m_connections.contains(connection)) {
+        return false;
+    }
+    m_pausedConnections.insert(connection);
+    return true;
+}
+
+/*!
+    \internal
+    Trims the buffers of all connections, and returns the number of bytes
+    freed by the connections living in the current thread. The connections
+    of other threads are trimmed in their own thread, along with the buffer
+    pool of that thread, and only count towards trimmedBytes().
+ */
+qint64 QWebSocketMemoryBudget::trimConnections()
+{
+    QList<QWebSocketPrivate *> localConnections;
+    {
+        QMutexLocker locker(&m_mutex);
+        QThread *currentThread = QThread::currentThread();
+        for (QWebSocketPrivate *connection : std::as_const(m_connections)) {
+            if (connection->q_func()->thread() == currentThread) {
+                localConnections.append(connection);
+            } else {
+                QMetaObject::invokeMethod(connection->q_func(), [connection]() {
+                    connection->trimMemory();
+                    QWebSocketBufferPool::trim();
+                }, Qt::QueuedConnection);
+            }
+        }
+    }
+    // trimming does not change the usage, so the connections do not call back
+    qint64 freed = 0;
+    for (QWebSocketPrivate *connection : std::as_const(localConnections))
+        freed += connection->trimMemory();
+    return freed;
+}
+
+/*!
+    \internal
+    Records that a connection has freed \a bytes by trimming its buffers.
+ */
+void QWebSocketMemoryBudget::addTrimmedBytes(qint64 bytes)
+{
+    m_trimmedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/*!
+    \internal
+    Closes the connections holding the most memory, until they account for
+    at least \a excess bytes. Must be called with the mutex locked.
+ */
+void QWebSocketMemoryBudget::closeLargestConnections(qint64 excess)
+{
+    QList<std::pair<qint64, QWebSocketPrivate *>> candidates;
+    candidates.reserve(m_connections.size());
+    for (QWebSocketPrivate *connection : std::as_const(m_connections)) {
+        if (!m_closingConnections.contains(connection))
+            candidates.emplaceBack(connection->m_memoryUsage.load(std::memory_order_relaxed),
+                                   connection);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+    qint64 freed = 0;
+    for (const auto &[usage, connection] : std::as_const(candidates)) {
+        if (freed >= excess || usage == 0)
+            break;
+        closeConnection(connection);
+        freed += usage;
+    }
+}
+
+/*!
+    \internal
+    Makes endPauseReadingGracePeriod() run in the thread of the server once
+    the grace period is over. Must be called with the mutex locked.
+ */
+void QWebSocketMemoryBudget::startPauseReadingGracePeriod(quint64 generation)
+{
+    // the server owns the budget, so the budget lives as long as the timer
+    QMetaObject::invokeMethod(m_server, [this, server = m_server, generation]() {
+        QTimer::singleShot(PAUSE_READING_GRACE_PERIOD_MS, server, [this, generation]() {
+            endPauseReadingGracePeriod(generation);
+        });
+    }, Qt::QueuedConnection);
+}
+
+/*!
+    \internal
+    Closes the connections holding the most memory if the usage has exceeded
+    the limit throughout the grace period: it may be made up of messages that
+    the paused connections cannot complete, and waiting longer would not help.
+ */
+void QWebSocketMemoryBudget::endPauseReadingGracePeriod(quint64 generation)
+{
+    QMutexLocker locker(&m_mutex);
+    if (generation != m_exceededGeneration || !m_server
+            || policy() != QWebSocketServer::PauseReading || !isExceeded()) {
+        return;
+    }
+    closeLargestConnections(usage() - limit());
+    // in case closing these does not suffice
+    startPauseReadingGracePeriod(generation);
+}
+
+/*!
+    \internal
+    Must be called with the mutex locked.
+ */
+void QWebSocketMemoryBudget::closeConnection(QWebSocketPrivate *connection)
+{
+    if (m_closingConnections.contains(connection))
+        return;
+    m_closingConnections.insert(connection);
+    QMetaObject::invokeMethod(connection->q_func(), [connection]() {
+        connection->closeForMemoryBudget();
+    }, Qt::QueuedConnection);
+}
+
+QT_END_NAMESPACE
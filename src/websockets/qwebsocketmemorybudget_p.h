@@ -0,0 +1,89 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETMEMORYBUDGET_P_H
+#define QWEBSOCKETMEMORYBUDGET_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
+#include <QtCore/qglobal.h>
+
+#include "qwebsocketserver.h"
+
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+
+class QWebSocketPrivate;
+
+// Accounts for the memory held by the connections of a QWebSocketServer:
+// messages being assembled, data received but not parsed yet, and data
+// waiting to be written. Each connection reports changes of its own usage
+// with update(), from whatever thread it lives in; the policy is applied when
+// the total crosses the limit.
+class QWebSocketMemoryBudget
+{
+    Q_DISABLE_COPY_MOVE(QWebSocketMemoryBudget)
+
+public:
+    QWebSocketMemoryBudget() = default;
+
+    void setLimit(qint64 limit);
+    qint64 limit() const { return m_limit.load(std::memory_order_relaxed); }
+    void setPolicy(QWebSocketServer::MemoryBudgetPolicy policy);
+    QWebSocketServer::MemoryBudgetPolicy policy() const
+    {
+        return QWebSocketServer::MemoryBudgetPolicy(m_policy.load(std::memory_order_relaxed));
+    }
+    qint64 usage() const { return m_usage.load(std::memory_order_relaxed); }
+    bool isExceeded() const
+    {
+        const qint64 limit = this->limit();
+        return limit > 0 && usage() > limit;
+    }
+    qint64 share() const;
+    bool rejectsMessage(qint64 size) const;
+
+    void setServer(QWebSocketServer *server);
+    void addConnection(QWebSocketPrivate *connection);
+    void removeConnection(QWebSocketPrivate *connection, qint64 usage);
+    void update(QWebSocketPrivate *connection, qint64 usage, qint64 delta);
+    bool pauseReading(QWebSocketPrivate *connection);
+    qint64 trimConnections();
+    void addTrimmedBytes(qint64 bytes);
+    qint64 trimmedBytes() const { return m_trimmedBytes.load(std::memory_order_relaxed); }
+
+private:
+    void closeLargestConnections(qint64 excess);
+    void closeConnection(QWebSocketPrivate *connection);
+    void startPauseReadingGracePeriod(quint64 generation);
+    void endPauseReadingGracePeriod(quint64 generation);
+
+    mutable QMutex m_mutex;
+    QSet<QWebSocketPrivate *> m_connections;
+    QSet<QWebSocketPrivate *> m_pausedConnections;
+    QSet<QWebSocketPrivate *> m_closingConnections;
+    QWebSocketServer *m_server = nullptr;
+    // changes whenever the usage crosses the limit, so that a grace period
+    // only ends if the limit has been exceeded throughout
+    quint64 m_exceededGeneration = 0;
+    std::atomic<qint64> m_usage = 0;
+    std::atomic<qint64> m_limit = 0;
+    std::atomic<int> m_policy = QWebSocketServer::RejectLargeMessages;
+    std::atomic<qsizetype> m_connectionCount = 0;
+    std::atomic<qint64> m_trimmedBytes = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETMEMORYBUDGET_P_H
@@ -0,0 +1,118 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETMESSAGEQUEUE_P_H
+#define QWEBSOCKETMESSAGEQUEUE_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QByteArray>
+#include <QtCore/qglobal.h>
+
+#include <atomic>
+#include <optional>
+
+QT_BEGIN_NAMESPACE
+
+// Lock-free queue of messages posted to a QWebSocket from any number of
+// threads and consumed by the thread the socket lives in.
+// This is the intrusive MPSC queue by Dmitry Vyukov: producers only swap the
+// head and link the previous node, so push() never blocks or allocates more
+// than the node itself.
+class QWebSocketMessageQueue
+{
+    Q_DISABLE_COPY_MOVE(QWebSocketMessageQueue)
+
+public:
+    struct Message
+    {
+        QByteArray payload;
+        bool isBinary = false;
+    };
+
+    QWebSocketMessageQueue() = default;
+    ~QWebSocketMessageQueue()
+    {
+        while (pop())
+            ;
+    }
+
+    // Can be called from any thread. Returns true if the consumer has to be
+    // woken up, which is the case for the first message pushed after the
+    // consumer called acknowledgeWakeup().
+    bool push(Message &&message)
+    {
+        Node *node = new Node;
+        node->message = std::move(message);
+        pushNode(node);
+        // an RMW, so that the consumer's exchange in acknowledgeWakeup()
+        // synchronizes with every producer that saw the flag set
+        return !m_wakeupPending.exchange(true, std::memory_order_acq_rel);
+    }
+
+    // Must be called by the consumer before it starts popping; messages
+    // pushed after this call cause a new wakeup.
+    void acknowledgeWakeup()
+    {
+        m_wakeupPending.exchange(false, std::memory_order_acq_rel);
+    }
+
+    // Consumer only. Returns std::nullopt when the queue is empty, or when a
+    // producer is halfway through a push; that producer then asks for a new
+    // wakeup, as the flag has been reset before.
+    std::optional<Message> pop()
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (tail == &m_stub) {
+            if (!next)
+                return std::nullopt;
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if (!next) {
+            if (tail != m_head.load(std::memory_order_acquire))
+                return std::nullopt;
+            pushNode(&m_stub);
+            next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return std::nullopt;
+        }
+        m_tail = next;
+        std::optional<Message> message(std::move(tail->message));
+        delete tail;
+        return message;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next = nullptr;
+        Message message;
+    };
+
+    void pushNode(Node *node)
+    {
+        node->next.store(nullptr, std::memory_order_relaxed);
+        Node *previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    Node m_stub;
+    std::atomic<Node *> m_head = &m_stub;
+    Node *m_tail = &m_stub;
+    std::atomic<bool> m_wakeupPending = false;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETMESSAGEQUEUE_P_H
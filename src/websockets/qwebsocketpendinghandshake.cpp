@@ -0,0 +1,203 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+/*!
+    \class QWebSocketPendingHandshake
+
+    \inmodule QtWebSockets
+    \since 6.9
+
+    \brief The QWebSocketPendingHandshake class represents an opening
+    handshake that waits for the application to accept or reject it.
+
+    When handshakes are deferred with
+    \l{QWebSocketServer::}{setHandshakeDeferred()}, QWebSocketServer emits
+    \l{QWebSocketServer::}{handshakeRequested()} with a
+    QWebSocketPendingHandshake for every valid handshake request, instead of
+    answering it right away. The application can then look at the request,
+    e.g. check a token in its headers against a service, without blocking the
+    event loop of the server, and answer it later with accept() or reject().
+    Any number of handshakes can be pending at the same time.
+
+    The handshake timeout of the server keeps running while a handshake is
+    pending. If it expires, or the peer goes away, before the handshake is
+    answered, aborted() is emitted.
+
+    QWebSocketPendingHandshake objects are owned by the server, and are
+    deleted once they have been answered or aborted; use a QPointer to keep
+    them. accept() and reject() must be called in the thread of the server.
+
+    \sa QWebSocketServer::handshakeRequested()
+*/
+
+/*!
+    \fn void QWebSocketPendingHandshake::aborted()
+
+    This signal is emitted when the connection is closed before the handshake
+    has been answered, because the peer went away or the handshake timeout of
+    the server expired.
+*/
+
+#include "qwebsocketpendinghandshake.h"
+#include "qwebsocketpendinghandshake_p.h"
+#include "qwebsocketserver_p.h"
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \internal
+ */
+void QWebSocketPendingHandshakePrivate::finish(bool accepted, const QHttpHeaders &responseHeaders)
+{
+    Q_Q(QWebSocketPendingHandshake);
+    if (Q_UNLIKELY(!m_isPending)) {
+        qWarning("QWebSocketPendingHandshake: the handshake has already been answered");
+        return;
+    }
+    m_isPending = false;
+    for (const QMetaObject::Connection &connection : m_socketConnections)
+        QObject::disconnect(connection);
+    if (m_pTcpSocket) {
+        if (Q_LIKELY(m_pServer)) {
+            static_cast<QWebSocketServerPrivate *>(QObjectPrivate::get(m_pServer.data()))
+                    ->completeDeferredHandshake(m_pTcpSocket, *m_request, accepted,
+                                                responseHeaders);
+        } else {
+            m_pTcpSocket->close();
+        }
+    }
+    q->deleteLater();
+}
+
+/*!
+    \internal
+ */
+void QWebSocketPendingHandshakePrivate::abort()
+{
+    Q_Q(QWebSocketPendingHandshake);
+    if (!m_isPending)
+        return;
+    m_isPending = false;
+    for (const QMetaObject::Connection &connection : m_socketConnections)
+        QObject::disconnect(connection);
+    Q_EMIT q->aborted();
+    q->deleteLater();
+}
+
+/*!
+    \internal
+ */
+QWebSocketPendingHandshake::QWebSocketPendingHandshake(QTcpSocket *pTcpSocket,
+                                                       QWebSocketServer *server) :
+    QObject(*(new QWebSocketPendingHandshakePrivate), server)
+{
+    Q_D(QWebSocketPendingHandshake);
+    d->m_pTcpSocket = pTcpSocket;
+    d->m_pServer = server;
+    d->m_peerAddress = pTcpSocket->peerAddress();
+    d->m_peerPort = pTcpSocket->peerPort();
+    const auto abort = [d]() { d->abort(); };
+    d->m_socketConnections[0] = connect(pTcpSocket, &QAbstractSocket::disconnected, this, abort);
+    d->m_socketConnections[1] = connect(pTcpSocket, &QObject::destroyed, this, abort);
+}
+
+/*!
+    Destroys the QWebSocketPendingHandshake. If it is still pending, the
+    connection is closed.
+ */
+QWebSocketPendingHandshake::~QWebSocketPendingHandshake()
+{
+    Q_D(QWebSocketPendingHandshake);
+    if (d->m_isPending && d->m_pTcpSocket)
+        d->m_pTcpSocket->close();
+}
+
+/*!
+    Returns the URL requested by the client.
+ */
+QUrl QWebSocketPendingHandshake::requestUrl() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_request->requestUrl();
+}
+
+/*!
+    Returns the origin sent by the client, if any.
+ */
+QString QWebSocketPendingHandshake::origin() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_request->origin();
+}
+
+/*!
+    Returns the subprotocols requested by the client.
+ */
+QStringList QWebSocketPendingHandshake::requestedSubprotocols() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_request->protocols();
+}
+
+/*!
+    Returns all headers of the handshake request.
+ */
+QHttpHeaders QWebSocketPendingHandshake::headers() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_request->headers();
+}
+
+/*!
+    Returns the address of the client.
+ */
+QHostAddress QWebSocketPendingHandshake::peerAddress() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_peerAddress;
+}
+
+/*!
+    Returns the port of the client.
+ */
+quint16 QWebSocketPendingHandshake::peerPort() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_peerPort;
+}
+
+/*!
+    Returns \c true until the handshake has been answered or aborted.
+ */
+bool QWebSocketPendingHandshake::isPending() const
+{
+    Q_D(const QWebSocketPendingHandshake);
+    return d->m_isPending;
+}
+
+/*!
+    Accepts the handshake, adding \a responseHeaders to the response. The
+    subprotocol and extensions are negotiated as usual, and the new
+    connection becomes available with
+    \l{QWebSocketServer::}{nextPendingConnection()}.
+
+    The connection is still refused if the server cannot take more pending
+    connections, or is being drained.
+ */
+void QWebSocketPendingHandshake::accept(const QHttpHeaders &responseHeaders)
+{
+    Q_D(QWebSocketPendingHandshake);
+    d->finish(true, responseHeaders);
+}
+
+/*!
+    Rejects the handshake with \c{403 Forbidden}, adding \a responseHeaders to
+    the response, and closes the connection.
+ */
+void QWebSocketPendingHandshake::reject(const QHttpHeaders &responseHeaders)
+{
+    Q_D(QWebSocketPendingHandshake);
+    d->finish(false, responseHeaders);
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,53 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETPENDINGHANDSHAKE_H
+#define QWEBSOCKETPENDINGHANDSHAKE_H
+
+#include <QtCore/QObject>
+#include <QtCore/QString>
+#include <QtCore/QStringList>
+#include <QtCore/QUrl>
+#include <QtNetwork/QHostAddress>
+#include <QtNetwork/qhttpheaders.h>
+#include "QtWebSockets/qwebsockets_global.h"
+
+QT_BEGIN_NAMESPACE
+
+class QTcpSocket;
+class QWebSocketServer;
+class QWebSocketPendingHandshakePrivate;
+
+class Q_WEBSOCKETS_EXPORT QWebSocketPendingHandshake : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(QWebSocketPendingHandshake)
+    Q_DECLARE_PRIVATE(QWebSocketPendingHandshake)
+
+public:
+    ~QWebSocketPendingHandshake() override;
+
+    QUrl requestUrl() const;
+    QString origin() const;
+    QStringList requestedSubprotocols() const;
+    QHttpHeaders headers() const;
+    QHostAddress peerAddress() const;
+    quint16 peerPort() const;
+
+    bool isPending() const;
+
+    void accept(const QHttpHeaders &responseHeaders = {});
+    void reject(const QHttpHeaders &responseHeaders = {});
+
+Q_SIGNALS:
+    void aborted();
+
+private:
+    explicit QWebSocketPendingHandshake(QTcpSocket *pTcpSocket, QWebSocketServer *server);
+
+    friend class QWebSocketServerPrivate;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETPENDINGHANDSHAKE_H
@@ -0,0 +1,50 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETPENDINGHANDSHAKE_P_H
+#define QWEBSOCKETPENDINGHANDSHAKE_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QPointer>
+#include <QtNetwork/QTcpSocket>
+#include <private/qobject_p.h>
+
+#include "qwebsocketpendinghandshake.h"
+#include "qwebsocketserver.h"
+#include "qwebsockethandshakerequest_p.h"
+
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+
+class QWebSocketPendingHandshakePrivate : public QObjectPrivate
+{
+    Q_DECLARE_PUBLIC(QWebSocketPendingHandshake)
+
+public:
+    QWebSocketPendingHandshakePrivate() = default;
+
+    void finish(bool accepted, const QHttpHeaders &responseHeaders);
+    void abort();
+
+    QPointer<QTcpSocket> m_pTcpSocket;
+    QPointer<QWebSocketServer> m_pServer;
+    std::unique_ptr<QWebSocketHandshakeRequest> m_request;
+    QHostAddress m_peerAddress;
+    quint16 m_peerPort = 0;
+    bool m_isPending = true;
+    QMetaObject::Connection m_socketConnections[2];
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETPENDINGHANDSHAKE_P_H
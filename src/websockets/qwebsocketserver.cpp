@@ -29,7 +29,8 @@
 
     Calling close() makes QWebSocketServer stop listening for incoming connections.
 
-    QWebSocketServer currently does not support \l {WebSocket Extensions}.
+    Per-message \l {WebSocket Extensions} can be supported with
+    setSupportedExtensions(); see QWebSocketExtension.
 
     \note When working with self-signed certificates, \l{Firefox bug 594502} prevents \l{Firefox} to
     connect to a secure WebSocket server. To work around this problem, first browse to the
@@ -41,6 +42,9 @@
 
     There is a default connection handshake timeout of 10 seconds to avoid denial of service,
     which can be customized using setHandshakeTimeout().
+    The number of new connections per second, and the number of connections from
+    the same peer address, can be limited with setHandshakeRateLimit(),
+    setHandshakeRateLimitPerAddress() and setMaxConnectionsPerAddress().
 
     \sa {WebSocket Server Example}, QWebSocket
 */
@@ -111,6 +115,25 @@
     \sa close()
 */
 
+/*!
+    \fn void QWebSocketServer::drainProgress(int remainingConnections)
+    \since 6.9
+    This signal is emitted while the server is draining, whenever the number
+    of connections that are still open changes. \a remainingConnections is
+    that number.
+
+    \sa drain(), drained()
+*/
+
+/*!
+    \fn void QWebSocketServer::drained()
+    \since 6.9
+    This signal is emitted when all connections have been closed after a call
+    to drain().
+
+    \sa drain(), drainProgress()
+*/
+
 /*!
     \fn void QWebSocketServer::originAuthenticationRequired(QWebSocketCorsAuthenticator *authenticator)
     This signal is emitted when a new connection is requested.
@@ -121,7 +144,20 @@
     If no slot is connected to this signal, all origins will be accepted by default.
 
     \note It is not possible to use a QueuedConnection to connect to
-    this signal, as the connection will always succeed.
+    this signal, as the connection will always succeed. To decide
+    asynchronously, defer the handshakes with setHandshakeDeferred().
+*/
+
+/*!
+    \fn void QWebSocketServer::handshakeRequested(QWebSocketPendingHandshake *handshake)
+    \since 6.9
+
+    This signal is emitted for every valid handshake request while handshakes
+    are deferred. The request waits in \a handshake until the application
+    accepts or rejects it; the server keeps serving other connections in the
+    meantime.
+
+    \sa setHandshakeDeferred()
 */
 
 /*!
@@ -229,10 +265,45 @@
   \value NonSecureMode The server operates in non-secure mode (over ws)
   */
 
+/*!
+  \enum QWebSocketServer::MemoryBudgetPolicy
+  \since 6.9
+  Indicates what the server does while its connections hold more memory than
+  the memoryBudget() allows.
+
+  \value RejectLargeMessages Incoming messages that would make a connection
+         hold more than its share of the budget are rejected, and the
+         connection is closed with QWebSocketProtocol::CloseCodeTooMuchData.
+  \value PauseReading Connections stop reading until the usage is back within
+         the budget. Messages being received are not completed in the
+         meantime. If the usage is still over the budget after three seconds,
+         for instance because it is made up of messages that the paused
+         connections cannot complete, the connections holding the most memory
+         are closed as with CloseLargestConsumers.
+  \value CloseLargestConsumers The connections holding the most memory are
+         closed with QWebSocketProtocol::CloseCodeTooMuchData, and what they
+         have not sent yet is dropped.
+
+  \sa setMemoryBudgetPolicy()
+  */
+
+/*!
+    \fn void QWebSocketServer::memoryBudgetExceeded(qint64 bufferedBytes)
+    \since 6.9
+    This signal is emitted when the memory held by the connections of the
+    server exceeds memoryBudget(); \a bufferedBytes is the usage at that time.
+    It is emitted again only after the usage has been back within the budget.
+
+    \sa bufferedBytes(), memoryBudgetPolicy()
+*/
+
 #include "qwebsocketprotocol.h"
 #include "qwebsocket.h"
 #include "qwebsocketserver.h"
 #include "qwebsocketserver_p.h"
+#include "qwebsocket_p.h"
+#include "qwebsocketmemorybudget_p.h"
+#include "qwebsocketbufferpool_p.h"
 
 #include <QtNetwork/QTcpServer>
 #include <QtNetwork/QTcpSocket>
@@ -283,6 +354,8 @@ QWebSocketServer::~QWebSocketServer()
 {
     Q_D(QWebSocketServer);
     d->close(true);
+    // the connections may outlive the server, and with them the budget
+    d->m_memoryBudget->setServer(nullptr);
 }
 
 /*!
@@ -294,6 +367,49 @@ void QWebSocketServer::close()
     d->close();
 }
 
+/*!
+    \since 6.9
+
+    Shuts the server down gracefully. The server stops listening and refuses
+    all handshakes in progress, then closes the connections it has accepted,
+    whether they are still pending or not, with \a closeCode and \a reason.
+
+    At most \a closeRate connections are closed per second, in random order,
+    so that the cost of closing them and of the clients reconnecting elsewhere
+    is spread over time. If \a closeRate is 0 or less, all connections are
+    closed at once. Once all close frames have been sent, the connections get
+    \a gracePeriod to complete the closing handshake, after which the
+    remaining ones are aborted.
+
+    The drainProgress() signal reports the number of connections that are
+    still open, and drained() is emitted when none is left. Calling close()
+    stops draining.
+
+    \sa isDraining(), close()
+ */
+#if __has_include(<chrono>)
+void QWebSocketServer::drain(std::chrono::milliseconds gracePeriod, int closeRate,
+                             QWebSocketProtocol::CloseCode closeCode, const QString &reason)
+{
+    Q_D(QWebSocketServer);
+    d->drain(gracePeriod, closeRate, closeCode, reason);
+}
+#endif
+
+/*!
+    \since 6.9
+
+    Returns \c true if drain() has been called and not all connections have
+    been closed yet.
+
+    \sa drain()
+ */
+bool QWebSocketServer::isDraining() const
+{
+    Q_D(const QWebSocketServer);
+    return d->isDraining();
+}
+
 /*!
     Returns a human readable description of the last error that occurred.
     If no error occurred, an empty string is returned.
@@ -381,6 +497,313 @@ int QWebSocketServer::handshakeTimeoutMS() const
     return d->handshakeTimeout();
 }
 
+/*!
+    \since 6.9
+
+    Sets whether handshakes are \a deferred to the application.
+
+    When handshakes are deferred, the server emits handshakeRequested() with
+    a QWebSocketPendingHandshake for every valid handshake request, and only
+    answers the request when the application calls
+    \l{QWebSocketPendingHandshake::}{accept()} or
+    \l{QWebSocketPendingHandshake::}{reject()}, e.g. once a token has been
+    checked. originAuthenticationRequired() is not emitted then.
+
+    The handshake timeout keeps running while a handshake is pending.
+    By default, handshakes are not deferred.
+
+    \sa isHandshakeDeferred(), setHandshakeTimeout()
+ */
+void QWebSocketServer::setHandshakeDeferred(bool deferred)
+{
+    Q_D(QWebSocketServer);
+    d->setHandshakeDeferred(deferred);
+}
+
+/*!
+    \since 6.9
+
+    Returns \c true if handshakes are deferred to the application.
+
+    \sa setHandshakeDeferred()
+ */
+bool QWebSocketServer::isHandshakeDeferred() const
+{
+    Q_D(const QWebSocketServer);
+    return d->isHandshakeDeferred();
+}
+
+/*!
+    \since 6.9
+
+    Limits the number of connections the server takes on to
+    \a handshakesPerSecond, with bursts of up to as many connections. A value
+    of 0, the default, means no limit.
+
+    The limits of the admission control are applied to new connections before
+    anything is read from them. Connections beyond a limit are answered with
+    \c{503 Service Unavailable} and a \c{Retry-After} header right away, and
+    closed; they do not count as pending connections, and do not cause an
+    error of the server.
+
+    \sa setMaxConnectionsPerAddress(), setHandshakeRateLimitPerAddress()
+ */
+void QWebSocketServer::setHandshakeRateLimit(int handshakesPerSecond)
+{
+    Q_D(QWebSocketServer);
+    d->admissionControl().setHandshakeRate(handshakesPerSecond);
+}
+
+/*!
+    \since 6.9
+
+    Returns the maximum number of connections the server takes on per second,
+    or 0 if there is no limit.
+
+    \sa setHandshakeRateLimit()
+ */
+int QWebSocketServer::handshakeRateLimit() const
+{
+    Q_D(const QWebSocketServer);
+    return d->admissionControl().handshakeRate();
+}
+
+/*!
+    \since 6.9
+
+    Limits the number of connections from the same peer address to
+    \a maxConnections, counting both connections that are still in their
+    handshake and upgraded connections, until they are destroyed. A value of
+    0, the default, means no limit.
+
+    IPv4 addresses mapped to IPv6 count as their IPv4 address.
+
+    \sa setHandshakeRateLimit()
+ */
+void QWebSocketServer::setMaxConnectionsPerAddress(int maxConnections)
+{
+    Q_D(QWebSocketServer);
+    d->admissionControl().setMaxConnectionsPerAddress(maxConnections);
+}
+
+/*!
+    \since 6.9
+
+    Returns the maximum number of connections from the same peer address, or
+    0 if there is no limit.
+
+    \sa setMaxConnectionsPerAddress()
+ */
+int QWebSocketServer::maxConnectionsPerAddress() const
+{
+    Q_D(const QWebSocketServer);
+    return d->admissionControl().maxConnectionsPerAddress();
+}
+
+/*!
+    \since 6.9
+
+    Limits the number of connections the server takes on from the same peer
+    address to \a handshakesPerSecond, with bursts of up to as many
+    connections. A value of 0, the default, means no limit.
+
+    \sa setHandshakeRateLimit()
+ */
+void QWebSocketServer::setHandshakeRateLimitPerAddress(int handshakesPerSecond)
+{
+    Q_D(QWebSocketServer);
+    d->admissionControl().setHandshakeRatePerAddress(handshakesPerSecond);
+}
+
+/*!
+    \since 6.9
+
+    Returns the maximum number of connections the server takes on per second
+    from the same peer address, or 0 if there is no limit.
+
+    \sa setHandshakeRateLimitPerAddress()
+ */
+int QWebSocketServer::handshakeRateLimitPerAddress() const
+{
+    Q_D(const QWebSocketServer);
+    return d->admissionControl().handshakeRatePerAddress();
+}
+
+/*!
+    \since 6.9
+
+    Sets the number of bytes the connections of this server may hold
+    together to \a bytes. This covers the messages being received, the data
+    received but not processed yet, and the data waiting to be sent. While
+    the budget is exceeded, the memoryBudgetPolicy() applies.
+
+    The default is 0, which means that there is no limit. The limits of a
+    single connection, like QWebSocket::maxAllowedIncomingMessageSize(), apply
+    regardless.
+
+    \sa memoryBudget(), bufferedBytes(), memoryBudgetExceeded()
+ */
+void QWebSocketServer::setMemoryBudget(qint64 bytes)
+{
+    Q_D(QWebSocketServer);
+    d->memoryBudget()->setLimit(bytes);
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of bytes the connections of this server may hold
+    together, or 0 if there is no limit.
+
+    \sa setMemoryBudget()
+ */
+qint64 QWebSocketServer::memoryBudget() const
+{
+    Q_D(const QWebSocketServer);
+    return d->memoryBudget()->limit();
+}
+
+/*!
+    \since 6.9
+
+    Sets what happens while the memoryBudget() is exceeded to \a policy.
+    The default is RejectLargeMessages.
+
+    \sa memoryBudgetPolicy()
+ */
+void QWebSocketServer::setMemoryBudgetPolicy(MemoryBudgetPolicy policy)
+{
+    Q_D(QWebSocketServer);
+    d->memoryBudget()->setPolicy(policy);
+}
+
+/*!
+    \since 6.9
+
+    Returns what happens while the memoryBudget() is exceeded.
+
+    \sa setMemoryBudgetPolicy()
+ */
+QWebSocketServer::MemoryBudgetPolicy QWebSocketServer::memoryBudgetPolicy() const
+{
+    Q_D(const QWebSocketServer);
+    return d->memoryBudget()->policy();
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of bytes the connections of this server hold at the
+    moment, whether or not a memoryBudget() is set. Connections that are
+    still open count after the server has been closed.
+
+    \sa setMemoryBudget()
+ */
+qint64 QWebSocketServer::bufferedBytes() const
+{
+    Q_D(const QWebSocketServer);
+    return d->memoryBudget()->usage();
+}
+
+#if __has_include(<chrono>)
+/*!
+    \since 6.9
+
+    Makes the connections accepted from now on trim their buffers once there
+    has been no traffic on them for \a interval. A value of 0, the default,
+    disables idle trimming.
+
+    \sa QWebSocket::setIdleTrimInterval(), trimMemory(), trimmedBytes()
+ */
+void QWebSocketServer::setIdleTrimInterval(std::chrono::milliseconds interval)
+{
+    Q_D(QWebSocketServer);
+    d->m_idleTrimInterval = qMax(interval, std::chrono::milliseconds::zero());
+}
+
+/*!
+    \since 6.9
+
+    Returns the time without traffic after which new connections trim their
+    buffers, or 0 if they do not.
+
+    \sa setIdleTrimInterval()
+ */
+std::chrono::milliseconds QWebSocketServer::idleTrimInterval() const
+{
+    Q_D(const QWebSocketServer);
+    return d->m_idleTrimInterval;
+}
+#endif
+
+/*!
+    \since 6.9
+
+    Trims the buffers of all connections of this server, as
+    QWebSocket::trimMemory() does, and frees the buffers kept for reuse by
+    the current thread. Returns the number of bytes freed in the current
+    thread; connections living in other threads are trimmed asynchronously
+    in their thread, and only count towards trimmedBytes().
+
+    \sa setIdleTrimInterval()
+ */
+qint64 QWebSocketServer::trimMemory()
+{
+    Q_D(QWebSocketServer);
+    return d->memoryBudget()->trimConnections() + QWebSocketBufferPool::trim();
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of bytes the connections of this server have freed
+    by trimming their buffers, whether on demand or when idle.
+
+    \sa trimMemory(), setIdleTrimInterval()
+ */
+qint64 QWebSocketServer::trimmedBytes() const
+{
+    Q_D(const QWebSocketServer);
+    return d->memoryBudget()->trimmedBytes();
+}
+
+/*!
+    \since 6.9
+
+    Makes the server keep the sockets of up to \a size closed connections,
+    and reuse them for new connections, instead of destroying a socket when
+    its connection is closed and creating one for each new connection. This
+    saves allocations when many short-lived connections come and go. A value
+    of 0, the default, disables the pool.
+
+    A socket is only reused once the connection that used it has
+    disconnected. A QWebSocket whose socket has been reused stays in
+    QAbstractSocket::UnconnectedState, and can still be deleted as usual.
+
+    \note Sockets are only pooled by servers in NonSecureMode.
+
+    \sa socketPoolSize()
+ */
+void QWebSocketServer::setSocketPoolSize(int size)
+{
+    Q_D(QWebSocketServer);
+    d->setSocketPoolSize(size);
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of sockets of closed connections the server keeps for
+    reuse at most, or 0 if it does not reuse them.
+
+    \sa setSocketPoolSize()
+ */
+int QWebSocketServer::socketPoolSize() const
+{
+    Q_D(const QWebSocketServer);
+    return d->socketPoolSize();
+}
+
 /*!
     Returns the next pending connection as a connected QWebSocket object.
     QWebSocketServer does not take ownership of the returned QWebSocket object.
@@ -518,6 +941,74 @@ QStringList QWebSocketServer::supportedSubprotocols() const
     return d->supportedSubprotocols();
 }
 
+/*!
+    \brief Sets the list of WebSocket extensions supported by the server to
+    \a extensions.
+    \since 6.9
+
+    The server accepts the extensions a client offers that are in this list,
+    in the order in which the client offers them. An extension that claims a
+    reserved bit already claimed by an earlier one in the list is ignored,
+    with a warning.
+
+    The extensions are not owned by the server; they are shared by all its
+    connections, and must stay alive while they are in use.
+
+    \sa QWebSocketExtension, QWebSocketHandshakeOptions::setExtensions()
+ */
+void QWebSocketServer::setSupportedExtensions(const QList<QWebSocketExtension *> &extensions)
+{
+    Q_D(QWebSocketServer);
+    d->setSupportedExtensions(extensions);
+}
+
+/*!
+    \brief Returns the list of WebSocket extensions supported by the server.
+    \since 6.9
+ */
+QList<QWebSocketExtension *> QWebSocketServer::supportedExtensions() const
+{
+    Q_D(const QWebSocketServer);
+    return d->supportedExtensions();
+}
+
+/*!
+    \since 6.9
+
+    Sends \a message as a text message to all \a recipients that are
+    connected, and returns their number.
+
+    Unlike calling QWebSocket::sendTextMessage() for each recipient, the
+    message is converted to UTF-8 once, and encoded once by the extensions
+    negotiated with the recipients; recipients that negotiated the same
+    extensions share the encoded message. The cost of a broadcast is thus
+    mostly independent of the number of recipients, apart from the copies
+    into the socket buffers.
+
+    The recipients must live in the thread of the caller.
+
+    \sa broadcastBinaryMessage(), setSupportedExtensions()
+ */
+qsizetype QWebSocketServer::broadcastTextMessage(const QString &message,
+                                                 const QList<QWebSocket *> &recipients)
+{
+    return QWebSocketPrivate::broadcastMessage(message.toUtf8(), false, recipients);
+}
+
+/*!
+    \since 6.9
+
+    Sends \a data as a binary message to all \a recipients that are
+    connected, and returns their number.
+
+    \sa broadcastTextMessage()
+ */
+qsizetype QWebSocketServer::broadcastBinaryMessage(const QByteArray &data,
+                                                   const QList<QWebSocket *> &recipients)
+{
+    return QWebSocketPrivate::broadcastMessage(data, true, recipients);
+}
+
 /*!
     Returns the server's address if the server is listening for connections; otherwise returns
     QHostAddress::Null.
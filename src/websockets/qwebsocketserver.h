@@ -26,6 +26,8 @@ class QTcpSocket;
 class QWebSocketServerPrivate;
 class QWebSocket;
 class QWebSocketCorsAuthenticator;
+class QWebSocketExtension;
+class QWebSocketPendingHandshake;
 
 class Q_WEBSOCKETS_EXPORT QWebSocketServer : public QObject
 {
@@ -42,12 +44,25 @@ public:
     };
     Q_ENUM(SslMode)
 
+    enum MemoryBudgetPolicy {
+        RejectLargeMessages,
+        PauseReading,
+        CloseLargestConsumers
+    };
+    Q_ENUM(MemoryBudgetPolicy)
+
     explicit QWebSocketServer(const QString &serverName, SslMode secureMode,
                               QObject *parent = nullptr);
     ~QWebSocketServer() override;
 
     bool listen(const QHostAddress &address = QHostAddress::Any, quint16 port = 0);
     void close();
+#if __has_include(<chrono>) || defined(Q_QDOC)
+    void drain(std::chrono::milliseconds gracePeriod, int closeRate,
+               QWebSocketProtocol::CloseCode closeCode = QWebSocketProtocol::CloseCodeGoingAway,
+               const QString &reason = QString());
+#endif
+    bool isDraining() const;
 
     bool isListening() const;
 
@@ -67,6 +82,32 @@ public:
     void setHandshakeTimeout(int msec);
     int handshakeTimeoutMS() const;
 
+    void setHandshakeDeferred(bool deferred);
+    bool isHandshakeDeferred() const;
+
+    void setHandshakeRateLimit(int handshakesPerSecond);
+    int handshakeRateLimit() const;
+    void setMaxConnectionsPerAddress(int maxConnections);
+    int maxConnectionsPerAddress() const;
+    void setHandshakeRateLimitPerAddress(int handshakesPerSecond);
+    int handshakeRateLimitPerAddress() const;
+
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+    void setMemoryBudgetPolicy(MemoryBudgetPolicy policy);
+    MemoryBudgetPolicy memoryBudgetPolicy() const;
+    qint64 bufferedBytes() const;
+
+#if __has_include(<chrono>) || defined(Q_QDOC)
+    void setIdleTrimInterval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds idleTrimInterval() const;
+#endif
+    qint64 trimMemory();
+    qint64 trimmedBytes() const;
+
+    void setSocketPoolSize(int size);
+    int socketPoolSize() const;
+
     quint16 serverPort() const;
     QHostAddress serverAddress() const;
     QUrl serverUrl() const;
@@ -97,6 +138,13 @@ public:
     void setSupportedSubprotocols(const QStringList &protocols);
     QStringList supportedSubprotocols() const;
 
+    void setSupportedExtensions(const QList<QWebSocketExtension *> &extensions);
+    QList<QWebSocketExtension *> supportedExtensions() const;
+
+    qsizetype broadcastTextMessage(const QString &message, const QList<QWebSocket *> &recipients);
+    qsizetype broadcastBinaryMessage(const QByteArray &data,
+                                     const QList<QWebSocket *> &recipients);
+
 #ifndef QT_NO_NETWORKPROXY
     void setProxy(const QNetworkProxy &networkProxy);
     QNetworkProxy proxy() const;
@@ -113,9 +161,8 @@ public:
 Q_SIGNALS:
     void acceptError(QAbstractSocket::SocketError socketError);
     void serverError(QWebSocketProtocol::CloseCode closeCode);
-    //TODO: should use a delegate iso of a synchronous signal
-    //see also QTBUG-16251
     void originAuthenticationRequired(QWebSocketCorsAuthenticator *pAuthenticator);
+    void handshakeRequested(QWebSocketPendingHandshake *handshake);
     void newConnection();
 #ifndef QT_NO_SSL
     void peerVerifyError(const QSslError &error);
@@ -126,6 +173,9 @@ Q_SIGNALS:
     void handshakeInterruptedOnError(const QSslError &error);
 #endif
     void closed();
+    void drainProgress(int remainingConnections);
+    void drained();
+    void memoryBudgetExceeded(qint64 bufferedBytes);
 };
 
 QT_END_NAMESPACE
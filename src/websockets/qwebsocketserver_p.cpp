@@ -8,12 +8,20 @@
 #include "qwebsockethandshakeresponse_p.h"
 #include "qwebsocket.h"
 #include "qwebsocket_p.h"
+#include "qwebsocketmemorybudget_p.h"
 #include "qwebsocketcorsauthenticator.h"
+#include "qwebsocketextension.h"
+#include "qwebsocketpendinghandshake.h"
+#include "qwebsocketpendinghandshake_p.h"
+#include "qwebsockettcpserver_p.h"
+#include <algorithm>
 #include <limits>
 
 #ifndef QT_NO_SSL
 #include "QtNetwork/QSslServer"
 #endif
+#include <QtCore/QDebug>
+#include <QtCore/QRandomGenerator>
 #include <QtCore/QTimer>
 #include <QtNetwork/QTcpServer>
 #include <QtNetwork/QTcpSocket>
@@ -34,7 +42,8 @@ QWebSocketServerPrivate::QWebSocketServerPrivate(const QString &serverName,
     m_error(QWebSocketProtocol::CloseCodeNormal),
     m_errorString(),
     m_maxPendingConnections(30),
-    m_handshakeTimeout(10000)
+    m_handshakeTimeout(10000),
+    m_memoryBudget(std::make_shared<QWebSocketMemoryBudget>())
 {}
 
 /*!
@@ -44,12 +53,14 @@ void QWebSocketServerPrivate::init()
 {
     Q_Q(QWebSocketServer);
 
+    m_memoryBudget->setServer(q);
+
 #ifdef Q_OS_WASM
     qWarning("QWebSocketServer: WebSocket servers are not supported by Qt for WebAssembly");
 #endif
 
     if (m_secureMode == NonSecureMode) {
-        m_pTcpServer = new QTcpServer(q);
+        m_pTcpServer = new QWebSocketTcpServer(q);
         if (Q_LIKELY(m_pTcpServer))
             QObjectPrivate::connect(m_pTcpServer, &QTcpServer::pendingConnectionAvailable, this,
                                     &QWebSocketServerPrivate::onNewConnection);
@@ -119,6 +130,7 @@ QWebSocketServerPrivate::~QWebSocketServerPrivate()
 void QWebSocketServerPrivate::close(bool aboutToDestroy)
 {
     Q_Q(QWebSocketServer);
+    stopDraining();
     m_pTcpServer->close();
     while (!m_pendingConnections.isEmpty()) {
         QWebSocket *pWebSocket = m_pendingConnections.dequeue();
@@ -133,6 +145,151 @@ void QWebSocketServerPrivate::close(bool aboutToDestroy)
     }
 }
 
+/*!
+    \internal
+ */
+void QWebSocketServerPrivate::drain(std::chrono::milliseconds gracePeriod, int closeRate,
+                                    QWebSocketProtocol::CloseCode closeCode,
+                                    const QString &reason)
+{
+    Q_Q(QWebSocketServer);
+    if (m_isDraining)
+        return;
+    m_isDraining = true;
+    m_pTcpServer->close();
+
+    // connections are only watched for disconnection from now on, so that
+    // accepting one stays cheap
+    const auto forget = [this](QObject *pWebSocket) {
+        m_liveConnections.remove(static_cast<QWebSocket *>(pWebSocket));
+    };
+    m_drainQueue.clear();
+    m_drainQueue.reserve(m_connections.size());
+    for (const QPointer<QWebSocket> &pWebSocket : std::as_const(m_connections)) {
+        QWebSocket *pLiveWebSocket = pWebSocket.data();
+        if (!pLiveWebSocket || m_liveConnections.contains(pLiveWebSocket))
+            continue;
+        // the state of a connection moved to another thread cannot be read
+        // from here; it is queued anyway, and only closed if it is still
+        // connected once it gets there
+        if (pLiveWebSocket->thread() == q->thread()
+            && pLiveWebSocket->state() == QAbstractSocket::UnconnectedState) {
+            continue;
+        }
+        m_liveConnections.insert(pLiveWebSocket);
+        QObject::connect(pLiveWebSocket, &QWebSocket::disconnected, q,
+                         [forget, pLiveWebSocket]() { forget(pLiveWebSocket); });
+        QObject::connect(pLiveWebSocket, &QObject::destroyed, q, forget);
+        m_drainQueue.append(pWebSocket);
+    }
+    m_connections.clear();
+    m_connectionsCompactionSize = 0;
+    // clients that reconnect right away come back in random order, instead
+    // of in the order they connected in the first place
+    std::shuffle(m_drainQueue.begin(), m_drainQueue.end(), *QRandomGenerator::global());
+
+    m_drainGracePeriod = gracePeriod;
+    m_drainCloseRate = closeRate;
+    m_drainCloseCode = closeCode;
+    m_drainCloseReason = reason;
+    m_drainClosedCount = 0;
+    m_drainReportedCount = -1;
+    m_drainDeadline = QDeadlineTimer(gracePeriod);
+    m_drainClock.start();
+    if (!m_drainTimer) {
+        m_drainTimer = new QTimer(q);
+        m_drainTimer->setSingleShot(true);
+        QObjectPrivate::connect(m_drainTimer, &QTimer::timeout,
+                                this, &QWebSocketServerPrivate::drainStep);
+    }
+    m_drainTimer->start(0);
+}
+
+/*!
+    \internal
+    Closes as many connections as the close rate allows since the drain
+    started, then waits for the closing handshakes until the grace period
+    is over.
+ */
+void QWebSocketServerPrivate::drainStep()
+{
+    Q_Q(QWebSocketServer);
+    if (!m_drainQueue.isEmpty()) {
+        qint64 count = m_drainQueue.size();
+        if (m_drainCloseRate > 0) {
+            // the budget grows with the elapsed time, so a late timer does
+            // not lower the rate; the first connection is closed right away
+            const qint64 due = m_drainClock.elapsed() * m_drainCloseRate / 1000 + 1;
+            count = qMin(count, due - m_drainClosedCount);
+        }
+        for (; count > 0; --count) {
+            const QPointer<QWebSocket> pWebSocket = m_drainQueue.takeLast();
+            ++m_drainClosedCount;
+            if (!pWebSocket)
+                continue;
+            // the connection may have been moved to another thread
+            QMetaObject::invokeMethod(pWebSocket.data(),
+                                      [pWebSocket = pWebSocket.data(),
+                                       closeCode = m_drainCloseCode,
+                                       reason = m_drainCloseReason]() {
+                if (pWebSocket->state() == QAbstractSocket::ConnectedState)
+                    pWebSocket->close(closeCode, reason);
+            }, Qt::QueuedConnection);
+        }
+        if (m_drainQueue.isEmpty())
+            m_drainDeadline = QDeadlineTimer(m_drainGracePeriod);
+    } else if (m_liveConnections.isEmpty() || m_drainDeadline.hasExpired()) {
+        // whoever did not complete the closing handshake in time is cut off
+        QList<QPointer<QWebSocket>> remaining;
+        remaining.reserve(m_liveConnections.size());
+        for (QWebSocket *pWebSocket : std::as_const(m_liveConnections))
+            remaining.append(pWebSocket);
+        m_liveConnections.clear();
+        m_isDraining = false;
+        for (const QPointer<QWebSocket> &pWebSocket : std::as_const(remaining)) {
+            if (pWebSocket) {
+                QMetaObject::invokeMethod(pWebSocket.data(), &QWebSocket::abort,
+                                          Qt::QueuedConnection);
+            }
+        }
+        if (m_drainReportedCount != 0)
+            Q_EMIT q->drainProgress(0);
+        Q_EMIT q->drained();
+        return;
+    }
+
+    if (m_drainReportedCount != m_liveConnections.size()) {
+        m_drainReportedCount = m_liveConnections.size();
+        Q_EMIT q->drainProgress(int(m_drainReportedCount));
+    }
+    // jitter the interval, so that the close frames do not go out in step
+    // with other timers of the application
+    m_drainTimer->start(5 + QRandomGenerator::global()->bounded(11));
+}
+
+/*!
+    \internal
+ */
+void QWebSocketServerPrivate::stopDraining()
+{
+    if (m_drainTimer)
+        m_drainTimer->stop();
+    m_drainQueue.clear();
+    // the connections that are left can be drained again later
+    for (QWebSocket *pWebSocket : std::as_const(m_liveConnections))
+        m_connections.append(pWebSocket);
+    m_liveConnections.clear();
+    m_isDraining = false;
+}
+
+/*!
+    \internal
+ */
+bool QWebSocketServerPrivate::isDraining() const
+{
+    return m_isDraining;
+}
+
 /*!
     \internal
  */
@@ -188,6 +345,26 @@ void QWebSocketServerPrivate::addPendingConnection(QWebSocket *pWebSocket)
         m_pendingConnections.enqueue(pWebSocket);
 }
 
+/*!
+    \internal
+    Keeps track of \a pWebSocket for as long as it exists, so that drain()
+    can close it.
+ */
+void QWebSocketServerPrivate::trackConnection(QWebSocket *pWebSocket)
+{
+    static_cast<QWebSocketPrivate *>(QObjectPrivate::get(pWebSocket))
+            ->setMemoryBudget(m_memoryBudget);
+    if (m_idleTrimInterval > std::chrono::milliseconds::zero())
+        pWebSocket->setIdleTrimInterval(m_idleTrimInterval);
+    if (m_connections.size() >= m_connectionsCompactionSize) {
+        m_connections.removeIf([](const QPointer<QWebSocket> &pConnection) {
+            return pConnection.isNull();
+        });
+        m_connectionsCompactionSize = qMax(qsizetype(64), m_connections.size() * 2);
+    }
+    m_connections.append(pWebSocket);
+}
+
 /*!
     \internal
  */
@@ -339,10 +516,74 @@ QStringList QWebSocketServerPrivate::supportedSubprotocols() const
 /*!
     \internal
  */
-QStringList QWebSocketServerPrivate::supportedExtensions() const
+void QWebSocketServerPrivate::setSupportedExtensions(const QList<QWebSocketExtension *> &extensions)
+{
+    m_supportedExtensions.clear();
+    quint8 reservedBits = 0;
+    for (QWebSocketExtension *extension : extensions) {
+        if (Q_UNLIKELY(!extension))
+            continue;
+        const quint8 extensionBits = quint8(extension->reservedBits().toInt());
+        if (Q_UNLIKELY(reservedBits & extensionBits)) {
+            qWarning() << "Ignoring WebSocket extension" << extension->name()
+                       << "whose reserved bits are already used by another extension";
+            continue;
+        }
+        reservedBits |= extensionBits;
+        m_supportedExtensions.append(extension);
+    }
+}
+
+/*!
+    \internal
+ */
+QList<QWebSocketExtension *> QWebSocketServerPrivate::supportedExtensions() const
+{
+    QList<QWebSocketExtension *> extensions;
+    extensions.reserve(m_supportedExtensions.size());
+    for (const QPointer<QWebSocketExtension> &extension : m_supportedExtensions) {
+        if (extension)
+            extensions.append(extension);
+    }
+    return extensions;
+}
+
+/*!
+    \internal
+ */
+QStringList QWebSocketServerPrivate::supportedExtensionNames() const
 {
-    QStringList supportedExtensions;
-    return supportedExtensions;	//no extensions are currently supported
+    QStringList names;
+    for (const QPointer<QWebSocketExtension> &extension : m_supportedExtensions) {
+        if (extension)
+            names.append(extension->name());
+    }
+    return names;
+}
+
+/*!
+    \internal
+    Hands the extensions named in \a acceptedExtensions, the value of the
+    Sec-WebSocket-Extensions header of the response, to \a pWebSocket.
+ */
+void QWebSocketServerPrivate::setAcceptedExtensions(QWebSocket *pWebSocket,
+                                                    const QString &acceptedExtensions) const
+{
+    if (acceptedExtensions.isEmpty())
+        return;
+    QList<QPointer<QWebSocketExtension>> extensions;
+    const QStringList names = acceptedExtensions.split(u',', Qt::SkipEmptyParts);
+    for (const QString &name : names) {
+        const QString trimmedName = name.trimmed();
+        for (const QPointer<QWebSocketExtension> &extension : m_supportedExtensions) {
+            if (extension && extension->name() == trimmedName) {
+                extensions.append(extension);
+                break;
+            }
+        }
+    }
+    static_cast<QWebSocketPrivate *>(QObjectPrivate::get(pWebSocket))
+            ->setActiveExtensions(extensions);
 }
 
 /*!
@@ -404,11 +645,58 @@ void QWebSocketServerPrivate::onNewConnection()
     while (m_pTcpServer->hasPendingConnections()) {
         QTcpSocket *pTcpSocket = m_pTcpServer->nextPendingConnection();
         Q_ASSERT(pTcpSocket);
+        if (Q_UNLIKELY(!admitConnection(pTcpSocket)))
+            continue;
         startHandshakeTimeout(pTcpSocket);
         handleConnection(pTcpSocket);
     }
 }
 
+/*!
+    \internal
+    Returns \c true if \a pTcpSocket is admitted by the admission control.
+    Otherwise, answers it with \c{503 Service Unavailable} right away, without
+    reading anything from it, and returns \c false.
+ */
+bool QWebSocketServerPrivate::admitConnection(QTcpSocket *pTcpSocket)
+{
+    Q_Q(QWebSocketServer);
+    const QHostAddress address = pTcpSocket->peerAddress();
+    int retryAfter = 0;
+    if (Q_LIKELY(m_admissionControl.admit(address, &retryAfter))) {
+        if (m_admissionControl.tracksAddresses()) {
+            // the socket lives as long as the connection, also after the upgrade,
+            // until it is destroyed or recycled
+            m_admittedAddresses.insert(pTcpSocket, address);
+            QObject::connect(pTcpSocket, &QObject::destroyed, q,
+                             [this, pTcpSocket]() { releaseAdmission(pTcpSocket); });
+        }
+        return true;
+    }
+    const QByteArray response = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: "
+            + QByteArray::number(retryAfter)
+            + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    QObject::connect(pTcpSocket, &QAbstractSocket::disconnected,
+                     pTcpSocket, &QObject::deleteLater);
+    pTcpSocket->write(response);
+    pTcpSocket->disconnectFromHost();
+    return false;
+}
+
+/*!
+    \internal
+    Lets the admission control know that the connection on \a pTcpSocket is
+    gone.
+ */
+void QWebSocketServerPrivate::releaseAdmission(QTcpSocket *pTcpSocket)
+{
+    const auto it = m_admittedAddresses.constFind(pTcpSocket);
+    if (it == m_admittedAddresses.cend())
+        return;
+    m_admissionControl.release(it.value());
+    m_admittedAddresses.erase(it);
+}
+
 /*!
     \internal
  */
@@ -418,11 +706,67 @@ void QWebSocketServerPrivate::onSocketDisconnected()
     QObject *sender = q->sender();
     if (Q_LIKELY(sender)) {
         QTcpSocket *pTcpSocket = qobject_cast<QTcpSocket*>(sender);
-        if (Q_LIKELY(pTcpSocket))
-            pTcpSocket->deleteLater();
+        if (Q_LIKELY(pTcpSocket)) {
+            const QPointer<QWebSocket> pWebSocket = m_upgradedSockets.take(pTcpSocket);
+            if (socketPoolSize() > 0) {
+                // the other receivers of disconnected() still use the socket
+                QMetaObject::invokeMethod(q, [this, pTcpSocket = QPointer<QTcpSocket>(pTcpSocket),
+                                              pWebSocket]() {
+                    if (pTcpSocket)
+                        recycleSocket(pTcpSocket, pWebSocket);
+                }, Qt::QueuedConnection);
+            } else {
+                pTcpSocket->deleteLater();
+            }
+        }
     }
 }
 
+/*!
+    \internal
+    Hands \a pTcpSocket, whose connection is closed, back to the socket pool
+    of the QTcpServer, after detaching it from \a pWebSocket, the connection
+    it was upgraded to, if any.
+ */
+void QWebSocketServerPrivate::recycleSocket(QTcpSocket *pTcpSocket, QWebSocket *pWebSocket)
+{
+    Q_Q(QWebSocketServer);
+    Q_ASSERT(m_secureMode == NonSecureMode);
+    // a connection moved to another thread takes its socket along; neither
+    // may be touched from here then
+    if (Q_UNLIKELY(pTcpSocket->thread() != q->thread()
+                   || (pWebSocket && pWebSocket->thread() != q->thread()))) {
+        pTcpSocket->deleteLater();
+        return;
+    }
+    if (pWebSocket)
+        static_cast<QWebSocketPrivate *>(QObjectPrivate::get(pWebSocket))->detachSocket();
+    finishHandshakeTimeout(pTcpSocket);
+    releaseAdmission(pTcpSocket);
+    static_cast<QWebSocketTcpServer *>(m_pTcpServer)->recycle(pTcpSocket);
+}
+
+/*!
+    \internal
+    Keeps at most \a size sockets of closed connections for reuse. Only
+    non-secure servers pool their sockets.
+ */
+void QWebSocketServerPrivate::setSocketPoolSize(int size)
+{
+    if (m_secureMode == NonSecureMode)
+        static_cast<QWebSocketTcpServer *>(m_pTcpServer)->setPoolSize(size);
+}
+
+/*!
+    \internal
+ */
+int QWebSocketServerPrivate::socketPoolSize() const
+{
+    if (m_secureMode == NonSecureMode)
+        return static_cast<QWebSocketTcpServer *>(m_pTcpServer)->poolSize();
+    return 0;
+}
+
 /*!
     \internal
  */
@@ -437,6 +781,11 @@ void QWebSocketServerPrivate::handshakeReceived()
     if (Q_UNLIKELY(!pTcpSocket)) {
         return;
     }
+    if (Q_UNLIKELY(m_isDraining)) {
+        // handshakes that were under way when the drain started are refused
+        pTcpSocket->close();
+        return;
+    }
     //When using Google Chrome the handshake in received in two parts.
     //Therefore, the readyRead signal is emitted twice.
     //This is a guard against the BEAST attack.
@@ -467,7 +816,6 @@ void QWebSocketServerPrivate::handshakeReceived()
 
     disconnect(pTcpSocket, &QTcpSocket::readyRead,
                this, &QWebSocketServerPrivate::handshakeReceived);
-    bool success = false;
     bool isSecure = (m_secureMode == SecureMode);
 
     if (Q_UNLIKELY(m_pendingConnections.size() >= maxPendingConnections())) {
@@ -489,46 +837,112 @@ void QWebSocketServerPrivate::handshakeReceived()
         return;
     }
 
-    QWebSocketHandshakeRequest request(pTcpSocket->peerPort(), isSecure);
-    request.readHandshake(header, QWebSocketPrivate::MAX_HEADERLINE_LENGTH);
-
-    if (request.isValid()) {
-        QWebSocketCorsAuthenticator corsAuthenticator(request.origin());
-        Q_EMIT q->originAuthenticationRequired(&corsAuthenticator);
-
-        QWebSocketHandshakeResponse response(request,
-                                             m_serverName,
-                                             corsAuthenticator.allowed(),
-                                             supportedVersions(),
-                                             supportedSubprotocols(),
-                                             supportedExtensions());
-
-        if (Q_LIKELY(response.isValid())) {
-            QTextStream httpStream(pTcpSocket);
-            httpStream << response;
-            httpStream.flush();
-
-            if (Q_LIKELY(response.canUpgrade())) {
-                QWebSocket *pWebSocket = QWebSocketPrivate::upgradeFrom(pTcpSocket,
-                                                                        request,
-                                                                        response);
-                if (Q_LIKELY(pWebSocket)) {
-                    finishHandshakeTimeout(pTcpSocket);
-                    addPendingConnection(pWebSocket);
-                    Q_EMIT q->newConnection();
-                    success = true;
-                } else {
-                    setError(QWebSocketProtocol::CloseCodeAbnormalDisconnection,
-                             QWebSocketServer::tr("Upgrade to WebSocket failed."));
+    auto request = std::make_unique<QWebSocketHandshakeRequest>(pTcpSocket->peerPort(),
+                                                                isSecure);
+    request->readHandshake(header, QWebSocketPrivate::MAX_HEADERLINE_LENGTH);
+
+    if (!request->isValid()) {
+        pTcpSocket->close();
+        return;
+    }
+    if (m_isHandshakeDeferred) {
+        // the handshake timer keeps running until the handshake is answered
+        QWebSocketPendingHandshake *handshake = new QWebSocketPendingHandshake(pTcpSocket, q);
+        static_cast<QWebSocketPendingHandshakePrivate *>(QObjectPrivate::get(handshake))
+                ->m_request = std::move(request);
+        Q_EMIT q->handshakeRequested(handshake);
+        return;
+    }
+
+    QWebSocketCorsAuthenticator corsAuthenticator(request->origin());
+    Q_EMIT q->originAuthenticationRequired(&corsAuthenticator);
+    completeHandshake(pTcpSocket, *request, corsAuthenticator.allowed());
+}
+
+/*!
+    \internal
+    Answers the deferred handshake \a request received on \a pTcpSocket,
+    accepting it if \a accepted is \c true, and adding \a responseHeaders to
+    the response.
+ */
+void QWebSocketServerPrivate::completeDeferredHandshake(QTcpSocket *pTcpSocket,
+                                                        const QWebSocketHandshakeRequest &request,
+                                                        bool accepted,
+                                                        const QHttpHeaders &responseHeaders)
+{
+    if (Q_UNLIKELY(m_isDraining)) {
+        pTcpSocket->close();
+        return;
+    }
+    if (Q_UNLIKELY(accepted && m_pendingConnections.size() >= maxPendingConnections())) {
+        pTcpSocket->close();
+        setError(QWebSocketProtocol::CloseCodeAbnormalDisconnection,
+                 QWebSocketServer::tr("Too many pending connections."));
+        return;
+    }
+    completeHandshake(pTcpSocket, request, accepted, responseHeaders);
+}
+
+/*!
+    \internal
+    Sends the response to the handshake \a request received on \a pTcpSocket,
+    with \a responseHeaders added, and upgrades the connection if
+    \a isOriginAllowed is \c true and the request can be satisfied.
+ */
+void QWebSocketServerPrivate::completeHandshake(QTcpSocket *pTcpSocket,
+                                                const QWebSocketHandshakeRequest &request,
+                                                bool isOriginAllowed,
+                                                const QHttpHeaders &responseHeaders)
+{
+    Q_Q(QWebSocketServer);
+    bool success = false;
+    QWebSocketHandshakeResponse response(request,
+                                         m_serverName,
+                                         isOriginAllowed,
+                                         supportedVersions(),
+                                         supportedSubprotocols(),
+                                         supportedExtensionNames(),
+                                         responseHeaders);
+
+    if (Q_LIKELY(response.isValid())) {
+        QTextStream httpStream(pTcpSocket);
+        httpStream << response;
+        httpStream.flush();
+
+        if (Q_LIKELY(response.canUpgrade())) {
+            QWebSocket *pWebSocket = QWebSocketPrivate::upgradeFrom(pTcpSocket,
+                                                                    request,
+                                                                    response);
+            if (Q_LIKELY(pWebSocket)) {
+                finishHandshakeTimeout(pTcpSocket);
+                if (socketPoolSize() > 0) {
+                    m_upgradedSockets.insert(pTcpSocket, pWebSocket);
+                    // disconnected() is not seen as coming from a QTcpSocket
+                    // anymore when it is emitted by its destructor
+                    QObject::connect(pTcpSocket, &QObject::destroyed, q,
+                                     [this, pTcpSocket,
+                                      pWebSocket = QPointer<QWebSocket>(pWebSocket)]() {
+                        const auto it = m_upgradedSockets.constFind(pTcpSocket);
+                        if (it != m_upgradedSockets.cend() && it.value() == pWebSocket)
+                            m_upgradedSockets.erase(it);
+                    });
                 }
+                setAcceptedExtensions(pWebSocket, response.acceptedExtension());
+                trackConnection(pWebSocket);
+                addPendingConnection(pWebSocket);
+                Q_EMIT q->newConnection();
+                success = true;
+            } else {
+                setError(QWebSocketProtocol::CloseCodeAbnormalDisconnection,
+                         QWebSocketServer::tr("Upgrade to WebSocket failed."));
             }
-            else {
-                setError(response.error(), response.errorString());
-            }
-        } else {
-            setError(QWebSocketProtocol::CloseCodeProtocolError,
-                     QWebSocketServer::tr("Invalid response received."));
         }
+        else {
+            setError(response.error(), response.errorString());
+        }
+    } else {
+        setError(QWebSocketProtocol::CloseCodeProtocolError,
+                 QWebSocketServer::tr("Invalid response received."));
     }
     if (!success) {
         pTcpSocket->close();
@@ -555,23 +969,73 @@ void QWebSocketServerPrivate::handleConnection(QTcpSocket *pTcpSocket) const
     }
 }
 
+/*!
+    \internal
+    Closes \a pTcpSocket if the handshake has not been completed within the
+    handshake timeout. A single timer serves all handshakes under way, so
+    that no timer has to be created per connection.
+ */
 void QWebSocketServerPrivate::startHandshakeTimeout(QTcpSocket *pTcpSocket)
 {
+    Q_Q(QWebSocketServer);
     if (m_handshakeTimeout < 0)
         return;
 
-    QTimer *handshakeTimer = new QTimer(pTcpSocket);
-    handshakeTimer->setSingleShot(true);
-    handshakeTimer->setObjectName(QStringLiteral("handshakeTimer"));
-    QObject::connect(handshakeTimer, &QTimer::timeout, pTcpSocket, &QAbstractSocket::close);
-    handshakeTimer->start(m_handshakeTimeout);
+    if (!m_handshakeTimer) {
+        m_handshakeTimer = new QTimer(q);
+        m_handshakeTimer->setSingleShot(true);
+        QObjectPrivate::connect(m_handshakeTimer, &QTimer::timeout,
+                                this, &QWebSocketServerPrivate::expireHandshakes);
+        m_handshakeClock.start();
+    }
+    const qint64 deadline = m_handshakeClock.elapsed() + m_handshakeTimeout;
+    // a socket deleted during its handshake leaves its entry behind, until it
+    // expires, and its address may be reused meanwhile
+    const auto stale = m_handshakeDeadlineOf.constFind(pTcpSocket);
+    if (Q_UNLIKELY(stale != m_handshakeDeadlineOf.cend()))
+        m_handshakeDeadlines.erase(stale.value());
+    const bool isEarliest = m_handshakeDeadlines.isEmpty()
+            || deadline < m_handshakeDeadlines.firstKey();
+    m_handshakeDeadlineOf.insert(pTcpSocket,
+                                 m_handshakeDeadlines.insert(deadline,
+                                                             HandshakeDeadline{ pTcpSocket,
+                                                                                pTcpSocket }));
+    if (isEarliest)
+        m_handshakeTimer->start(m_handshakeTimeout);
 }
 
 void QWebSocketServerPrivate::finishHandshakeTimeout(QTcpSocket *pTcpSocket)
 {
-    if (QTimer *handshakeTimer = pTcpSocket->findChild<QTimer *>(QStringLiteral("handshakeTimer"))) {
-        handshakeTimer->stop();
-        delete handshakeTimer;
+    const auto it = m_handshakeDeadlineOf.constFind(pTcpSocket);
+    if (it == m_handshakeDeadlineOf.cend())
+        return;
+    m_handshakeDeadlines.erase(it.value());
+    m_handshakeDeadlineOf.erase(it);
+    if (m_handshakeDeadlines.isEmpty() && m_handshakeTimer)
+        m_handshakeTimer->stop();
+}
+
+/*!
+    \internal
+    Closes the connections whose handshake timeout has expired, and waits for
+    the next one.
+ */
+void QWebSocketServerPrivate::expireHandshakes()
+{
+    const qint64 now = m_handshakeClock.elapsed();
+    while (!m_handshakeDeadlines.isEmpty()) {
+        const auto first = m_handshakeDeadlines.begin();
+        if (first->socket && first.key() > now) {
+            m_handshakeTimer->start(int(first.key() - now));
+            return;
+        }
+        const QPointer<QTcpSocket> pTcpSocket = first->socket;
+        const auto handshake = m_handshakeDeadlineOf.constFind(first->key);
+        if (handshake != m_handshakeDeadlineOf.cend() && handshake.value() == first)
+            m_handshakeDeadlineOf.erase(handshake);
+        m_handshakeDeadlines.erase(first);
+        if (pTcpSocket)
+            pTcpSocket->close();
     }
 }
 
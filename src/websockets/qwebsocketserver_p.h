@@ -14,23 +14,38 @@
 // We mean it.
 //
 
+#include <QtCore/QDeadlineTimer>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
 #include <QtCore/QObject>
+#include <QtCore/QPointer>
 #include <QtCore/QQueue>
+#include <QtCore/QSet>
 #include <QtCore/QString>
 #include <QtNetwork/QHostAddress>
+#include <QtNetwork/qhttpheaders.h>
 #include <private/qobject_p.h>
 #include "qwebsocketserver.h"
 #include "qwebsocket.h"
+#include "qwebsocketadmissioncontrol_p.h"
 
 #ifndef QT_NO_SSL
 #include <QtNetwork/QSslConfiguration>
 #include <QtNetwork/QSslError>
 #endif
 
+#include <chrono>
+#include <memory>
+
 QT_BEGIN_NAMESPACE
 
 class QTcpServer;
 class QTcpSocket;
+class QTimer;
+class QWebSocketHandshakeRequest;
+class QWebSocketMemoryBudget;
 
 class QWebSocketServerPrivate : public QObjectPrivate
 {
@@ -49,6 +64,9 @@ public:
 
     void init();
     void close(bool aboutToDestroy = false);
+    void drain(std::chrono::milliseconds gracePeriod, int closeRate,
+               QWebSocketProtocol::CloseCode closeCode, const QString &reason);
+    bool isDraining() const;
     QString errorString() const;
     bool hasPendingConnections() const;
     bool isListening() const;
@@ -57,6 +75,13 @@ public:
     int handshakeTimeout() const {
         return m_handshakeTimeout;
     }
+    void setHandshakeDeferred(bool deferred) { m_isHandshakeDeferred = deferred; }
+    bool isHandshakeDeferred() const { return m_isHandshakeDeferred; }
+    QWebSocketMemoryBudget *memoryBudget() const { return m_memoryBudget.get(); }
+    QWebSocketAdmissionControl &admissionControl() { return m_admissionControl; }
+    const QWebSocketAdmissionControl &admissionControl() const { return m_admissionControl; }
+    void setSocketPoolSize(int size);
+    int socketPoolSize() const;
     virtual QWebSocket *nextPendingConnection();
     void pauseAccepting();
 #ifndef QT_NO_NETWORKPROXY
@@ -75,7 +100,9 @@ public:
     QList<QWebSocketProtocol::Version> supportedVersions() const;
     void setSupportedSubprotocols(const QStringList &protocols);
     QStringList supportedSubprotocols() const;
-    QStringList supportedExtensions() const;
+    void setSupportedExtensions(const QList<QWebSocketExtension *> &extensions);
+    QList<QWebSocketExtension *> supportedExtensions() const;
+    QStringList supportedExtensionNames() const;
 
     void setServerName(const QString &serverName);
     QString serverName() const;
@@ -90,29 +117,89 @@ public:
     void setError(QWebSocketProtocol::CloseCode code, const QString &errorString);
 
     void handleConnection(QTcpSocket *pTcpSocket) const;
-
-private slots:
-    void startHandshakeTimeout(QTcpSocket *pTcpSocket);
+    void completeDeferredHandshake(QTcpSocket *pTcpSocket,
+                                   const QWebSocketHandshakeRequest &request, bool accepted,
+                                   const QHttpHeaders &responseHeaders);
 
 private:
+    struct HandshakeDeadline
+    {
+        // the key in m_handshakeDeadlineOf, also once the socket is deleted
+        QTcpSocket *key;
+        QPointer<QTcpSocket> socket;
+    };
+    using HandshakeDeadlines = QMultiMap<qint64, HandshakeDeadline>;
+
     QTcpServer *m_pTcpServer;
     QString m_serverName;
     SslMode m_secureMode;
     QStringList m_supportedSubprotocols;
+    QList<QPointer<QWebSocketExtension>> m_supportedExtensions;
     QQueue<QWebSocket *> m_pendingConnections;
     QWebSocketProtocol::CloseCode m_error;
     QString m_errorString;
     int m_maxPendingConnections;
     int m_handshakeTimeout;
 
+    // upgraded connections, whether pending or not; deleted ones are removed
+    // once the list has doubled in size since it was last compacted
+    QList<QPointer<QWebSocket>> m_connections;
+    qsizetype m_connectionsCompactionSize = 0;
+    // while draining, the connections that are still connected
+    QSet<QWebSocket *> m_liveConnections;
+
+    // state of drain(): m_drainQueue holds the connections that still have to
+    // be closed, in random order
+    QList<QPointer<QWebSocket>> m_drainQueue;
+    QTimer *m_drainTimer = nullptr;
+    QElapsedTimer m_drainClock;
+    QDeadlineTimer m_drainDeadline;
+    std::chrono::milliseconds m_drainGracePeriod{ 0 };
+    qint64 m_drainClosedCount = 0;
+    qsizetype m_drainReportedCount = -1;
+    int m_drainCloseRate = 0;
+    QWebSocketProtocol::CloseCode m_drainCloseCode = QWebSocketProtocol::CloseCodeGoingAway;
+    QString m_drainCloseReason;
+    bool m_isDraining = false;
+    bool m_isHandshakeDeferred = false;
+
+    // shared with the connections, which may outlive the server
+    std::shared_ptr<QWebSocketMemoryBudget> m_memoryBudget;
+
+    QWebSocketAdmissionControl m_admissionControl;
+    QHash<QTcpSocket *, QHostAddress> m_admittedAddresses;
+
+    // handshakes under way, ordered by deadline, served by a single timer
+    HandshakeDeadlines m_handshakeDeadlines;
+    QHash<QTcpSocket *, HandshakeDeadlines::iterator> m_handshakeDeadlineOf;
+    QTimer *m_handshakeTimer = nullptr;
+    QElapsedTimer m_handshakeClock;
+
+    // sockets of upgraded connections, to detach them before they are
+    // recycled; only kept while the socket pool is enabled
+    QHash<QTcpSocket *, QPointer<QWebSocket>> m_upgradedSockets;
+
+    std::chrono::milliseconds m_idleTrimInterval{ 0 };
+
     void addPendingConnection(QWebSocket *pWebSocket);
+    void trackConnection(QWebSocket *pWebSocket);
+    void setAcceptedExtensions(QWebSocket *pWebSocket, const QString &acceptedExtensions) const;
+    void drainStep();
+    void stopDraining();
     void setErrorFromSocketError(QAbstractSocket::SocketError error,
                                  const QString &errorDescription);
 
     void onNewConnection();
+    bool admitConnection(QTcpSocket *pTcpSocket);
+    void releaseAdmission(QTcpSocket *pTcpSocket);
     void onSocketDisconnected();
+    void recycleSocket(QTcpSocket *pTcpSocket, QWebSocket *pWebSocket);
     void handshakeReceived();
+    void completeHandshake(QTcpSocket *pTcpSocket, const QWebSocketHandshakeRequest &request,
+                           bool isOriginAllowed, const QHttpHeaders &responseHeaders = {});
+    void startHandshakeTimeout(QTcpSocket *pTcpSocket);
     void finishHandshakeTimeout(QTcpSocket *pTcpSocket);
+    void expireHandshakes();
 };
 
 QT_END_NAMESPACE
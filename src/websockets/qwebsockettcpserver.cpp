@@ -0,0 +1,88 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qwebsockettcpserver_p.h"
+
+#include <QtNetwork/QTcpSocket>
+
+QT_BEGIN_NAMESPACE
+
+/*!
+    \class QWebSocketTcpServer
+    \internal
+
+    QTcpServer that reuses the QTcpSocket objects of closed connections for
+    new connections, instead of allocating and constructing a new one every
+    time. The sockets are handed back by QWebSocketServer with recycle().
+ */
+
+/*!
+    \internal
+ */
+QWebSocketTcpServer::QWebSocketTcpServer(QObject *parent) :
+    QTcpServer(parent)
+{}
+
+/*!
+    \internal
+ */
+QWebSocketTcpServer::~QWebSocketTcpServer()
+{
+    qDeleteAll(m_freeSockets);
+}
+
+/*!
+    \internal
+    Keeps at most \a size sockets for reuse; 0 disables the pool.
+ */
+void QWebSocketTcpServer::setPoolSize(int size)
+{
+    m_poolSize = qMax(size, 0);
+    while (m_freeSockets.size() > m_poolSize)
+        delete m_freeSockets.takeLast();
+}
+
+/*!
+    \internal
+    Resets \a pTcpSocket and keeps it for a later connection, if the pool is
+    not full. Otherwise, deletes it later and returns \c false.
+
+    All signal connections of \a pTcpSocket are removed, so whoever used it
+    must have let go of it already.
+ */
+bool QWebSocketTcpServer::recycle(QTcpSocket *pTcpSocket)
+{
+    Q_ASSERT(pTcpSocket);
+    if (m_freeSockets.size() >= m_poolSize || pTcpSocket->thread() != thread()) {
+        pTcpSocket->deleteLater();
+        return false;
+    }
+    pTcpSocket->disconnect();
+    pTcpSocket->abort();
+    pTcpSocket->setReadBufferSize(0);
+    pTcpSocket->setPauseMode(QAbstractSocket::PauseNever);
+    pTcpSocket->setParent(this);
+    m_freeSockets.append(pTcpSocket);
+    return true;
+}
+
+/*!
+    \internal
+ */
+void QWebSocketTcpServer::incomingConnection(qintptr socketDescriptor)
+{
+    // the most recently used socket is the most likely to be in the cache
+    QTcpSocket *pTcpSocket = m_freeSockets.isEmpty() ? nullptr : m_freeSockets.takeLast();
+    if (!pTcpSocket) {
+        QTcpServer::incomingConnection(socketDescriptor);
+        return;
+    }
+    if (Q_UNLIKELY(!pTcpSocket->setSocketDescriptor(socketDescriptor))) {
+        delete pTcpSocket;
+        QTcpServer::incomingConnection(socketDescriptor);
+        return;
+    }
+    addPendingConnection(pTcpSocket);
+}
+
+QT_END_NAMESPACE
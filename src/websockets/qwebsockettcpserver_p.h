@@ -0,0 +1,48 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETTCPSERVER_P_H
+#define QWEBSOCKETTCPSERVER_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/QList>
+#include <QtNetwork/QTcpServer>
+
+QT_BEGIN_NAMESPACE
+
+class QTcpSocket;
+
+// The QTcpServer of a non-secure QWebSocketServer: keeps the sockets of
+// closed connections, up to poolSize(), to accept new connections with.
+class QWebSocketTcpServer : public QTcpServer
+{
+public:
+    explicit QWebSocketTcpServer(QObject *parent = nullptr);
+    ~QWebSocketTcpServer() override;
+
+    void setPoolSize(int size);
+    int poolSize() const { return m_poolSize; }
+    qsizetype pooledSockets() const { return m_freeSockets.size(); }
+
+    bool recycle(QTcpSocket *pTcpSocket);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    QList<QTcpSocket *> m_freeSockets;
+    int m_poolSize = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETTCPSERVER_P_H
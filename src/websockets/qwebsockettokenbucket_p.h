@@ -0,0 +1,83 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QWEBSOCKETTOKENBUCKET_P_H
+#define QWEBSOCKETTOKENBUCKET_P_H
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/qglobal.h>
+
+QT_BEGIN_NAMESPACE
+
+// Token bucket that is refilled with rate() tokens per second, and holds at
+// most one second worth of tokens. Tokens are counted in thousandths, so that
+// a bucket refilled every millisecond does not lose the fractions.
+// A rate of 0 or less means no limit. Times are in milliseconds of a
+// monotonic clock, passed in by the caller.
+class QWebSocketTokenBucket
+{
+public:
+    void setRate(qint64 rate, qint64 now)
+    {
+        m_rate = rate;
+        m_milliTokens = capacity();
+        m_lastRefill = now;
+    }
+    qint64 rate() const { return m_rate; }
+    bool isLimited() const { return m_rate > 0; }
+
+    void refill(qint64 now)
+    {
+        if (!isLimited())
+            return;
+        const qint64 elapsed = now - m_lastRefill;
+        m_lastRefill = now;
+        const qint64 missing = capacity() - m_milliTokens;
+        if (elapsed <= 0 || missing <= 0)
+            return;
+        // compared first, so that long pauses cannot overflow
+        if (elapsed >= (missing + m_rate - 1) / m_rate)
+            m_milliTokens = capacity();
+        else
+            m_milliTokens += elapsed * m_rate;
+    }
+
+    bool isAvailable(qint64 tokens = 1) const
+    {
+        return !isLimited() || m_milliTokens >= tokens * 1000;
+    }
+    bool isFull() const { return !isLimited() || m_milliTokens >= capacity(); }
+    // may take more than is available, which is then paid back first
+    void take(qint64 tokens = 1)
+    {
+        if (isLimited())
+            m_milliTokens -= tokens * 1000;
+    }
+
+    qint64 msecsUntilAvailable(qint64 tokens = 1) const
+    {
+        if (isAvailable(tokens))
+            return 0;
+        return (tokens * 1000 - m_milliTokens + m_rate - 1) / m_rate;
+    }
+
+private:
+    qint64 capacity() const { return m_rate * 1000; }
+
+    qint64 m_rate = 0;
+    qint64 m_milliTokens = 0;
+    qint64 m_lastRefill = 0;
+};
+
+QT_END_NAMESPACE
+
+#endif // QWEBSOCKETTOKENBUCKET_P_H
@@ -153,6 +153,9 @@ private Q_SLOTS:
 
     void clearDataBuffers(); // qtbug-55506
 
+    void pendingData_data();
+    void pendingData();
+
 private:
     //helper function that constructs a new row of test data for invalid UTF8 sequences
     void invalidUTF8(const char *dataTag, const char *utf8Sequence, bool isCloseFrame);
@@ -1879,6 +1882,64 @@ void tst_DataProcessor::clearDataBuffers()
     QTest::qWait(2000);
 }
 
+void tst_DataProcessor::pendingData_data()
+{
+    QTest::addColumn<quint32>("maskingKey");
+
+    QTest::newRow("unmasked") << 0U;
+    QTest::newRow("masked") << 0x12345678U;
+}
+
+void tst_DataProcessor::pendingData()
+{
+    QFETCH(quint32, maskingKey);
+
+    // a text message in three frames, the second one with a 16-bit length
+    const QString message = QStringLiteral("h\u00e9llo ") + QString(200, u'x')
+            + QStringLiteral(" w\u00f6rld");
+    const QByteArray utf8 = message.toUtf8();
+    const qsizetype frameSizes[] = { 10, 200, utf8.size() - 210 };
+    QByteArray data;
+    qsizetype offset = 0;
+    for (qsizetype frameSize : frameSizes) {
+        const bool isLastFrame = offset + frameSize == utf8.size();
+        char header[QWebSocketFrame::MaxHeaderSize];
+        const qsizetype headerSize = QWebSocketFrame::encodeHeader(
+                    header, offset == 0 ? QWebSocketProtocol::OpCodeText
+                                        : QWebSocketProtocol::OpCodeContinue,
+                    quint64(frameSize), maskingKey, isLastFrame);
+        QByteArray payload = utf8.mid(offset, frameSize);
+        if (maskingKey)
+            QWebSocketProtocol::mask(&payload, maskingKey);
+        data.append(header, headerSize).append(payload);
+        offset += frameSize;
+    }
+
+    // hand over at every byte; the second processor has to end up with the
+    // whole message
+    for (qsizetype cut = 0; cut < data.size(); ++cut) {
+        QByteArray firstPart = data.left(cut);
+        QBuffer firstBuffer(&firstPart);
+        QVERIFY(firstBuffer.open(QIODevice::ReadOnly));
+        QWebSocketDataProcessor first;
+        QSignalSpy firstSpy(&first, &QWebSocketDataProcessor::textMessageReceived);
+        while (firstBuffer.bytesAvailable() && first.process(&firstBuffer)) {
+        }
+        QCOMPARE(firstSpy.size(), 0);
+
+        QByteArray secondPart = first.pendingData() + firstPart.mid(firstBuffer.pos())
+                + data.mid(cut);
+        QBuffer secondBuffer(&secondPart);
+        QVERIFY(secondBuffer.open(QIODevice::ReadOnly));
+        QWebSocketDataProcessor second;
+        QSignalSpy secondSpy(&second, &QWebSocketDataProcessor::textMessageReceived);
+        while (secondBuffer.bytesAvailable() && second.process(&secondBuffer)) {
+        }
+        QVERIFY2(secondSpy.size() == 1, qPrintable(QString::number(cut)));
+        QCOMPARE(secondSpy.at(0).at(0).toString(), message);
+    }
+}
+
 QTEST_MAIN(tst_DataProcessor)
 
 #include "tst_dataprocessor.moc"
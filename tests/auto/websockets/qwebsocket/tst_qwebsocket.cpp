@@ -4,8 +4,10 @@
 #include <QString>
 #include <QtTest>
 #include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketClientContext>
 #include <QtWebSockets/QWebSocketHandshakeOptions>
 #include <QtWebSockets/QWebSocketCorsAuthenticator>
+#include <QtWebSockets/QWebSocketExtension>
 #include <QtWebSockets/QWebSocketServer>
 #include <QtWebSockets/qwebsocketprotocol.h>
 
@@ -22,7 +24,16 @@
 #include <QtNetwork/qsslsocket.h>
 #endif
 
+#include <memory>
 #include <utility>
+#include <vector>
+
+#include "../shared/invertingextension.h"
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_WASM)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 QT_USE_NAMESPACE
 
@@ -52,6 +63,46 @@ bool sslServerIsBlockingKeychain()
 }
 #endif // QT_CONFIG(ssl)
 
+#if defined(Q_OS_UNIX) && !defined(Q_OS_WASM)
+// Passes a descriptor over a Unix domain socket, as between two processes
+static bool sendDescriptor(int channel, int descriptor)
+{
+    char byte = 0;
+    iovec vector = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message = {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(header), &descriptor, sizeof(int));
+    return ::sendmsg(channel, &message, 0) == 1;
+}
+
+static int receiveDescriptor(int channel)
+{
+    char byte = 0;
+    iovec vector = { &byte, 1 };
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message = {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    if (::recvmsg(channel, &message, 0) != 1)
+        return -1;
+    const cmsghdr *header = CMSG_FIRSTHDR(&message);
+    if (!header || header->cmsg_type != SCM_RIGHTS)
+        return -1;
+    int descriptor = -1;
+    memcpy(&descriptor, CMSG_DATA(header), sizeof(int));
+    return descriptor;
+}
+#endif
 
 using namespace Qt::StringLiterals;
 
@@ -188,6 +239,21 @@ private Q_SLOTS:
     void incomingFrameTooLong();
     void testingFrameAndMessageSizeApi();
     void customHeader();
+    void pingDuringLargeTransfer();
+    void highPriorityMessage();
+    void sendFile_data();
+    void sendFile();
+    void postMessageFromThreads();
+    void handOver();
+    void handOverPartialFrame();
+    void relay();
+    void extensions();
+    void compressingExtensions_data();
+    void compressingExtensions();
+    void incomingRateLimits_data();
+    void incomingRateLimits();
+    void messagePipelining_data();
+    void messagePipelining();
 };
 
 tst_QWebSocket::tst_QWebSocket()
@@ -1228,7 +1294,9 @@ void tst_QWebSocket::authenticationRequired()
     url.setUserName(clientScenario.urlCredentials.username);
     url.setPassword(clientScenario.urlCredentials.password);
 
+    QWebSocketClientContext context;
     QWebSocket socket;
+    socket.setClientContext(&context);
     QSignalSpy connectedSpy(&socket, &QWebSocket::connected);
     QSignalSpy errorSpy(&socket, &QWebSocket::errorOccurred);
     QSignalSpy stateChangedSpy(&socket, &QWebSocket::stateChanged);
@@ -1255,6 +1323,8 @@ void tst_QWebSocket::authenticationRequired()
         QCOMPARE_EQ(firstState, QAbstractSocket::ConnectingState);
         auto secondState = stateChangedSpy.at(1).front().value<QAbstractSocket::SocketState>();
         QCOMPARE_EQ(secondState, QAbstractSocket::ConnectedState);
+        // reconnecting to answer the challenge does not count as a connection
+        QCOMPARE_EQ(context.connectionCount(), quint64(1));
     } else {
         // Wait for error!
         QTRY_COMPARE_EQ(errorSpy.size(), 1);
@@ -1423,6 +1493,704 @@ void tst_QWebSocket::customHeader()
     QVERIFY(connectedSpy.wait());
 }
 
+// A pong must not wait for a large message that is still being sent
+void tst_QWebSocket::pingDuringLargeTransfer()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    // large enough to still be queued on the server when the ping arrives
+    const QByteArray payload(8 * 1024 * 1024, 'a');
+    connect(&server, &QWebSocketServer::newConnection, &server, [&server, &payload]() {
+        QWebSocket *serverSocket = server.nextPendingConnection();
+        serverSocket->setParent(&server);
+        serverSocket->setOutgoingFrameSize(64 * 1024);
+        QCOMPARE(serverSocket->sendBinaryMessage(payload), payload.size());
+        QVERIFY(serverSocket->bytesToWrite() >= payload.size());
+    });
+
+    QWebSocket socket;
+    bool pinged = false;
+    bool messageReceived = false;
+    bool pongBeforeMessage = false;
+    qint64 roundTripTime = -1;
+    connect(&socket, &QWebSocket::binaryFrameReceived, &socket, [&socket, &pinged]() {
+        if (!std::exchange(pinged, true))
+            socket.ping(QByteArrayLiteral("rtt"));
+    });
+    connect(&socket, &QWebSocket::pong, &socket,
+            [&](quint64 elapsedTime, const QByteArray &pongPayload) {
+        QCOMPARE(pongPayload, QByteArrayLiteral("rtt"));
+        roundTripTime = qint64(elapsedTime);
+        pongBeforeMessage = !messageReceived;
+    });
+    connect(&socket, &QWebSocket::binaryMessageReceived, &socket,
+            [&](const QByteArray &message) {
+        QCOMPARE(message.size(), payload.size());
+        messageReceived = true;
+    });
+
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    socket.open(url);
+    QTRY_VERIFY_WITH_TIMEOUT(messageReceived, 10000);
+    QVERIFY(roundTripTime >= 0);
+    QVERIFY(pongBeforeMessage);
+}
+
+void tst_QWebSocket::highPriorityMessage()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    // large enough to still be queued on the server when the ping arrives
+    const QByteArray payload(8 * 1024 * 1024, 'a');
+    connect(&server, &QWebSocketServer::newConnection, &server, [&server, &payload]() {
+        QWebSocket *serverSocket = server.nextPendingConnection();
+        serverSocket->setParent(&server);
+        serverSocket->setOutgoingFrameSize(64 * 1024);
+        serverSocket->sendBinaryMessage(payload);
+        serverSocket->sendTextMessage(QStringLiteral("normal"));
+        serverSocket->sendTextMessage(QStringLiteral("urgent"), QWebSocket::HighPriority);
+    });
+
+    QWebSocket socket;
+    QStringList received;
+    connect(&socket, &QWebSocket::textMessageReceived, &socket,
+            [&received](const QString &message) { received << message; });
+    connect(&socket, &QWebSocket::binaryMessageReceived, &socket,
+            [&received](const QByteArray &) { received << QStringLiteral("binary"); });
+
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    socket.open(url);
+    QTRY_COMPARE_WITH_TIMEOUT(received.size(), 3, 60000);
+    // the binary message was already being sent, so it is finished first
+    QCOMPARE(received, QStringList({ QStringLiteral("binary"), QStringLiteral("urgent"),
+                                     QStringLiteral("normal") }));
+}
+
+void tst_QWebSocket::sendFile_data()
+{
+    QTest::addColumn<bool>("fromServer");
+    QTest::addColumn<qint64>("offset");
+    QTest::addColumn<qint64>("length");
+
+    // frames sent by a server are not masked and can bypass the write buffer
+    QTest::newRow("server, whole file") << true << qint64(0) << qint64(-1);
+    QTest::newRow("server, range") << true << qint64(1000) << qint64(3 * 1024 * 1024);
+    QTest::newRow("server, empty range") << true << qint64(1000) << qint64(0);
+    QTest::newRow("client, whole file") << false << qint64(0) << qint64(-1);
+    QTest::newRow("client, range") << false << qint64(12345) << qint64(100000);
+}
+
+void tst_QWebSocket::sendFile()
+{
+    QFETCH(bool, fromServer);
+    QFETCH(qint64, offset);
+    QFETCH(qint64, length);
+
+    QByteArray content(8 * 1024 * 1024, Qt::Uninitialized);
+    for (qsizetype i = 0; i < content.size(); ++i)
+        content[i] = char(i % 251);
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(content), content.size());
+    QVERIFY(file.flush());
+    const QByteArray expected = content.mid(offset, length);
+
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocket client;
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url);
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    QWebSocket *sender = fromServer ? serverSocket.get() : &client;
+    QWebSocket *receiver = fromServer ? &client : serverSocket.get();
+    sender->setOutgoingFrameSize(256 * 1024);
+    QSignalSpy messageSpy(receiver, &QWebSocket::binaryMessageReceived);
+
+    QCOMPARE(sender->sendFile(&file, offset, length), expected.size());
+    // messages queued after the file are sent after it
+    sender->sendBinaryMessage(QByteArrayLiteral("after"));
+    QTRY_COMPARE_WITH_TIMEOUT(messageSpy.size(), 2, 30000);
+    QCOMPARE(messageSpy.at(0).at(0).toByteArray(), expected);
+    QCOMPARE(messageSpy.at(1).at(0).toByteArray(), QByteArrayLiteral("after"));
+    QCOMPARE(sender->bytesToWrite(), 0);
+
+    // invalid ranges are rejected
+    QCOMPARE(sender->sendFile(&file, content.size() + 1), -1);
+    QCOMPARE(sender->sendFile(&file, 1, content.size()), -1);
+    QCOMPARE(sender->sendFile(nullptr), -1);
+}
+
+void tst_QWebSocket::postMessageFromThreads()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocket client;
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url);
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    constexpr int threadCount = 4;
+    constexpr int messagesPerThread = 1000;
+    QList<int> nextIndex(threadCount, 0);
+    int received = 0;
+    bool inOrder = true;
+    connect(serverSocket.get(), &QWebSocket::textMessageReceived, this,
+            [&](const QString &message) {
+        const QStringList parts = message.split(u' ');
+        const int thread = parts.at(0).toInt();
+        const int index = parts.at(1).toInt();
+        inOrder = inOrder && index == nextIndex.at(thread);
+        nextIndex[thread] = index + 1;
+        ++received;
+    });
+
+    std::vector<std::unique_ptr<QThread>> threads;
+    for (int i = 0; i < threadCount; ++i) {
+        threads.emplace_back(QThread::create([&client, i]() {
+            for (int index = 0; index < messagesPerThread; ++index)
+                client.postTextMessage(QString::number(i) + u' ' + QString::number(index));
+        }));
+        threads.back()->start();
+    }
+    for (const std::unique_ptr<QThread> &thread : threads)
+        QVERIFY(thread->wait());
+
+    QTRY_COMPARE(received, threadCount * messagesPerThread);
+    // messages of one thread keep their order
+    QVERIFY(inOrder);
+}
+
+void tst_QWebSocket::handOver()
+{
+#if !defined(Q_OS_UNIX) || defined(Q_OS_WASM)
+    QSKIP("Connections can only be handed over on Unix");
+#else
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocket client;
+    QSignalSpy clientMessageSpy(&client, &QWebSocket::textMessageReceived);
+    QSignalSpy clientDisconnectedSpy(&client, &QWebSocket::disconnected);
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url);
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    // not read by the server before the handover, so it has to go along
+    client.sendTextMessage(QStringLiteral("before"));
+    QVERIFY(client.flush());
+
+    qintptr descriptor = -1;
+    const QByteArray state = serverSocket->saveState(&descriptor);
+    QVERIFY(!state.isEmpty());
+    QVERIFY(descriptor >= 0);
+    QCOMPARE(serverSocket->state(), QAbstractSocket::UnconnectedState);
+
+    int channel[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    QVERIFY(sendDescriptor(channel[0], int(descriptor)));
+    ::close(int(descriptor));
+    const int receivedDescriptor = receiveDescriptor(channel[1]);
+    ::close(channel[0]);
+    ::close(channel[1]);
+    QVERIFY(receivedDescriptor >= 0);
+
+    QVERIFY(!QWebSocket::restoreState(receivedDescriptor, QByteArray("garbage")));
+    std::unique_ptr<QWebSocket> restored(QWebSocket::restoreState(receivedDescriptor, state));
+    QVERIFY(restored);
+    QCOMPARE(restored->state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(restored->requestUrl().path(), serverSocket->requestUrl().path());
+    QSignalSpy restoredMessageSpy(restored.get(), &QWebSocket::textMessageReceived);
+
+    QTRY_COMPARE(restoredMessageSpy.size(), 1);
+    QCOMPARE(restoredMessageSpy.at(0).at(0).toString(), QStringLiteral("before"));
+    client.sendTextMessage(QStringLiteral("after"));
+    QTRY_COMPARE(restoredMessageSpy.size(), 2);
+    QCOMPARE(restoredMessageSpy.at(1).at(0).toString(), QStringLiteral("after"));
+
+    // the server sends unmasked frames, as before the handover
+    restored->sendTextMessage(QStringLiteral("reply"));
+    QTRY_COMPARE(clientMessageSpy.size(), 1);
+    QCOMPARE(clientMessageSpy.at(0).at(0).toString(), QStringLiteral("reply"));
+    QCOMPARE(clientDisconnectedSpy.size(), 0);
+#endif
+}
+
+void tst_QWebSocket::handOverPartialFrame()
+{
+#if !defined(Q_OS_UNIX) || defined(Q_OS_WASM)
+    QSKIP("Connections can only be handed over on Unix");
+#else
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    // a plain socket as the client, to send a frame in two halves
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    client.write("GET / HTTP/1.1\r\n"
+                 "Host: 127.0.0.1\r\n"
+                 "Upgrade: websocket\r\n"
+                 "Connection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                 "Sec-WebSocket-Version: 13\r\n"
+                 "\r\n");
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_VERIFY(client.readAll().startsWith("HTTP/1.1 101"));
+
+    // a masked text frame with a masking key of 0, so the payload is as is
+    const QByteArray payload(100000, 'x');
+    QByteArray frame("\x81\xFF", 2);
+    for (int shift = 56; shift >= 0; shift -= 8)
+        frame.append(char(quint64(payload.size()) >> shift));
+    frame.append(4, '\0');
+    frame.append(payload);
+    const qsizetype half = frame.size() / 2;
+    client.write(frame.first(half));
+    QVERIFY(client.waitForBytesWritten());
+    // let the server read the first half
+    QTest::qWait(100);
+
+    qintptr descriptor = -1;
+    const QByteArray state = serverSocket->saveState(&descriptor);
+    QVERIFY(!state.isEmpty());
+    QVERIFY(descriptor >= 0);
+    int channel[2];
+    QCOMPARE(::socketpair(AF_UNIX, SOCK_STREAM, 0, channel), 0);
+    QVERIFY(sendDescriptor(channel[0], int(descriptor)));
+    ::close(int(descriptor));
+    const int receivedDescriptor = receiveDescriptor(channel[1]);
+    ::close(channel[0]);
+    ::close(channel[1]);
+    QVERIFY(receivedDescriptor >= 0);
+    std::unique_ptr<QWebSocket> restored(QWebSocket::restoreState(receivedDescriptor, state));
+    QVERIFY(restored);
+    QSignalSpy restoredMessageSpy(restored.get(), &QWebSocket::textMessageReceived);
+
+    // the frame is completed from the socket, and the socket is read directly
+    // for the frames after it
+    client.write(frame.sliced(half));
+    client.write(QByteArray("\x81\x82\0\0\0\0ok", 8));
+    QTRY_COMPARE(restoredMessageSpy.size(), 2);
+    QCOMPARE(restoredMessageSpy.at(0).at(0).toString(), QString::fromLatin1(payload));
+    QCOMPARE(restoredMessageSpy.at(1).at(0).toString(), QStringLiteral("ok"));
+#endif
+}
+
+void tst_QWebSocket::relay()
+{
+    // client <-> gateway <-> backend, the gateway relaying in both directions
+    QWebSocketServer gateway(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(gateway.listen(QHostAddress::LocalHost));
+    QWebSocketServer backend(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(backend.listen(QHostAddress::LocalHost));
+    QSignalSpy gatewayConnectionSpy(&gateway, &QWebSocketServer::newConnection);
+    QSignalSpy backendConnectionSpy(&backend, &QWebSocketServer::newConnection);
+
+    QWebSocket client;
+    // fragmented messages are relayed frame by frame
+    client.setOutgoingFrameSize(1000);
+    QSignalSpy clientTextSpy(&client, &QWebSocket::textMessageReceived);
+    QSignalSpy clientBinarySpy(&client, &QWebSocket::binaryMessageReceived);
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(gateway.serverPort());
+    client.open(url);
+    QTRY_COMPARE(gatewayConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> gatewaySocket(gateway.nextPendingConnection());
+    QVERIFY(gatewaySocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    QWebSocket backendClient;
+    url.setPort(backend.serverPort());
+    backendClient.open(url);
+    QTRY_COMPARE(backendConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> backendSocket(backend.nextPendingConnection());
+    QVERIFY(backendSocket);
+    QTRY_COMPARE(backendClient.state(), QAbstractSocket::ConnectedState);
+
+    gatewaySocket->setRelayTarget(&backendClient);
+    backendClient.setRelayTarget(gatewaySocket.get());
+    QCOMPARE(gatewaySocket->relayTarget(), &backendClient);
+    QSignalSpy gatewayTextSpy(gatewaySocket.get(), &QWebSocket::textMessageReceived);
+    QSignalSpy relayedSpy(gatewaySocket.get(), &QWebSocket::messageRelayed);
+
+    // the backend echoes, in frames of another size
+    backendSocket->setOutgoingFrameSize(300);
+    connect(backendSocket.get(), &QWebSocket::textMessageReceived, backendSocket.get(),
+            [&](const QString &message) { backendSocket->sendTextMessage(message); });
+    connect(backendSocket.get(), &QWebSocket::binaryMessageReceived, backendSocket.get(),
+            [&](const QByteArray &message) { backendSocket->sendBinaryMessage(message); });
+
+    const QString text = QStringLiteral("\u00e4\u20ac relayed ").repeated(500);
+    QByteArray binary(100000, Qt::Uninitialized);
+    for (qsizetype i = 0; i < binary.size(); ++i)
+        binary[i] = char(i * 7);
+    client.sendTextMessage(text);
+    client.sendBinaryMessage(binary);
+    client.sendTextMessage(QStringLiteral("last"));
+
+    QTRY_COMPARE(clientTextSpy.size(), 2);
+    QTRY_COMPARE(clientBinarySpy.size(), 1);
+    QCOMPARE(clientTextSpy.at(0).at(0).toString(), text);
+    QCOMPARE(clientBinarySpy.at(0).at(0).toByteArray(), binary);
+    QCOMPARE(clientTextSpy.at(1).at(0).toString(), QStringLiteral("last"));
+
+    // messages are not delivered on the gateway, but can be inspected
+    QCOMPARE(gatewayTextSpy.size(), 0);
+    QCOMPARE(relayedSpy.size(), 3);
+    QCOMPARE(relayedSpy.at(0).at(0).toByteArray(), text.toUtf8());
+    QCOMPARE(relayedSpy.at(0).at(1).toBool(), false);
+    QCOMPARE(relayedSpy.at(1).at(0).toByteArray(), binary);
+    QCOMPARE(relayedSpy.at(1).at(1).toBool(), true);
+
+    // a target with extensions encodes the messages it relays
+    InvertingExtension backendExtension(10);
+    QWebSocketServer encodingBackend(QString(), QWebSocketServer::NonSecureMode);
+    encodingBackend.setSupportedExtensions({ &backendExtension });
+    QVERIFY(encodingBackend.listen(QHostAddress::LocalHost));
+    QSignalSpy encodingBackendConnectionSpy(&encodingBackend, &QWebSocketServer::newConnection);
+    InvertingExtension backendClientExtension(10);
+    QWebSocketHandshakeOptions options;
+    options.setExtensions({ &backendClientExtension });
+    QWebSocket encodingBackendClient;
+    url.setPort(encodingBackend.serverPort());
+    encodingBackendClient.open(url, options);
+    QTRY_COMPARE(encodingBackendConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> encodingBackendSocket(encodingBackend.nextPendingConnection());
+    QVERIFY(encodingBackendSocket);
+    QTRY_COMPARE(encodingBackendClient.state(), QAbstractSocket::ConnectedState);
+    QSignalSpy encodingBackendTextSpy(encodingBackendSocket.get(),
+                                      &QWebSocket::textMessageReceived);
+    gatewaySocket->setRelayTarget(&encodingBackendClient);
+    client.sendTextMessage(text);
+    QTRY_COMPARE(encodingBackendTextSpy.size(), 1);
+    QCOMPARE(encodingBackendTextSpy.at(0).at(0).toString(), text);
+    QCOMPARE(backendClientExtension.encodedCount.load(), 1);
+    QCOMPARE(backendExtension.decodedCount.load(), 1);
+
+    // without a relay target, messages are delivered again
+    gatewaySocket->setRelayTarget(nullptr);
+    QCOMPARE(gatewaySocket->relayTarget(), nullptr);
+    client.sendTextMessage(QStringLiteral("local"));
+    QTRY_COMPARE(gatewayTextSpy.size(), 1);
+    QCOMPARE(gatewayTextSpy.at(0).at(0).toString(), QStringLiteral("local"));
+
+    // targets in other threads are refused
+    QThread otherThread;
+    auto *otherTarget = new QWebSocket;
+    otherTarget->moveToThread(&otherThread);
+    QTest::ignoreMessage(QtWarningMsg,
+                         "QWebSocket::setRelayTarget: the target must live in the same thread");
+    gatewaySocket->setRelayTarget(otherTarget);
+    QCOMPARE(gatewaySocket->relayTarget(), nullptr);
+    otherThread.start();
+    otherTarget->deleteLater();
+    otherThread.quit();
+    QVERIFY(otherThread.wait());
+}
+
+void tst_QWebSocket::extensions()
+{
+    InvertingExtension serverExtension(10);
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setSupportedExtensions({ &serverExtension });
+    QCOMPARE(server.supportedExtensions(), QList<QWebSocketExtension *>{ &serverExtension });
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy serverConnectionSpy(&server, &QWebSocketServer::newConnection);
+
+    InvertingExtension clientExtension(10);
+    QWebSocketHandshakeOptions options;
+    options.setExtensions({ &clientExtension });
+    QCOMPARE(options.extensions(), QList<QWebSocketExtension *>{ &clientExtension });
+
+    QWebSocket client;
+    // encoded messages may still be fragmented
+    client.setOutgoingFrameSize(100);
+    QSignalSpy clientTextSpy(&client, &QWebSocket::textMessageReceived);
+    QSignalSpy clientBinarySpy(&client, &QWebSocket::binaryMessageReceived);
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url, options);
+    QTRY_COMPARE(serverConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+    connect(serverSocket.get(), &QWebSocket::textMessageReceived, serverSocket.get(),
+            [&](const QString &message) { serverSocket->sendTextMessage(message); });
+    connect(serverSocket.get(), &QWebSocket::binaryMessageReceived, serverSocket.get(),
+            [&](const QByteArray &message) { serverSocket->sendBinaryMessage(message); });
+
+    const QString text = QStringLiteral("\u00e4\u20ac encoded ").repeated(100);
+    QByteArray binary(1000, Qt::Uninitialized);
+    for (qsizetype i = 0; i < binary.size(); ++i)
+        binary[i] = char(i * 7);
+    client.sendTextMessage(text);
+    client.sendBinaryMessage(binary);
+    // too short to be encoded
+    client.sendTextMessage(QStringLiteral("short"));
+
+    QTRY_COMPARE(clientTextSpy.size(), 2);
+    QTRY_COMPARE(clientBinarySpy.size(), 1);
+    QCOMPARE(clientTextSpy.at(0).at(0).toString(), text);
+    QCOMPARE(clientBinarySpy.at(0).at(0).toByteArray(), binary);
+    QCOMPARE(clientTextSpy.at(1).at(0).toString(), QStringLiteral("short"));
+    QCOMPARE(clientExtension.encodedCount.load(), 2);
+    QCOMPARE(serverExtension.decodedCount.load(), 2);
+    QCOMPARE(serverExtension.encodedCount.load(), 2);
+    QCOMPARE(clientExtension.decodedCount.load(), 2);
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_WASM)
+    // connections with extensions cannot be handed over, and stay open
+    qintptr descriptor = -1;
+    QVERIFY(serverSocket->saveState(&descriptor).isEmpty());
+    QCOMPARE(descriptor, qintptr(-1));
+    QCOMPARE(serverSocket->state(), QAbstractSocket::ConnectedState);
+    client.sendTextMessage(QStringLiteral("still open"));
+    QTRY_COMPARE(clientTextSpy.size(), 3);
+    QCOMPARE(clientTextSpy.at(2).at(0).toString(), QStringLiteral("still open"));
+#endif
+
+    // extensions the server does not support are not used
+    QWebSocket otherClient;
+    InvertingExtension otherExtension;
+    QWebSocketHandshakeOptions otherOptions;
+    otherOptions.setExtensions({ &otherExtension });
+    server.setSupportedExtensions({});
+    otherClient.open(url, otherOptions);
+    QTRY_COMPARE(serverConnectionSpy.size(), 2);
+    std::unique_ptr<QWebSocket> otherServerSocket(server.nextPendingConnection());
+    QVERIFY(otherServerSocket);
+    QTRY_COMPARE(otherClient.state(), QAbstractSocket::ConnectedState);
+    QSignalSpy otherServerTextSpy(otherServerSocket.get(), &QWebSocket::textMessageReceived);
+    otherClient.sendTextMessage(text);
+    QTRY_COMPARE(otherServerTextSpy.size(), 1);
+    QCOMPARE(otherServerTextSpy.at(0).at(0).toString(), text);
+    QCOMPARE(otherExtension.encodedCount.load(), 0);
+}
+
+void tst_QWebSocket::compressingExtensions_data()
+{
+    QTest::addColumn<QWebSocketExtension::Codec>("codec");
+
+    QTest::newRow("lz4") << QWebSocketExtension::Codec::Lz4;
+    QTest::newRow("zstd") << QWebSocketExtension::Codec::Zstd;
+}
+
+void tst_QWebSocket::compressingExtensions()
+{
+    QFETCH(QWebSocketExtension::Codec, codec);
+    if (!QWebSocketExtension::isCodecAvailable(codec))
+        QSKIP("This codec is not available in this build.");
+
+    std::unique_ptr<QWebSocketExtension> extension(QWebSocketExtension::createCodec(codec));
+    QVERIFY(extension);
+
+    const QByteArray message = QByteArray("compressible payload ").repeated(1000);
+    QByteArray encoded;
+    QVERIFY(extension->encode(message, &encoded));
+    QVERIFY(encoded.size() < message.size());
+    QByteArray decoded;
+    QVERIFY(extension->decode(encoded, message.size(), &decoded));
+    QCOMPARE(decoded, message);
+    // the decoded size is checked before decoding
+    QVERIFY(!extension->decode(encoded, message.size() - 1, &decoded));
+    // short messages are not worth encoding
+    QVERIFY(!extension->encode(QByteArray("short"), &encoded));
+
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setSupportedExtensions({ extension.get() });
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy serverConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocketHandshakeOptions options;
+    options.setExtensions({ extension.get() });
+    QWebSocket client;
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url, options);
+    QTRY_COMPARE(serverConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+    QSignalSpy serverBinarySpy(serverSocket.get(), &QWebSocket::binaryMessageReceived);
+    client.sendBinaryMessage(message);
+    QTRY_COMPARE(serverBinarySpy.size(), 1);
+    QCOMPARE(serverBinarySpy.at(0).at(0).toByteArray(), message);
+}
+
+void tst_QWebSocket::incomingRateLimits_data()
+{
+    QTest::addColumn<QWebSocket::RateLimitPolicy>("policy");
+
+    QTest::newRow("delay") << QWebSocket::DelayReading;
+    QTest::newRow("drop") << QWebSocket::DropExcess;
+    QTest::newRow("close") << QWebSocket::CloseConnection;
+}
+
+void tst_QWebSocket::incomingRateLimits()
+{
+    QFETCH(QWebSocket::RateLimitPolicy, policy);
+
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy serverConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocket client;
+    QUrl url(QStringLiteral("ws://127.0.0.1"));
+    url.setPort(server.serverPort());
+    client.open(url);
+    QTRY_COMPARE(serverConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    QCOMPARE(serverSocket->incomingMessageRateLimit(), 0);
+    QCOMPARE(serverSocket->incomingRateLimitPolicy(), QWebSocket::DelayReading);
+    serverSocket->setIncomingMessageRateLimit(2);
+    serverSocket->setIncomingControlFrameRateLimit(1);
+    serverSocket->setIncomingRateLimitPolicy(policy);
+    QCOMPARE(serverSocket->incomingMessageRateLimit(), 2);
+    QCOMPARE(serverSocket->incomingControlFrameRateLimit(), 1);
+    QCOMPARE(serverSocket->incomingRateLimitPolicy(), policy);
+    QSignalSpy messageSpy(serverSocket.get(), &QWebSocket::textMessageReceived);
+    QSignalSpy pongSpy(&client, &QWebSocket::pong);
+    QSignalSpy disconnectedSpy(&client, &QWebSocket::disconnected);
+
+    for (int i = 0; i < 4; ++i)
+        client.sendTextMessage(QString::number(i));
+    client.ping();
+    client.ping();
+
+    switch (policy) {
+    case QWebSocket::DelayReading:
+        // a burst of two messages, then two more per second
+        QTRY_COMPARE_WITH_TIMEOUT(messageSpy.size(), 4, 10000);
+        QCOMPARE(messageSpy.at(3).at(0).toString(), QStringLiteral("3"));
+        QTRY_COMPARE_WITH_TIMEOUT(pongSpy.size(), 2, 10000);
+        QVERIFY(serverSocket->incomingRateLimitHits() > 0);
+        break;
+    case QWebSocket::DropExcess:
+        QTRY_COMPARE(pongSpy.size(), 1);
+        QTest::qWait(100);
+        QCOMPARE(messageSpy.size(), 2);
+        QCOMPARE(pongSpy.size(), 1);
+        QCOMPARE(serverSocket->incomingRateLimitHits(), quint64(3));
+        QCOMPARE(client.state(), QAbstractSocket::ConnectedState);
+        break;
+    case QWebSocket::CloseConnection:
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+        QCOMPARE(client.closeCode(), QWebSocketProtocol::CloseCodePolicyViolated);
+        QCOMPARE(messageSpy.size(), 2);
+        QCOMPARE(serverSocket->incomingRateLimitHits(), quint64(1));
+        break;
+    }
+}
+
+void tst_QWebSocket::messagePipelining_data()
+{
+    QTest::addColumn<bool>("pipelining");
+    QTest::addColumn<bool>("accepted");
+    QTest::addColumn<bool>("authenticationRequired");
+
+    QTest::newRow("not pipelined") << false << true << false;
+    QTest::newRow("pipelined") << true << true << false;
+    QTest::newRow("pipelined, rejected") << true << false << false;
+    QTest::newRow("pipelined, authentication required") << true << true << true;
+}
+
+void tst_QWebSocket::messagePipelining()
+{
+    QFETCH(bool, pipelining);
+    QFETCH(bool, accepted);
+    QFETCH(bool, authenticationRequired);
+
+    if (authenticationRequired) {
+        // the handshake fails, even with the right credentials, since the
+        // pipelined messages cannot be sent again with the second request
+        AuthServer authServer;
+        QVERIFY(authServer.listen(QHostAddress::LocalHost));
+        QUrl url(QStringLiteral("ws://127.0.0.1"));
+        url.setPort(authServer.serverPort());
+        url.setUserName(QString::fromUtf8(AuthServer::user.toByteArray()));
+        url.setPassword(QString::fromUtf8(AuthServer::password.toByteArray()));
+        QWebSocket client;
+        QSignalSpy errorSpy(&client, &QWebSocket::errorOccurred);
+        QSignalSpy connectedSpy(&client, &QWebSocket::connected);
+        QSignalSpy disconnectedSpy(&client, &QWebSocket::disconnected);
+        QWebSocketHandshakeOptions options;
+        options.setMessagePipeliningEnabled(true);
+        client.open(url, options);
+        QCOMPARE(client.sendTextMessage(QStringLiteral("first")), qint64(5));
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+        QCOMPARE(errorSpy.size(), 1);
+        QVERIFY(client.errorString().contains(QStringLiteral("authentication")));
+        QCOMPARE(connectedSpy.size(), 0);
+        QCOMPARE(client.bytesToWrite(), qint64(0));
+        return;
+    }
+
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    connect(&server, &QWebSocketServer::originAuthenticationRequired, this,
+            [accepted](QWebSocketCorsAuthenticator *authenticator) {
+        authenticator->setAllowed(accepted);
+    });
+    // the pipelined messages are received as soon as the server hands out
+    // the connection
+    std::unique_ptr<QWebSocket> serverSocket;
+    QStringList received;
+    connect(&server, &QWebSocketServer::newConnection, this, [&]() {
+        serverSocket.reset(server.nextPendingConnection());
+        connect(serverSocket.get(), &QWebSocket::textMessageReceived, this,
+                [&received](const QString &message) { received.append(message); });
+    });
+
+    QWebSocket client;
+    QSignalSpy errorSpy(&client, &QWebSocket::errorOccurred);
+    QSignalSpy disconnectedSpy(&client, &QWebSocket::disconnected);
+    QWebSocketHandshakeOptions options;
+    QVERIFY(!options.isMessagePipeliningEnabled());
+    options.setMessagePipeliningEnabled(pipelining);
+    QCOMPARE(options.isMessagePipeliningEnabled(), pipelining);
+    client.open(server.serverUrl(), options);
+    QCOMPARE(client.state(), QAbstractSocket::ConnectingState);
+    QCOMPARE(client.sendTextMessage(QStringLiteral("first")), pipelining ? qint64(5) : qint64(0));
+    QCOMPARE(client.sendTextMessage(QStringLiteral("second")), pipelining ? qint64(6) : qint64(0));
+
+    if (!accepted) {
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+        QVERIFY(!errorSpy.isEmpty());
+        QVERIFY(!serverSocket);
+        QCOMPARE(client.bytesToWrite(), qint64(0));
+        return;
+    }
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+    QTRY_VERIFY(serverSocket);
+    client.sendTextMessage(QStringLiteral("third"));
+    if (pipelining) {
+        QTRY_COMPARE(received, QStringList({ QStringLiteral("first"), QStringLiteral("second"),
+                                             QStringLiteral("third") }));
+    } else {
+        QTRY_COMPARE(received, QStringList({ QStringLiteral("third") }));
+    }
+}
+
 QTEST_MAIN(tst_QWebSocket)
 
 #include "tst_qwebsocket.moc"
@@ -16,8 +16,17 @@
 #include <QtWebSockets/QWebSocketServer>
 #include <QtWebSockets/QWebSocket>
 #include <QtWebSockets/QWebSocketCorsAuthenticator>
+#include <QtWebSockets/QWebSocketExtension>
+#include <QtWebSockets/QWebSocketPendingHandshake>
+#include <QtWebSockets/QWebSocketClientContext>
 #include <QtWebSockets/qwebsocketprotocol.h>
 
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "../shared/invertingextension.h"
+
 QT_USE_NAMESPACE
 
 Q_DECLARE_METATYPE(QWebSocketProtocol::Version)
@@ -95,6 +104,18 @@ private Q_SLOTS:
     void tst_handleConnection();
     void tst_handshakeTimeout(); // qtbug-63312, qtbug-57026
     void multipleFrames();
+    void drain();
+    void memoryBudgetRejectsLargeMessages();
+    void memoryBudgetClosesLargestConsumers();
+    void memoryBudgetPausesReading();
+    void memoryBudgetClosesPausedConnections();
+    void broadcast();
+    void deferredHandshake();
+    void admissionControl();
+    void trimMemory();
+    void trimMemoryWithIncompleteFrame();
+    void socketPool();
+    void clientContext();
 
 private:
     bool m_shouldSkipUnsupportedIpv6Test;
@@ -888,6 +909,550 @@ void tst_QWebSocketServer::multipleFrames()
     QVERIFY2(messageReceivedSpy.size() > 1, "Received only 1 message in the TCP frame!");
 }
 
+void tst_QWebSocketServer::drain()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QSignalSpy drainProgressSpy(&server, &QWebSocketServer::drainProgress);
+    QSignalSpy drainedSpy(&server, &QWebSocketServer::drained);
+    QVERIFY(server.listen());
+
+    constexpr int numConnections = 10;
+    QList<QWebSocketProtocol::CloseCode> closeCodes;
+    std::vector<std::unique_ptr<QWebSocket>> clients;
+    for (int i = 0; i < numConnections; ++i) {
+        clients.push_back(std::make_unique<QWebSocket>());
+        QWebSocket *client = clients.back().get();
+        connect(client, &QWebSocket::disconnected, this, [client, &closeCodes]() {
+            closeCodes << client->closeCode();
+        });
+        client->open(server.serverUrl());
+    }
+    QTRY_VERIFY(std::all_of(clients.cbegin(), clients.cend(),
+                            [](const std::unique_ptr<QWebSocket> &client) {
+        return client->state() == QAbstractSocket::ConnectedState;
+    }));
+    // connections are drained whether they have been taken from the server or not
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+
+    QElapsedTimer timer;
+    timer.start();
+    server.drain(std::chrono::seconds(5), 100, QWebSocketProtocol::CloseCodeGoingAway,
+                 QStringLiteral("Restarting"));
+    QVERIFY(server.isDraining());
+    QVERIFY(!server.isListening());
+
+    QTRY_COMPARE(drainedSpy.size(), 1);
+    // the first connection is closed right away, the others at 100 per second
+    QVERIFY(timer.elapsed() >= (numConnections - 1) * 1000 / 100);
+    QVERIFY(!server.isDraining());
+    QVERIFY(!drainProgressSpy.isEmpty());
+    QCOMPARE(drainProgressSpy.last().at(0).toInt(), 0);
+
+    QTRY_COMPARE(closeCodes.size(), numConnections);
+    for (QWebSocketProtocol::CloseCode closeCode : std::as_const(closeCodes))
+        QCOMPARE(closeCode, QWebSocketProtocol::CloseCodeGoingAway);
+    QCOMPARE(serverSocket->state(), QAbstractSocket::UnconnectedState);
+}
+
+void tst_QWebSocketServer::memoryBudgetRejectsLargeMessages()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QSignalSpy exceededSpy(&server, &QWebSocketServer::memoryBudgetExceeded);
+    server.setMemoryBudget(100000);
+    QCOMPARE(server.memoryBudget(), qint64(100000));
+    QCOMPARE(server.memoryBudgetPolicy(), QWebSocketServer::RejectLargeMessages);
+    QCOMPARE(server.bufferedBytes(), qint64(0));
+    QVERIFY(server.listen());
+
+    QWebSocket client;
+    client.setOutgoingFrameSize(1000);
+    QSignalSpy disconnectedSpy(&client, &QWebSocket::disconnected);
+    client.open(server.serverUrl());
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QSignalSpy messageSpy(serverSocket.get(), &QWebSocket::binaryMessageReceived);
+
+    // a message that fits is received
+    client.sendBinaryMessage(QByteArray(50000, 'a'));
+    QTRY_COMPARE(messageSpy.size(), 1);
+    QTRY_COMPARE(server.bufferedBytes(), qint64(0));
+    QCOMPARE(exceededSpy.size(), 0);
+
+    // one that does not is rejected once the budget is exceeded
+    client.sendBinaryMessage(QByteArray(1000000, 'a'));
+    QTRY_COMPARE(disconnectedSpy.size(), 1);
+    QCOMPARE(client.closeCode(), QWebSocketProtocol::CloseCodeTooMuchData);
+    QCOMPARE(messageSpy.size(), 1);
+    QVERIFY(exceededSpy.size() >= 1);
+    QVERIFY(exceededSpy.first().at(0).toLongLong() > 100000);
+}
+
+void tst_QWebSocketServer::memoryBudgetClosesLargestConsumers()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setMemoryBudget(1024 * 1024);
+    server.setMemoryBudgetPolicy(QWebSocketServer::CloseLargestConsumers);
+    QVERIFY(server.listen());
+
+    QWebSocket largeClient;
+    QWebSocket smallClient;
+    QSignalSpy largeDisconnectedSpy(&largeClient, &QWebSocket::disconnected);
+    QSignalSpy smallMessageSpy(&smallClient, &QWebSocket::textMessageReceived);
+    largeClient.open(server.serverUrl());
+    QTRY_COMPARE(largeClient.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> largeSocket(server.nextPendingConnection());
+    QVERIFY(largeSocket);
+    smallClient.open(server.serverUrl());
+    QTRY_COMPARE(smallClient.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> smallSocket(server.nextPendingConnection());
+    QVERIFY(smallSocket);
+
+    // queued messages count right away
+    largeSocket->sendBinaryMessage(QByteArray(4 * 1024 * 1024, 'a'));
+    QVERIFY(server.bufferedBytes() > server.memoryBudget());
+    smallSocket->sendTextMessage(QStringLiteral("small"));
+
+    QTRY_COMPARE(largeDisconnectedSpy.size(), 1);
+    QCOMPARE(largeClient.closeCode(), QWebSocketProtocol::CloseCodeTooMuchData);
+    QTRY_COMPARE(smallMessageSpy.size(), 1);
+    QCOMPARE(smallClient.state(), QAbstractSocket::ConnectedState);
+    QTRY_VERIFY(server.bufferedBytes() <= server.memoryBudget());
+}
+
+void tst_QWebSocketServer::memoryBudgetPausesReading()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setMemoryBudget(1024 * 1024);
+    server.setMemoryBudgetPolicy(QWebSocketServer::PauseReading);
+    QVERIFY(server.listen());
+
+    QWebSocket receivingClient;
+    QWebSocket sendingClient;
+    QSignalSpy receivedSpy(&receivingClient, &QWebSocket::binaryMessageReceived);
+    receivingClient.open(server.serverUrl());
+    QTRY_COMPARE(receivingClient.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> receivingSocket(server.nextPendingConnection());
+    QVERIFY(receivingSocket);
+    sendingClient.open(server.serverUrl());
+    QTRY_COMPARE(sendingClient.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> sendingSocket(server.nextPendingConnection());
+    QVERIFY(sendingSocket);
+    QSignalSpy messageSpy(sendingSocket.get(), &QWebSocket::textMessageReceived);
+    qint64 bufferedBytesOnArrival = -1;
+    connect(sendingSocket.get(), &QWebSocket::textMessageReceived, this,
+            [&]() { bufferedBytesOnArrival = server.bufferedBytes(); });
+
+    const QByteArray payload(4 * 1024 * 1024, 'a');
+    receivingSocket->sendBinaryMessage(payload);
+    QVERIFY(server.bufferedBytes() > server.memoryBudget());
+    sendingClient.sendTextMessage(QStringLiteral("paused"));
+    while (server.bufferedBytes() > server.memoryBudget() && receivedSpy.isEmpty()) {
+        QVERIFY(messageSpy.isEmpty());
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+    }
+
+    // reading resumes once the large message has been written
+    QTRY_COMPARE(receivedSpy.size(), 1);
+    QCOMPARE(receivedSpy.first().at(0).toByteArray(), payload);
+    QTRY_COMPARE(messageSpy.size(), 1);
+    QCOMPARE(messageSpy.first().at(0).toString(), QStringLiteral("paused"));
+    QVERIFY(bufferedBytesOnArrival >= 0);
+    QVERIFY(bufferedBytesOnArrival <= server.memoryBudget());
+    QCOMPARE(sendingSocket->state(), QAbstractSocket::ConnectedState);
+}
+
+void tst_QWebSocketServer::memoryBudgetClosesPausedConnections()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setMemoryBudget(1024 * 1024);
+    server.setMemoryBudgetPolicy(QWebSocketServer::PauseReading);
+    QVERIFY(server.listen());
+
+    QWebSocket client;
+    // the server pauses in the middle of the message, which then holds the
+    // memory until the connection is closed
+    client.setOutgoingFrameSize(64 * 1024);
+    client.open(server.serverUrl());
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QSignalSpy messageSpy(serverSocket.get(), &QWebSocket::binaryMessageReceived);
+
+    client.sendBinaryMessage(QByteArray(4 * 1024 * 1024, 'a'));
+    QTRY_VERIFY(server.bufferedBytes() > server.memoryBudget());
+
+    // the connection is closed once the grace period is over
+    QTRY_COMPARE_WITH_TIMEOUT(serverSocket->state(), QAbstractSocket::UnconnectedState, 10000);
+    QCOMPARE(serverSocket->closeCode(), QWebSocketProtocol::CloseCodeTooMuchData);
+    QVERIFY(messageSpy.isEmpty());
+    QTRY_VERIFY(server.bufferedBytes() <= server.memoryBudget());
+}
+
+void tst_QWebSocketServer::broadcast()
+{
+    InvertingExtension serverExtension;
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    server.setSupportedExtensions({ &serverExtension });
+    QVERIFY(server.listen());
+
+    InvertingExtension clientExtension;
+    QWebSocketHandshakeOptions options;
+    options.setExtensions({ &clientExtension });
+
+    // three clients negotiate the extension, the last one does not
+    std::vector<std::unique_ptr<QWebSocket>> clients;
+    std::vector<std::unique_ptr<QSignalSpy>> spies;
+    QList<QWebSocket *> recipients;
+    for (int i = 0; i < 4; ++i) {
+        clients.push_back(std::make_unique<QWebSocket>());
+        QWebSocket *client = clients.back().get();
+        spies.push_back(std::make_unique<QSignalSpy>(client, &QWebSocket::textMessageReceived));
+        if (i < 3)
+            client->open(server.serverUrl(), options);
+        else
+            client->open(server.serverUrl());
+        QTRY_COMPARE(client->state(), QAbstractSocket::ConnectedState);
+        QWebSocket *recipient = server.nextPendingConnection();
+        QVERIFY(recipient);
+        recipient->setParent(&server);
+        recipients.append(recipient);
+    }
+    // disconnected and null recipients are skipped
+    QWebSocket unconnected;
+    recipients << &unconnected << nullptr;
+
+    const QString message = QStringLiteral("broadcast \u20ac");
+    QCOMPARE(server.broadcastTextMessage(message, recipients), qsizetype(4));
+    for (const auto &spy : spies) {
+        QTRY_COMPARE(spy->size(), 1);
+        QCOMPARE(spy->first().at(0).toString(), message);
+    }
+    // encoded once for all recipients that negotiated the extension
+    QCOMPARE(serverExtension.encodedCount.load(), 1);
+
+    QSignalSpy binarySpy(clients.front().get(), &QWebSocket::binaryMessageReceived);
+    const QByteArray data("\x01\x02\x03");
+    QCOMPARE(server.broadcastBinaryMessage(data, { recipients.first() }), qsizetype(1));
+    QTRY_COMPARE(binarySpy.size(), 1);
+    QCOMPARE(binarySpy.first().at(0).toByteArray(), data);
+    QCOMPARE(serverExtension.encodedCount.load(), 2);
+}
+
+void tst_QWebSocketServer::deferredHandshake()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(!server.isHandshakeDeferred());
+    server.setHandshakeDeferred(true);
+    QVERIFY(server.isHandshakeDeferred());
+    QVERIFY(server.listen());
+    QList<QPointer<QWebSocketPendingHandshake>> handshakes;
+    connect(&server, &QWebSocketServer::handshakeRequested, this,
+            [&handshakes](QWebSocketPendingHandshake *handshake) {
+        handshakes.append(handshake);
+    });
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+
+    QWebSocket acceptedClient;
+    QNetworkRequest request(server.serverUrl());
+    request.setRawHeader("X-Token", "valid");
+    acceptedClient.open(request);
+    QWebSocket rejectedClient;
+    QSignalSpy rejectedErrorSpy(&rejectedClient, &QWebSocket::errorOccurred);
+    rejectedClient.open(server.serverUrl());
+    QTRY_COMPARE(handshakes.size(), 2);
+
+    // both handshakes wait for an answer
+    QTest::qWait(50);
+    QCOMPARE(newConnectionSpy.size(), 0);
+    QCOMPARE(acceptedClient.state(), QAbstractSocket::ConnectingState);
+
+    QPointer<QWebSocketPendingHandshake> accepted = handshakes.at(0);
+    QPointer<QWebSocketPendingHandshake> rejected = handshakes.at(1);
+    if (rejected->headers().contains("X-Token"))
+        std::swap(accepted, rejected);
+    QVERIFY(accepted->isPending());
+    QCOMPARE(accepted->headers().value("X-Token"), QByteArrayView("valid"));
+    QCOMPARE(accepted->requestUrl().port(), int(server.serverPort()));
+    QVERIFY(accepted->peerAddress().isLoopback());
+
+    QHttpHeaders responseHeaders;
+    responseHeaders.append("X-Session", "42");
+    accepted->accept(responseHeaders);
+    QVERIFY(!accepted->isPending());
+    QTRY_COMPARE(acceptedClient.state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QTRY_VERIFY(!accepted);
+
+    rejected->reject();
+    QTRY_COMPARE(rejectedErrorSpy.size(), 1);
+    QTRY_COMPARE(rejectedClient.state(), QAbstractSocket::UnconnectedState);
+    QCOMPARE(newConnectionSpy.size(), 1);
+
+    // a handshake that is not answered in time is aborted
+    server.setHandshakeTimeout(100);
+    QWebSocket abortedClient;
+    abortedClient.open(server.serverUrl());
+    QTRY_COMPARE(handshakes.size(), 3);
+    QPointer<QWebSocketPendingHandshake> aborted = handshakes.at(2);
+    QSignalSpy abortedSpy(aborted.get(), &QWebSocketPendingHandshake::aborted);
+    QTRY_COMPARE(abortedSpy.size(), 1);
+    QTRY_VERIFY(!aborted);
+    QTRY_COMPARE(abortedClient.state(), QAbstractSocket::UnconnectedState);
+}
+
+void tst_QWebSocketServer::admissionControl()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QCOMPARE(server.maxConnectionsPerAddress(), 0);
+    QCOMPARE(server.handshakeRateLimit(), 0);
+    QCOMPARE(server.handshakeRateLimitPerAddress(), 0);
+    server.setMaxConnectionsPerAddress(1);
+    QCOMPARE(server.maxConnectionsPerAddress(), 1);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+
+    QWebSocket firstClient;
+    firstClient.open(server.serverUrl());
+    QTRY_COMPARE(firstClient.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+
+    // a second connection from the same address is refused before its handshake
+    QTcpSocket rawClient;
+    rawClient.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QTRY_COMPARE(rawClient.state(), QAbstractSocket::UnconnectedState);
+    const QByteArray response = rawClient.readAll();
+    QVERIFY(response.startsWith("HTTP/1.1 503"));
+    QVERIFY(response.contains("Retry-After: 1"));
+    QCOMPARE(newConnectionSpy.size(), 1);
+
+    // once the first connection is gone, its slot is released
+    serverSocket.reset();
+    QWebSocket secondClient;
+    secondClient.open(server.serverUrl());
+    QTRY_COMPARE(secondClient.state(), QAbstractSocket::ConnectedState);
+    QTRY_COMPARE(newConnectionSpy.size(), 2);
+}
+
+void tst_QWebSocketServer::trimMemory()
+{
+    using namespace std::chrono_literals;
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QCOMPARE(server.idleTrimInterval(), 0ms);
+    server.setIdleTrimInterval(1h);
+    QCOMPARE(server.idleTrimInterval(), 1h);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    QWebSocket client;
+    QSignalSpy messageSpy(&client, &QWebSocket::binaryMessageReceived);
+    client.open(server.serverUrl());
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QCOMPARE(serverSocket->idleTrimInterval(), 1h);
+    QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+    for (int i = 0; i < 100; ++i)
+        serverSocket->sendBinaryMessage(QByteArray(1024, 'x'));
+    QTRY_COMPARE(messageSpy.size(), 100);
+    QTRY_COMPARE(serverSocket->bytesToWrite(), 0);
+
+    // what the burst left behind is freed once
+    QCOMPARE(server.trimmedBytes(), qint64(0));
+    QVERIFY(server.trimMemory() > 0);
+    QVERIFY(server.trimmedBytes() > 0);
+    QCOMPARE(serverSocket->trimMemory(), qint64(0));
+
+    // the read buffer is kept while data arrives, until it is trimmed
+    QSignalSpy serverMessageSpy(serverSocket.get(), &QWebSocket::binaryMessageReceived);
+    for (int i = 0; i < 100; ++i)
+        client.sendBinaryMessage(QByteArray(1024, 'z'));
+    QTRY_COMPARE(serverMessageSpy.size(), 100);
+    QVERIFY(serverSocket->trimMemory() > 0);
+    QCOMPARE(serverSocket->trimMemory(), qint64(0));
+
+    serverSocket->sendBinaryMessage(QByteArray(1024, 'y'));
+    QTRY_COMPARE(messageSpy.size(), 101);
+    QCOMPARE(messageSpy.last().at(0).toByteArray(), QByteArray(1024, 'y'));
+
+    // idle connections trim themselves
+    const qint64 trimmedBytes = server.trimmedBytes();
+    serverSocket->setIdleTrimInterval(50ms);
+    QCOMPARE(serverSocket->idleTrimInterval(), 50ms);
+    QTRY_VERIFY(server.trimmedBytes() > trimmedBytes);
+}
+
+void tst_QWebSocketServer::trimMemoryWithIncompleteFrame()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    // a plain socket as the client, to send a frame in two parts
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    QVERIFY(client.waitForConnected());
+    client.write("GET / HTTP/1.1\r\n"
+                 "Host: 127.0.0.1\r\n"
+                 "Upgrade: websocket\r\n"
+                 "Connection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                 "Sec-WebSocket-Version: 13\r\n"
+                 "\r\n");
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+    QVERIFY(serverSocket);
+    QSignalSpy messageSpy(serverSocket.get(), &QWebSocket::textMessageReceived);
+    QTRY_VERIFY(client.readAll().startsWith("HTTP/1.1 101"));
+    serverSocket->trimMemory();
+
+    // a masked text frame with a masking key of 0, so the payload is as is
+    const QByteArray payload(1000, 'x');
+    QByteArray frame("\x81\xFE", 2);
+    frame.append(char(payload.size() >> 8));
+    frame.append(char(payload.size() & 0xFF));
+    frame.append(4, '\0');
+    frame.append(payload);
+    client.write(frame.first(500));
+    // once the start of the frame has been read, trimming frees the read
+    // buffer, which it otherwise keeps until the frame is complete
+    QTRY_VERIFY(serverSocket->trimMemory() > 0);
+    QCOMPARE(serverSocket->trimMemory(), qint64(0));
+    QCOMPARE(messageSpy.size(), 0);
+
+    // the frame is completed from the socket, and the frames after it are
+    // read from the socket directly
+    client.write(frame.sliced(500));
+    client.write(QByteArray("\x81\x82\0\0\0\0ok", 8));
+    QTRY_COMPARE(messageSpy.size(), 2);
+    QCOMPARE(messageSpy.at(0).at(0).toString(), QString::fromLatin1(payload));
+    QCOMPARE(messageSpy.at(1).at(0).toString(), QStringLiteral("ok"));
+}
+
+void tst_QWebSocketServer::socketPool()
+{
+    QWebSocketServer server(QString(), QWebSocketServer::NonSecureMode);
+    QCOMPARE(server.socketPoolSize(), 0);
+    server.setSocketPoolSize(4);
+    QCOMPARE(server.socketPoolSize(), 4);
+    // a recycled socket has to give its address back to the admission control
+    server.setMaxConnectionsPerAddress(1);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+
+    std::vector<std::unique_ptr<QWebSocket>> serverSockets;
+    for (int i = 0; i < 5; ++i) {
+        QWebSocket client;
+        QSignalSpy messageSpy(&client, &QWebSocket::textMessageReceived);
+        client.open(server.serverUrl());
+        QTRY_COMPARE(newConnectionSpy.size(), i + 1);
+        serverSockets.emplace_back(server.nextPendingConnection());
+        QWebSocket *serverSocket = serverSockets.back().get();
+        QVERIFY(serverSocket);
+        QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+
+        serverSocket->sendTextMessage(QString::number(i));
+        QTRY_COMPARE(messageSpy.size(), 1);
+        QCOMPARE(messageSpy.at(0).at(0).toString(), QString::number(i));
+
+        QSignalSpy disconnectedSpy(serverSocket, &QWebSocket::disconnected);
+        client.close();
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+    }
+
+    // the connections whose socket has been reused stay closed
+    QCoreApplication::processEvents();
+    for (const auto &serverSocket : serverSockets) {
+        QCOMPARE(serverSocket->state(), QAbstractSocket::UnconnectedState);
+        QCOMPARE(serverSocket->sendTextMessage(QStringLiteral("closed")), qint64(0));
+    }
+}
+
+void tst_QWebSocketServer::clientContext()
+{
+#ifdef QT_NO_SSL
+    QSKIP("SSL is not supported");
+#else
+    if (!QSslSocket::supportsSsl())
+        QSKIP("SSL is not supported");
+    using namespace std::chrono_literals;
+    QWebSocketServer server(QString(), QWebSocketServer::SecureMode);
+    setupSecureServer(&server);
+    if (QTest::currentTestFailed())
+        return;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(&server, &QWebSocketServer::newConnection);
+    // a host name, so that there is an address to cache
+    QUrl url = server.serverUrl();
+    url.setHost(QStringLiteral("localhost"));
+
+    // the clients verify the server, so that its sessions are kept
+    const QList<QSslCertificate> certificates =
+            QSslCertificate::fromPath(QStringLiteral(":/localhost.cert"));
+    QVERIFY(!certificates.isEmpty());
+    QSslConfiguration trustingConfiguration = QSslConfiguration::defaultConfiguration();
+    trustingConfiguration.setCaCertificates(certificates);
+
+    QWebSocketClientContext context;
+    QCOMPARE(context.addressCacheTimeout(), 1min);
+    const auto connectClient = [&](bool ignoreSslErrors) {
+        QWebSocket client;
+        QVERIFY(!client.clientContext());
+        client.setClientContext(&context);
+        QCOMPARE(client.clientContext(), &context);
+        if (ignoreSslErrors)
+            client.ignoreSslErrors();
+        else
+            client.setSslConfiguration(trustingConfiguration);
+        QSignalSpy sslErrorsSpy(&client, &QWebSocket::sslErrors);
+        const qsizetype connectionCount = newConnectionSpy.size();
+        client.open(url);
+        QTRY_COMPARE(newConnectionSpy.size(), connectionCount + 1);
+        std::unique_ptr<QWebSocket> serverSocket(server.nextPendingConnection());
+        QVERIFY(serverSocket);
+        QTRY_COMPARE(client.state(), QAbstractSocket::ConnectedState);
+        if (!ignoreSslErrors)
+            QVERIFY(sslErrorsSpy.isEmpty());
+        QSignalSpy disconnectedSpy(serverSocket.get(), &QWebSocket::disconnected);
+        client.close();
+        QTRY_COMPARE(disconnectedSpy.size(), 1);
+    };
+    for (int i = 0; i < 3; ++i) {
+        connectClient(false);
+        if (QTest::currentTestFailed())
+            return;
+    }
+
+    QCOMPARE(context.connectionCount(), quint64(3));
+    QCOMPARE(context.secureConnectionCount(), quint64(3));
+    QCOMPARE(context.addressCacheHits(), quint64(2));
+    // the later connections offer the session of the previous one, where
+    // the TLS backend supports session tickets
+    if (QSslSocket::activeBackend() == QStringLiteral("openssl"))
+        QVERIFY(context.sessionResumptionCount() > 0);
+    QVERIFY(context.sessionResumptionCount() <= 2);
+    QCOMPARE(context.sessionResumptionRate(), qreal(context.sessionResumptionCount()) / 3);
+
+    // nothing is cached after clear(), and a connection that ignored the
+    // SSL errors keeps no session for the next one
+    context.clear();
+    const quint64 sessionResumptionCount = context.sessionResumptionCount();
+    connectClient(true);
+    if (QTest::currentTestFailed())
+        return;
+    connectClient(false);
+    if (QTest::currentTestFailed())
+        return;
+    QCOMPARE(context.connectionCount(), quint64(5));
+    QCOMPARE(context.addressCacheHits(), quint64(3));
+    QCOMPARE(context.sessionResumptionCount(), sessionResumptionCount);
+#endif
+}
+
 QTEST_MAIN(tst_QWebSocketServer)
 
 #include "tst_qwebsocketserver.moc"
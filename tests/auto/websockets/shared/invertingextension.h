@@ -0,0 +1,54 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+#ifndef INVERTINGEXTENSION_H
+#define INVERTINGEXTENSION_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+#include <QtWebSockets/QWebSocketExtension>
+
+#include <atomic>
+
+// Flips all bits of messages that are longer than minimumSize, and counts the
+// messages it encoded and decoded
+class InvertingExtension : public QWebSocketExtension
+{
+public:
+    explicit InvertingExtension(qsizetype minimumSize = 0) : m_minimumSize(minimumSize) {}
+
+    QString name() const override { return QStringLiteral("x-test-invert"); }
+    ReservedBits reservedBits() const override { return Rsv1; }
+    bool encode(const QByteArray &payload, QByteArray *encoded) const override
+    {
+        if (payload.size() <= m_minimumSize)
+            return false;
+        *encoded = invert(payload);
+        ++encodedCount;
+        return true;
+    }
+    bool decode(const QByteArray &payload, qint64 maxSize, QByteArray *decoded) const override
+    {
+        if (payload.size() > maxSize)
+            return false;
+        *decoded = invert(payload);
+        ++decodedCount;
+        return true;
+    }
+
+    mutable std::atomic<int> encodedCount = 0;
+    mutable std::atomic<int> decodedCount = 0;
+
+private:
+    static QByteArray invert(const QByteArray &payload)
+    {
+        QByteArray result(payload.size(), Qt::Uninitialized);
+        for (qsizetype i = 0; i < payload.size(); ++i)
+            result[i] = char(~payload.at(i));
+        return result;
+    }
+
+    qsizetype m_minimumSize;
+};
+
+#endif // INVERTINGEXTENSION_H
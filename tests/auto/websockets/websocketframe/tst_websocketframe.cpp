@@ -128,6 +128,9 @@ private Q_SLOTS:
 
     void tst_malformedFrames_data();
     void tst_malformedFrames();
+
+    void tst_writeFrame_data();
+    void tst_writeFrame();
 };
 
 tst_WebSocketFrame::tst_WebSocketFrame()
@@ -588,6 +591,62 @@ void tst_WebSocketFrame::tst_malformedFrames()
     QCOMPARE(frame.closeCode(), expectedError);
 }
 
+void tst_WebSocketFrame::tst_writeFrame_data()
+{
+    QTest::addColumn<QWebSocketProtocol::OpCode>("opCode");
+    QTest::addColumn<bool>("isFinal");
+    QTest::addColumn<quint32>("mask");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<bool>("contiguous");
+
+    QTest::newRow("Empty final text frame")
+            << QWebSocketProtocol::OpCodeText << true << 0U << 0 << false;
+    QTest::newRow("Masked ping frame")
+            << QWebSocketProtocol::OpCodePing << true << 0x12345678U << 125 << false;
+    QTest::newRow("Binary frame with 16-bit length")
+            << QWebSocketProtocol::OpCodeBinary << true << 0U << 126 << false;
+    QTest::newRow("Masked binary frame with 16-bit length")
+            << QWebSocketProtocol::OpCodeBinary << false << 0xCAFEBABEU << 0xFFFF << false;
+    QTest::newRow("Continuation frame with 64-bit length")
+            << QWebSocketProtocol::OpCodeContinue << true << 0U << 0x10000 << false;
+    QTest::newRow("Masked continuation frame with 64-bit length")
+            << QWebSocketProtocol::OpCodeContinue << false << 0x01020304U << 0x10000 << false;
+    QTest::newRow("Contiguous binary frame with 64-bit length")
+            << QWebSocketProtocol::OpCodeBinary << true << 0U << 0x10000 << true;
+}
+
+void tst_WebSocketFrame::tst_writeFrame()
+{
+    QFETCH(QWebSocketProtocol::OpCode, opCode);
+    QFETCH(bool, isFinal);
+    QFETCH(quint32, mask);
+    QFETCH(int, payloadSize);
+    QFETCH(bool, contiguous);
+
+    QByteArray payload(payloadSize, Qt::Uninitialized);
+    for (int i = 0; i < payloadSize; ++i)
+        payload[i] = char(i % 251);
+    const QByteArray original = payload;
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    QCOMPARE(QWebSocketFrame::writeFrame(&buffer, opCode, payload, mask, isFinal, contiguous),
+             qint64(payloadSize));
+    // the payload of the caller must not be masked in place
+    QCOMPARE(payload, original);
+
+    buffer.seek(0);
+    QWebSocketFrame frame;
+    frame.readFrame(&buffer);
+    QVERIFY(frame.isValid());
+    QCOMPARE(frame.opCode(), opCode);
+    QCOMPARE(frame.isFinalFrame(), isFinal);
+    QCOMPARE(frame.hasMask(), mask != 0);
+    QCOMPARE(frame.mask(), mask);
+    QCOMPARE(frame.payload(), original);
+    QCOMPARE(buffer.bytesAvailable(), 0);
+}
+
 QTEST_MAIN(tst_WebSocketFrame)
 
 #include "tst_websocketframe.moc"
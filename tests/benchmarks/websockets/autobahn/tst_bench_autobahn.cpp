@@ -0,0 +1,342 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QtEndian>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+
+#include <algorithm>
+#include <memory>
+
+QT_USE_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+// The performance cases of the Autobahn testsuite (category 9), run against
+// an in-process peer instead of the external fuzzing client and server.
+// The peer speaks the protocol on a plain QTcpSocket, so that only the side
+// under test, which echoes every message, uses QtWebSockets.
+class tst_BenchAutobahn : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void echo_data();
+    void echo();
+};
+
+namespace {
+
+constexpr quint32 PeerMaskingKey = 0x5A6B7C8DU;
+
+// Encodes a message the way the fuzzing peer sends it: in frames of at most
+// frameSize bytes (0 means one frame), masked when the peer is a client.
+QByteArray encodeMessage(bool isText, const QByteArray &payload, qsizetype frameSize, bool mask)
+{
+    if (frameSize <= 0)
+        frameSize = qMax(payload.size(), qsizetype(1));
+    QByteArray wireData;
+    wireData.reserve(payload.size() + (payload.size() / frameSize + 1) * 14);
+    qsizetype offset = 0;
+    do {
+        const qsizetype size = qMin(frameSize, payload.size() - offset);
+        const bool isLastFrame = offset + size == payload.size();
+        const char opCode = offset == 0 ? (isText ? 0x1 : 0x2) : 0x0;
+        wireData.append(char((isLastFrame ? 0x80 : 0x00) | opCode));
+        const char maskBit = mask ? char(0x80) : char(0x00);
+        char length[8];
+        if (size <= 125) {
+            wireData.append(char(maskBit | size));
+        } else if (size <= 0xFFFF) {
+            wireData.append(char(maskBit | 126));
+            qToBigEndian<quint16>(quint16(size), length);
+            wireData.append(length, 2);
+        } else {
+            wireData.append(char(maskBit | 127));
+            qToBigEndian<quint64>(quint64(size), length);
+            wireData.append(length, 8);
+        }
+        const qsizetype payloadStart = wireData.size() + (mask ? 4 : 0);
+        if (mask) {
+            char key[4];
+            qToBigEndian<quint32>(PeerMaskingKey, key);
+            wireData.append(key, 4);
+        }
+        wireData.append(payload.constData() + offset, size);
+        if (mask) {
+            char *data = wireData.data() + payloadStart;
+            for (qsizetype i = 0; i < size; ++i)
+                data[i] ^= char(PeerMaskingKey >> (8 * (3 - (i % 4))));
+        }
+        offset += size;
+    } while (offset < payload.size());
+    return wireData;
+}
+
+// Collects the frames echoed back to the peer and counts complete messages.
+class EchoReader
+{
+public:
+    // returns the sizes of the messages completed by data
+    QList<qsizetype> feed(const QByteArray &data)
+    {
+        QList<qsizetype> completed;
+        m_buffer.append(data);
+        qsizetype offset = 0;
+        while (true) {
+            const qsizetype available = m_buffer.size() - offset;
+            if (available < 2)
+                break;
+            const uchar *header = reinterpret_cast<const uchar *>(m_buffer.constData() + offset);
+            const bool isFinal = header[0] & 0x80;
+            const bool isMasked = header[1] & 0x80;
+            quint64 length = header[1] & 0x7F;
+            qsizetype headerSize = 2;
+            if (length == 126) {
+                if (available < 4)
+                    break;
+                length = qFromBigEndian<quint16>(header + 2);
+                headerSize += 2;
+            } else if (length == 127) {
+                if (available < 10)
+                    break;
+                length = qFromBigEndian<quint64>(header + 2);
+                headerSize += 8;
+            }
+            if (isMasked)
+                headerSize += 4;
+            if (quint64(available - headerSize) < length)
+                break;
+            offset += headerSize + qsizetype(length);
+            m_messageSize += qsizetype(length);
+            if (isFinal)
+                completed.append(std::exchange(m_messageSize, 0));
+        }
+        m_buffer.remove(0, offset);
+        return completed;
+    }
+
+private:
+    QByteArray m_buffer;
+    qsizetype m_messageSize = 0;
+};
+
+// Connects a raw peer to a QWebSocket, which echoes all messages. If
+// testServer is true, the QWebSocket is accepted by a QWebSocketServer and the
+// peer is the client; otherwise the QWebSocket is the client.
+struct Connection
+{
+    std::unique_ptr<QWebSocketServer> webSocketServer;
+    std::unique_ptr<QTcpServer> tcpServer;
+    std::unique_ptr<QWebSocket> echoSocket;
+    std::unique_ptr<QTcpSocket> peer;
+
+    bool open(bool testServer)
+    {
+        if (testServer) {
+            webSocketServer = std::make_unique<QWebSocketServer>(u"autobahn"_s,
+                                                                 QWebSocketServer::NonSecureMode);
+            if (!webSocketServer->listen(QHostAddress::LocalHost))
+                return false;
+            peer = std::make_unique<QTcpSocket>();
+            peer->connectToHost(QHostAddress::LocalHost, webSocketServer->serverPort());
+            if (!peer->waitForConnected())
+                return false;
+            peer->write("GET / HTTP/1.1\r\n"
+                        "Host: 127.0.0.1:" + QByteArray::number(webSocketServer->serverPort())
+                        + "\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n\r\n");
+            const QByteArray response = readHandshake();
+            if (!response.startsWith("HTTP/1.1 101"))
+                return false;
+            if (!QTest::qWaitFor([this]() { return webSocketServer->hasPendingConnections(); }))
+                return false;
+            echoSocket.reset(webSocketServer->nextPendingConnection());
+        } else {
+            tcpServer = std::make_unique<QTcpServer>();
+            if (!tcpServer->listen(QHostAddress::LocalHost))
+                return false;
+            echoSocket = std::make_unique<QWebSocket>();
+            QUrl url(u"ws://127.0.0.1"_s);
+            url.setPort(tcpServer->serverPort());
+            echoSocket->open(url);
+            if (!QTest::qWaitFor([this]() { return tcpServer->hasPendingConnections(); }))
+                return false;
+            peer.reset(tcpServer->nextPendingConnection());
+            peer->setParent(nullptr);
+            const QByteArray request = readHandshake();
+            const qsizetype keyStart = request.indexOf("Sec-WebSocket-Key:");
+            if (keyStart < 0)
+                return false;
+            const qsizetype keyEnd = request.indexOf("\r\n", keyStart);
+            const QByteArray key = request.mid(keyStart + 18, keyEnd - keyStart - 18).trimmed();
+            const QByteArray accept = QCryptographicHash::hash(
+                        key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11",
+                        QCryptographicHash::Sha1).toBase64();
+            peer->write("HTTP/1.1 101 Switching Protocols\r\n"
+                        "Upgrade: websocket\r\n"
+                        "Connection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: " + accept + "\r\n\r\n");
+            if (!QTest::qWaitFor([this]() {
+                    return echoSocket->state() == QAbstractSocket::ConnectedState;
+                })) {
+                return false;
+            }
+        }
+        // the chopped cases depend on every write going out on its own
+        peer->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+
+        QWebSocket *socket = echoSocket.get();
+        QObject::connect(socket, &QWebSocket::textMessageReceived, socket,
+                         [socket](const QString &message) { socket->sendTextMessage(message); });
+        QObject::connect(socket, &QWebSocket::binaryMessageReceived, socket,
+                         [socket](const QByteArray &message) {
+            socket->sendBinaryMessage(message);
+        });
+        return true;
+    }
+
+    // the other side needs the event loop, so the peer must not block it
+    QByteArray readHandshake()
+    {
+        QByteArray data;
+        const bool complete = QTest::qWaitFor([this, &data]() {
+            // nothing follows the handshake until the first message is sent
+            data += peer->readAll();
+            return data.contains("\r\n\r\n");
+        });
+        return complete ? data : QByteArray();
+    }
+};
+
+} // namespace
+
+void tst_BenchAutobahn::echo_data()
+{
+    QTest::addColumn<bool>("testServer");
+    QTest::addColumn<bool>("isText");
+    QTest::addColumn<int>("messageSize");
+    QTest::addColumn<int>("frameSize");
+    QTest::addColumn<int>("chopSize");
+    QTest::addColumn<int>("messageCount");
+
+    struct Case
+    {
+        const char *id;
+        bool isText;
+        int messageSize;
+        int frameSize;
+        int chopSize;
+        int messageCount;
+    };
+    QList<Case> cases;
+    constexpr int KiB = 1024;
+    constexpr int MiB = 1024 * KiB;
+
+    // 9.1, 9.2: large messages
+    const int largeSizes[] = { 64 * KiB, 256 * KiB, 1 * MiB, 4 * MiB, 8 * MiB, 16 * MiB };
+    // 9.3, 9.4: a 4 MiB message in fragments
+    const int fragmentSizes[] = { 64, 256, 1 * KiB, 4 * KiB, 16 * KiB, 64 * KiB, 256 * KiB,
+                                  1 * MiB, 4 * MiB };
+    // 9.5, 9.6: a 1 MiB message written to the socket in chops
+    const int chopSizes[] = { 64, 128, 256, 512, 1 * KiB, 2 * KiB };
+    // 9.7, 9.8: 1000 messages, each sent after the previous one came back
+    const int smallSizes[] = { 0, 16, 64, 256, 1 * KiB, 4 * KiB };
+
+    for (int type = 0; type < 2; ++type) {
+        const bool isText = type == 0;
+        for (int i = 0; i < 6; ++i) {
+            cases.append({ isText ? "9.1" : "9.2", isText, largeSizes[i], 0, 0, 1 });
+            cases.append({ isText ? "9.5" : "9.6", isText, 1 * MiB, 0, chopSizes[i], 1 });
+            cases.append({ isText ? "9.7" : "9.8", isText, smallSizes[i], 0, 0, 1000 });
+        }
+        for (int fragmentSize : fragmentSizes)
+            cases.append({ isText ? "9.3" : "9.4", isText, 4 * MiB, fragmentSize, 0, 1 });
+    }
+    std::stable_sort(cases.begin(), cases.end(), [](const Case &left, const Case &right) {
+        return qstrcmp(left.id, right.id) < 0;
+    });
+
+    for (bool testServer : { true, false }) {
+        const char *sideName = testServer ? "QWebSocketServer" : "QWebSocket";
+        int number = 0;
+        const char *group = "";
+        for (const Case &c : std::as_const(cases)) {
+            if (qstrcmp(group, c.id) != 0) {
+                group = c.id;
+                number = 0;
+            }
+            QTest::addRow("%s %s.%d: %d x %d bytes, frames %d, chops %d", sideName, c.id,
+                          ++number, c.messageCount, c.messageSize, c.frameSize, c.chopSize)
+                    << testServer << c.isText << c.messageSize << c.frameSize << c.chopSize
+                    << c.messageCount;
+        }
+    }
+}
+
+void tst_BenchAutobahn::echo()
+{
+    QFETCH(bool, testServer);
+    QFETCH(bool, isText);
+    QFETCH(int, messageSize);
+    QFETCH(int, frameSize);
+    QFETCH(int, chopSize);
+    QFETCH(int, messageCount);
+
+    Connection connection;
+    QVERIFY(connection.open(testServer));
+    QTcpSocket *peer = connection.peer.get();
+
+    // a client masks what it sends
+    const QByteArray message = encodeMessage(isText, QByteArray(messageSize, 'a'), frameSize,
+                                             testServer);
+    const auto sendMessage = [&]() {
+        if (chopSize <= 0) {
+            peer->write(message);
+            return;
+        }
+        for (qsizetype offset = 0; offset < message.size(); offset += chopSize) {
+            peer->write(message.constData() + offset, qMin(qsizetype(chopSize),
+                                                           message.size() - offset));
+            peer->flush();
+        }
+    };
+
+    EchoReader reader;
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.setInterval(120000);
+    QObject::connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    int echoed = 0;
+    bool sizeMismatch = false;
+    QObject::connect(peer, &QTcpSocket::readyRead, &loop, [&]() {
+        const QList<qsizetype> sizes = reader.feed(peer->readAll());
+        for (qsizetype size : sizes) {
+            sizeMismatch |= size != messageSize;
+            if (++echoed == messageCount)
+                loop.quit();
+            else
+                sendMessage();
+        }
+    });
+
+    QBENCHMARK {
+        echoed = 0;
+        timeout.start();
+        sendMessage();
+        loop.exec();
+        QCOMPARE(echoed, messageCount);
+    }
+    QVERIFY(!sizeMismatch);
+}
+
+QTEST_MAIN(tst_BenchAutobahn)
+
+#include "tst_bench_autobahn.moc"
@@ -0,0 +1,151 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtCore/QBuffer>
+
+#include "private/qwebsocketbufferpool_p.h"
+#include "private/qwebsocketdataprocessor_p.h"
+#include "private/qwebsocketframe_p.h"
+
+QT_USE_NAMESPACE
+
+Q_DECLARE_METATYPE(QWebSocketProtocol::OpCode)
+
+// Checks that steady-state traffic is served entirely from the buffer pool,
+// and reports the number of pool misses (= heap allocations done by the
+// pool) per message.
+class tst_BenchBufferPool : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void inbound_data();
+    void inbound();
+    void outbound_data();
+    void outbound();
+
+private:
+    static QByteArray encodeMessage(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                                    int frameCount, quint32 mask);
+};
+
+QByteArray tst_BenchBufferPool::encodeMessage(QWebSocketProtocol::OpCode opCode,
+                                              const QByteArray &payload, int frameCount,
+                                              quint32 mask)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    const qsizetype frameSize = payload.size() / frameCount;
+    for (int i = 0; i < frameCount; ++i) {
+        const bool isLastFrame = i == frameCount - 1;
+        const qsizetype size = isLastFrame ? payload.size() - i * frameSize : frameSize;
+        QWebSocketFrame::writeFrame(&buffer, i == 0 ? opCode : QWebSocketProtocol::OpCodeContinue,
+                                    QByteArrayView(payload).sliced(i * frameSize, size),
+                                    mask, isLastFrame);
+    }
+    return buffer.data();
+}
+
+void tst_BenchBufferPool::inbound_data()
+{
+    QTest::addColumn<QWebSocketProtocol::OpCode>("opCode");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<int>("frameCount");
+    QTest::addColumn<quint32>("mask");
+
+    QTest::newRow("text 64B") << QWebSocketProtocol::OpCodeText << 64 << 1 << 0U;
+    QTest::newRow("masked text 4KiB") << QWebSocketProtocol::OpCodeText << 4096 << 1 << 0x1234U;
+    QTest::newRow("binary 1KiB") << QWebSocketProtocol::OpCodeBinary << 1024 << 1 << 0U;
+    QTest::newRow("binary 64KiB in 4 frames")
+            << QWebSocketProtocol::OpCodeBinary << 65536 << 4 << 0U;
+}
+
+void tst_BenchBufferPool::inbound()
+{
+    QFETCH(QWebSocketProtocol::OpCode, opCode);
+    QFETCH(int, payloadSize);
+    QFETCH(int, frameCount);
+    QFETCH(quint32, mask);
+
+    constexpr int messagesPerRound = 100;
+    const QByteArray message = encodeMessage(opCode, QByteArray(payloadSize, 'a'),
+                                             frameCount, mask);
+    QByteArray wireData;
+    for (int i = 0; i < messagesPerRound; ++i)
+        wireData.append(message);
+
+    QBuffer buffer(&wireData);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QWebSocketDataProcessor dataProcessor;
+    int received = 0;
+    connect(&dataProcessor, &QWebSocketDataProcessor::textMessageReceived, this,
+            [&received](const QString &) { ++received; });
+    connect(&dataProcessor, &QWebSocketDataProcessor::binaryMessageReceived, this,
+            [&received](const QByteArray &) { ++received; });
+
+    const auto processRound = [&]() {
+        buffer.seek(0);
+        while (buffer.bytesAvailable() > 0)
+            dataProcessor.process(&buffer);
+    };
+
+    // warm up the pool
+    processRound();
+    QCOMPARE(received, messagesPerRound);
+
+    QWebSocketBufferPool::resetStatistics();
+    received = 0;
+    constexpr int rounds = 10;
+    for (int i = 0; i < rounds; ++i)
+        processRound();
+    QCOMPARE(received, rounds * messagesPerRound);
+
+    const QWebSocketBufferPool::Statistics statistics = QWebSocketBufferPool::statistics();
+    QCOMPARE(statistics.misses, 0ULL);
+    QTest::setBenchmarkResult(qreal(statistics.misses) / received, QTest::Events);
+}
+
+void tst_BenchBufferPool::outbound_data()
+{
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<quint32>("mask");
+
+    QTest::newRow("masked 64B") << 64 << 0x1234U;
+    QTest::newRow("masked 16KiB") << 16384 << 0x1234U;
+    QTest::newRow("unmasked 16KiB") << 16384 << 0U;
+}
+
+void tst_BenchBufferPool::outbound()
+{
+    QFETCH(int, payloadSize);
+    QFETCH(quint32, mask);
+
+    const QByteArray payload(payloadSize, 'a');
+    QByteArray wireData;
+    wireData.reserve(payloadSize + QWebSocketFrame::MaxHeaderSize);
+    QBuffer buffer(&wireData);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+    const auto writeMessage = [&]() {
+        buffer.seek(0);
+        QCOMPARE(QWebSocketFrame::writeFrame(&buffer, QWebSocketProtocol::OpCodeBinary, payload,
+                                             mask, true),
+                 qint64(payloadSize));
+    };
+
+    // warm up the pool
+    writeMessage();
+
+    QWebSocketBufferPool::resetStatistics();
+    constexpr int messages = 1000;
+    for (int i = 0; i < messages; ++i)
+        writeMessage();
+
+    const QWebSocketBufferPool::Statistics statistics = QWebSocketBufferPool::statistics();
+    QCOMPARE(statistics.misses, 0ULL);
+    QTest::setBenchmarkResult(qreal(statistics.misses) / messages, QTest::Events);
+}
+
+QTEST_MAIN(tst_BenchBufferPool)
+
+#include "tst_bench_bufferpool.moc"
@@ -0,0 +1,77 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtWebSockets/QWebSocketServer>
+#include <QtWebSockets/QWebSocket>
+
+QT_USE_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+// Opens and closes connections to a server over loopback, one after the
+// other, and measures the time a batch of connect/disconnect cycles takes.
+// This covers the allocation and setup of the sockets, the opening handshake
+// and the closing handshake on both ends.
+class tst_BenchChurn : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void cycles_data();
+    void cycles();
+};
+
+void tst_BenchChurn::cycles_data()
+{
+    QTest::addColumn<int>("socketPoolSize");
+    QTest::addColumn<int>("cycleCount");
+
+    QTest::newRow("no socket pool") << 0 << 200;
+    QTest::newRow("socket pool") << 16 << 200;
+}
+
+void tst_BenchChurn::cycles()
+{
+    QFETCH(int, socketPoolSize);
+    QFETCH(int, cycleCount);
+
+    QWebSocketServer server(u"churn"_s, QWebSocketServer::NonSecureMode);
+    server.setSocketPoolSize(socketPoolSize);
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+    const QUrl url(u"ws://127.0.0.1:%1"_s.arg(server.serverPort()));
+
+    // QTRY_* polls in steps that would dominate the measurement, so the
+    // event loop is quit as soon as a cycle is complete
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.setInterval(10000);
+    connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    int completed = 0;
+    connect(&server, &QWebSocketServer::newConnection, &loop, [&]() {
+        while (QWebSocket *serverSocket = server.nextPendingConnection()) {
+            connect(serverSocket, &QWebSocket::disconnected, &loop, [&, serverSocket]() {
+                serverSocket->deleteLater();
+                ++completed;
+                loop.quit();
+            });
+        }
+    });
+
+    QBENCHMARK {
+        completed = 0;
+        for (int i = 0; i < cycleCount; ++i) {
+            QWebSocket client;
+            connect(&client, &QWebSocket::connected, &client, [&client]() { client.close(); });
+            timeout.start();
+            client.open(url);
+            loop.exec();
+            QCOMPARE(completed, i + 1);
+        }
+    }
+}
+
+QTEST_MAIN(tst_BenchChurn)
+
+#include "tst_bench_churn.moc"
@@ -0,0 +1,109 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtCore/QBuffer>
+
+#include "private/qwebsocketdataprocessor_p.h"
+#include "private/qwebsocketframe_p.h"
+
+QT_USE_NAMESPACE
+
+Q_DECLARE_METATYPE(QWebSocketProtocol::OpCode)
+
+// Measures how fast QWebSocketDataProcessor turns a stream of frames, read
+// from an in-memory buffer, into messages.
+class tst_BenchDataProcessor : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void process_data();
+    void process();
+
+private:
+    static QByteArray encodeMessage(QWebSocketProtocol::OpCode opCode, const QByteArray &payload,
+                                    int frameCount, quint32 mask);
+};
+
+QByteArray tst_BenchDataProcessor::encodeMessage(QWebSocketProtocol::OpCode opCode,
+                                                 const QByteArray &payload, int frameCount,
+                                                 quint32 mask)
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    const qsizetype frameSize = payload.size() / frameCount;
+    for (int i = 0; i < frameCount; ++i) {
+        const bool isLastFrame = i == frameCount - 1;
+        const qsizetype size = isLastFrame ? payload.size() - i * frameSize : frameSize;
+        QWebSocketFrame::writeFrame(&buffer, i == 0 ? opCode : QWebSocketProtocol::OpCodeContinue,
+                                    QByteArrayView(payload).sliced(i * frameSize, size),
+                                    mask, isLastFrame);
+    }
+    return buffer.data();
+}
+
+void tst_BenchDataProcessor::process_data()
+{
+    QTest::addColumn<QWebSocketProtocol::OpCode>("opCode");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<int>("frameCount");
+    QTest::addColumn<quint32>("mask");
+    QTest::addColumn<int>("messageCount");
+
+    const QList<int> sizes = { 16, 1024, 65536, 1024 * 1024 };
+    for (int size : sizes) {
+        const int messageCount = qMax(1, 4 * 1024 * 1024 / size / 16);
+        for (int frameCount : { 1, 16 }) {
+            if (frameCount > size)
+                continue;
+            QTest::addRow("text %d in %d", size, frameCount)
+                    << QWebSocketProtocol::OpCodeText << size << frameCount << 0U << messageCount;
+            QTest::addRow("binary %d in %d", size, frameCount)
+                    << QWebSocketProtocol::OpCodeBinary << size << frameCount << 0U
+                    << messageCount;
+            QTest::addRow("masked text %d in %d", size, frameCount)
+                    << QWebSocketProtocol::OpCodeText << size << frameCount << 0x12345678U
+                    << messageCount;
+            QTest::addRow("masked binary %d in %d", size, frameCount)
+                    << QWebSocketProtocol::OpCodeBinary << size << frameCount << 0x12345678U
+                    << messageCount;
+        }
+    }
+}
+
+void tst_BenchDataProcessor::process()
+{
+    QFETCH(QWebSocketProtocol::OpCode, opCode);
+    QFETCH(int, payloadSize);
+    QFETCH(int, frameCount);
+    QFETCH(quint32, mask);
+    QFETCH(int, messageCount);
+
+    const QByteArray message = encodeMessage(opCode, QByteArray(payloadSize, 'a'), frameCount,
+                                             mask);
+    QByteArray wireData;
+    wireData.reserve(message.size() * messageCount);
+    for (int i = 0; i < messageCount; ++i)
+        wireData.append(message);
+
+    QBuffer buffer(&wireData);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    QWebSocketDataProcessor dataProcessor;
+    int received = 0;
+    connect(&dataProcessor, &QWebSocketDataProcessor::textMessageReceived, this,
+            [&received](const QString &) { ++received; });
+    connect(&dataProcessor, &QWebSocketDataProcessor::binaryMessageReceived, this,
+            [&received](const QByteArray &) { ++received; });
+
+    QBENCHMARK {
+        buffer.seek(0);
+        while (buffer.bytesAvailable() > 0)
+            dataProcessor.process(&buffer);
+    }
+    QVERIFY(received >= messageCount);
+    QCOMPARE(received % messageCount, 0);
+}
+
+QTEST_MAIN(tst_BenchDataProcessor)
+
+#include "tst_bench_dataprocessor.moc"
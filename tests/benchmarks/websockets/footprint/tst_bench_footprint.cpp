@@ -0,0 +1,155 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtNetwork/QTcpServer>
+#include <QtNetwork/QTcpSocket>
+#include <QtWebSockets/QWebSocketServer>
+#include <QtWebSockets/QWebSocket>
+
+#ifdef Q_OS_LINUX
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <memory>
+#include <vector>
+
+QT_USE_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+// Measures the resident memory that an idle, fully upgraded server-side
+// connection costs. The clients are plain POSIX sockets so that only the
+// server side of every connection lives in user space.
+class tst_BenchFootprint : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void idleConnections_data();
+    void idleConnections();
+
+#ifdef Q_OS_LINUX
+private:
+    static qint64 residentBytes();
+    static bool ensureFileDescriptors(rlim_t required);
+#endif
+};
+
+#ifdef Q_OS_LINUX
+qint64 tst_BenchFootprint::residentBytes()
+{
+    QFile statm(u"/proc/self/statm"_s);
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+bool tst_BenchFootprint::ensureFileDescriptors(rlim_t required)
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return false;
+    if (limit.rlim_cur >= required)
+        return true;
+    if (limit.rlim_max != RLIM_INFINITY && limit.rlim_max < required)
+        return false;
+    limit.rlim_cur = required;
+    return setrlimit(RLIMIT_NOFILE, &limit) == 0;
+}
+#endif
+
+void tst_BenchFootprint::idleConnections_data()
+{
+    QTest::addColumn<int>("connectionCount");
+
+    QTest::newRow("10k") << 10000;
+    QTest::newRow("100k") << 100000;
+}
+
+void tst_BenchFootprint::idleConnections()
+{
+#ifndef Q_OS_LINUX
+    QSKIP("Resident memory is read from /proc/self/statm");
+#else
+    QFETCH(int, connectionCount);
+
+    // one descriptor for each side of a connection, plus some slack
+    if (!ensureFileDescriptors(rlim_t(connectionCount) * 2 + 256))
+        QSKIP("RLIMIT_NOFILE is too low for this number of connections");
+
+    QTcpServer tcpServer;
+    tcpServer.setListenBacklogSize(1024);
+    QVERIFY(tcpServer.listen(QHostAddress::LocalHost));
+    QWebSocketServer server(u"footprint"_s, QWebSocketServer::NonSecureMode);
+    connect(&tcpServer, &QTcpServer::newConnection, &server, [&]() {
+        while (QTcpSocket *socket = tcpServer.nextPendingConnection())
+            server.handleConnection(socket);
+    });
+
+    std::vector<std::unique_ptr<QWebSocket>> serverSockets;
+    serverSockets.reserve(size_t(connectionCount));
+    connect(&server, &QWebSocketServer::newConnection, &server, [&]() {
+        while (QWebSocket *socket = server.nextPendingConnection())
+            serverSockets.emplace_back(socket);
+    });
+
+    const QByteArray handshake = "GET / HTTP/1.1\r\n"
+                                 "Host: 127.0.0.1:" + QByteArray::number(tcpServer.serverPort())
+            + "\r\n"
+              "Upgrade: websocket\r\n"
+              "Connection: Upgrade\r\n"
+              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+              "Sec-WebSocket-Version: 13\r\n\r\n";
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(tcpServer.serverPort());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    std::vector<int> clients;
+    clients.reserve(size_t(connectionCount));
+    const auto closeClients = qScopeGuard([&clients]() {
+        for (int fd : clients)
+            ::close(fd);
+    });
+
+    // warm up the allocator and the event dispatcher before taking the baseline
+    QCoreApplication::processEvents();
+    const qint64 baseline = residentBytes();
+    QVERIFY(baseline > 0);
+
+    constexpr int batchSize = 256;
+    while (int(clients.size()) < connectionCount) {
+        const int batch = qMin(batchSize, connectionCount - int(clients.size()));
+        for (int i = 0; i < batch; ++i) {
+            const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            QVERIFY2(fd >= 0, qt_error_string().toLocal8Bit());
+            clients.push_back(fd);
+            QVERIFY2(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0,
+                     qt_error_string().toLocal8Bit());
+            QCOMPARE(::send(fd, handshake.constData(), size_t(handshake.size()), 0),
+                     ssize_t(handshake.size()));
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(serverSockets.size(), clients.size(), 30000);
+    }
+
+    // let queued events and deferred deletions settle
+    QTest::qWait(100);
+
+    const qint64 perConnection = (residentBytes() - baseline) / connectionCount;
+    QTest::setBenchmarkResult(qreal(perConnection), QTest::BytesAllocated);
+
+    serverSockets.clear();
+#endif
+}
+
+QTEST_MAIN(tst_BenchFootprint)
+
+#include "tst_bench_footprint.moc"
@@ -0,0 +1,100 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtCore/QTextStream>
+
+#include "private/qwebsockethandshakerequest_p.h"
+#include "private/qwebsockethandshakeresponse_p.h"
+
+QT_USE_NAMESPACE
+
+// Measures parsing an opening handshake and generating the response to it.
+class tst_BenchHandshake : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void readHandshake_data();
+    void readHandshake();
+    void response_data();
+    void response();
+
+private:
+    static void addRequestRows();
+};
+
+constexpr int MaxHeaderLineLength = 8 * 1024;
+
+void tst_BenchHandshake::addRequestRows()
+{
+    QTest::addColumn<QByteArray>("request");
+
+    const QByteArray minimal = "GET /chat HTTP/1.1\r\n"
+                               "Host: example.com:8080\r\n"
+                               "Upgrade: websocket\r\n"
+                               "Connection: Upgrade\r\n"
+                               "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                               "Sec-WebSocket-Version: 13\r\n";
+    QTest::newRow("minimal") << minimal + "\r\n";
+    QTest::newRow("browser")
+            << minimal
+               + "Origin: http://example.com\r\n"
+                 "Sec-WebSocket-Protocol: chat, superchat, protocol1, protocol2\r\n"
+                 "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+                 "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101\r\n"
+                 "Accept-Language: en-US,en;q=0.5\r\n"
+                 "Accept-Encoding: gzip, deflate, br\r\n"
+                 "Cache-Control: no-cache\r\n"
+                 "Pragma: no-cache\r\n"
+                 "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n\r\n";
+    QByteArray manyHeaders = minimal;
+    for (int i = 0; i < 50; ++i)
+        manyHeaders += "X-Custom-Header-" + QByteArray::number(i) + ": value\r\n";
+    QTest::newRow("50 extra headers") << manyHeaders + "\r\n";
+}
+
+void tst_BenchHandshake::readHandshake_data()
+{
+    addRequestRows();
+}
+
+void tst_BenchHandshake::readHandshake()
+{
+    QFETCH(QByteArray, request);
+
+    QWebSocketHandshakeRequest handshakeRequest(8080, false);
+    QBENCHMARK {
+        handshakeRequest.clear();
+        handshakeRequest.readHandshake(request, MaxHeaderLineLength);
+    }
+    QVERIFY(handshakeRequest.isValid());
+}
+
+void tst_BenchHandshake::response_data()
+{
+    addRequestRows();
+}
+
+void tst_BenchHandshake::response()
+{
+    QFETCH(QByteArray, request);
+
+    QWebSocketHandshakeRequest handshakeRequest(8080, false);
+    handshakeRequest.readHandshake(request, MaxHeaderLineLength);
+    QVERIFY(handshakeRequest.isValid());
+
+    QString output;
+    QBENCHMARK {
+        QWebSocketHandshakeResponse response(handshakeRequest, QStringLiteral("server"), true,
+                                             { QWebSocketProtocol::Version13 },
+                                             { QStringLiteral("protocol2") }, {});
+        output.clear();
+        QTextStream stream(&output);
+        stream << response;
+    }
+    QVERIFY(output.startsWith(QLatin1StringView("HTTP/1.1 101")));
+}
+
+QTEST_MAIN(tst_BenchHandshake)
+
+#include "tst_bench_handshake.moc"
@@ -0,0 +1,108 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtWebSockets/QWebSocketServer>
+#include <QtWebSockets/QWebSocket>
+
+QT_USE_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+// Streams messages from a client to a server over loopback and measures the
+// time it takes until the server has received all of them. This covers the
+// whole receive path: socket reads, frame decoding and message assembly.
+class tst_BenchLoopback : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void receive_data();
+    void receive();
+
+private:
+    QWebSocketServer *m_server = nullptr;
+    QWebSocket *m_serverSocket = nullptr;
+    QWebSocket *m_client = nullptr;
+};
+
+void tst_BenchLoopback::initTestCase()
+{
+    m_server = new QWebSocketServer(u"loopback"_s, QWebSocketServer::NonSecureMode, this);
+    QVERIFY(m_server->listen(QHostAddress::LocalHost));
+    QSignalSpy newConnectionSpy(m_server, &QWebSocketServer::newConnection);
+
+    m_client = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    QSignalSpy connectedSpy(m_client, &QWebSocket::connected);
+    m_client->open(QUrl(u"ws://127.0.0.1:%1"_s.arg(m_server->serverPort())));
+    QTRY_COMPARE(connectedSpy.size(), 1);
+    QTRY_COMPARE(newConnectionSpy.size(), 1);
+    m_serverSocket = m_server->nextPendingConnection();
+    QVERIFY(m_serverSocket);
+    m_serverSocket->setParent(this);
+}
+
+void tst_BenchLoopback::cleanupTestCase()
+{
+    delete m_client;
+    delete m_serverSocket;
+    delete m_server;
+}
+
+void tst_BenchLoopback::receive_data()
+{
+    QTest::addColumn<bool>("binary");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<int>("messageCount");
+
+    QTest::newRow("text 16B") << false << 16 << 100000;
+    QTest::newRow("text 1KiB") << false << 1024 << 20000;
+    QTest::newRow("binary 16B") << true << 16 << 100000;
+    QTest::newRow("binary 1KiB") << true << 1024 << 20000;
+    QTest::newRow("binary 64KiB") << true << 65536 << 1000;
+}
+
+void tst_BenchLoopback::receive()
+{
+    QFETCH(bool, binary);
+    QFETCH(int, payloadSize);
+    QFETCH(int, messageCount);
+
+    const QByteArray binaryPayload(payloadSize, 'a');
+    const QString textPayload(payloadSize, u'a');
+
+    // QTRY_* polls in steps that would dominate the measurement, so the
+    // event loop is quit as soon as the last message has arrived
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.setInterval(60000);
+    connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    int received = 0;
+    const auto countMessage = [&]() {
+        if (++received == messageCount)
+            loop.quit();
+    };
+    connect(m_serverSocket, &QWebSocket::textMessageReceived, &loop, countMessage);
+    connect(m_serverSocket, &QWebSocket::binaryMessageReceived, &loop, countMessage);
+
+    QBENCHMARK {
+        received = 0;
+        timeout.start();
+        for (int i = 0; i < messageCount; ++i) {
+            if (binary)
+                m_client->sendBinaryMessage(binaryPayload);
+            else
+                m_client->sendTextMessage(textPayload);
+        }
+        if (received < messageCount)
+            loop.exec();
+        QCOMPARE(received, messageCount);
+    }
+}
+
+QTEST_MAIN(tst_BenchLoopback)
+
+#include "tst_bench_loopback.moc"
@@ -0,0 +1,123 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtCore/QBuffer>
+
+#include "private/qwebsocketframe_p.h"
+#include "private/qwebsocketprotocol_p.h"
+
+QT_USE_NAMESPACE
+
+Q_DECLARE_METATYPE(QWebSocketProtocol::OpCode)
+
+// Measures masking, and encoding and decoding of single frames, on in-memory
+// buffers.
+class tst_BenchProtocol : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void mask_data();
+    void mask();
+    void readFrame_data();
+    void readFrame();
+    void writeFrame_data();
+    void writeFrame();
+
+private:
+    static void addFrameRows();
+};
+
+void tst_BenchProtocol::mask_data()
+{
+    QTest::addColumn<int>("payloadSize");
+
+    QTest::newRow("16B") << 16;
+    QTest::newRow("125B") << 125;
+    QTest::newRow("1KiB") << 1024;
+    QTest::newRow("64KiB") << 65536;
+    QTest::newRow("1MiB") << 1024 * 1024;
+}
+
+void tst_BenchProtocol::mask()
+{
+    QFETCH(int, payloadSize);
+
+    QByteArray payload(payloadSize, 'a');
+    QBENCHMARK {
+        QWebSocketProtocol::mask(payload.data(), quint64(payload.size()), 0x12345678U);
+    }
+}
+
+void tst_BenchProtocol::addFrameRows()
+{
+    QTest::addColumn<QWebSocketProtocol::OpCode>("opCode");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<quint32>("mask");
+
+    const QList<int> sizes = { 16, 125, 1024, 65536, 1024 * 1024 };
+    for (int size : sizes) {
+        QTest::addRow("text %d", size) << QWebSocketProtocol::OpCodeText << size << 0U;
+        QTest::addRow("binary %d", size) << QWebSocketProtocol::OpCodeBinary << size << 0U;
+        QTest::addRow("masked binary %d", size)
+                << QWebSocketProtocol::OpCodeBinary << size << 0x12345678U;
+    }
+    QTest::newRow("ping") << QWebSocketProtocol::OpCodePing << 16 << 0U;
+    QTest::newRow("masked ping") << QWebSocketProtocol::OpCodePing << 16 << 0x12345678U;
+}
+
+void tst_BenchProtocol::readFrame_data()
+{
+    addFrameRows();
+}
+
+void tst_BenchProtocol::readFrame()
+{
+    QFETCH(QWebSocketProtocol::OpCode, opCode);
+    QFETCH(int, payloadSize);
+    QFETCH(quint32, mask);
+
+    QByteArray wireData;
+    QBuffer buffer(&wireData);
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+    QCOMPARE(QWebSocketFrame::writeFrame(&buffer, opCode, QByteArray(payloadSize, 'a'), mask,
+                                         true),
+             qint64(payloadSize));
+
+    QWebSocketFrame frame;
+    QBENCHMARK {
+        buffer.seek(0);
+        frame.clear();
+        frame.readFrame(&buffer);
+    }
+    QVERIFY(frame.isValid());
+    QCOMPARE(frame.payload().size(), payloadSize);
+}
+
+void tst_BenchProtocol::writeFrame_data()
+{
+    addFrameRows();
+}
+
+void tst_BenchProtocol::writeFrame()
+{
+    QFETCH(QWebSocketProtocol::OpCode, opCode);
+    QFETCH(int, payloadSize);
+    QFETCH(quint32, mask);
+
+    const QByteArray payload(payloadSize, 'a');
+    QByteArray wireData;
+    wireData.reserve(payloadSize + QWebSocketFrame::MaxHeaderSize);
+    QBuffer buffer(&wireData);
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+
+    QBENCHMARK {
+        buffer.seek(0);
+        QWebSocketFrame::writeFrame(&buffer, opCode, payload, mask, true);
+    }
+    QVERIFY(wireData.size() > payloadSize);
+}
+
+QTEST_MAIN(tst_BenchProtocol)
+
+#include "tst_bench_protocol.moc"
@@ -0,0 +1,149 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+#include <QtTest>
+#include <QtWebSockets/QWebSocketServer>
+#include <QtWebSockets/QWebSocket>
+
+QT_USE_NAMESPACE
+
+using namespace Qt::StringLiterals;
+
+// Streams messages from a client through a gateway to a backend, all over
+// loopback, and measures the time until the backend has received all of them.
+// The gateway either forwards whole messages with sendTextMessage() and
+// sendBinaryMessage(), or relays the frames with QWebSocket::setRelayTarget().
+// Client and backend do the same work in both modes, so the difference is the
+// cost of the gateway; run with -tickcounter or -perf to compare CPU time.
+class tst_BenchRelay : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+    void forward_data();
+    void forward();
+
+private:
+    QWebSocketServer *m_gateway = nullptr;
+    QWebSocketServer *m_backend = nullptr;
+    QWebSocket *m_client = nullptr;
+    QWebSocket *m_gatewaySocket = nullptr;
+    QWebSocket *m_gatewayClient = nullptr;
+    QWebSocket *m_backendSocket = nullptr;
+};
+
+static QWebSocket *connectTo(QWebSocketServer *server, QWebSocket *client, QObject *parent)
+{
+    QSignalSpy newConnectionSpy(server, &QWebSocketServer::newConnection);
+    client->open(QUrl(u"ws://127.0.0.1:%1"_s.arg(server->serverPort())));
+    if (!QTest::qWaitFor([&]() {
+            return client->state() == QAbstractSocket::ConnectedState
+                    && !newConnectionSpy.isEmpty();
+        })) {
+        return nullptr;
+    }
+    QWebSocket *serverSocket = server->nextPendingConnection();
+    if (serverSocket)
+        serverSocket->setParent(parent);
+    return serverSocket;
+}
+
+void tst_BenchRelay::initTestCase()
+{
+    m_gateway = new QWebSocketServer(u"gateway"_s, QWebSocketServer::NonSecureMode, this);
+    QVERIFY(m_gateway->listen(QHostAddress::LocalHost));
+    m_backend = new QWebSocketServer(u"backend"_s, QWebSocketServer::NonSecureMode, this);
+    QVERIFY(m_backend->listen(QHostAddress::LocalHost));
+
+    m_client = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    m_gatewaySocket = connectTo(m_gateway, m_client, this);
+    QVERIFY(m_gatewaySocket);
+    m_gatewayClient = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    m_backendSocket = connectTo(m_backend, m_gatewayClient, this);
+    QVERIFY(m_backendSocket);
+}
+
+void tst_BenchRelay::cleanupTestCase()
+{
+    delete m_client;
+    delete m_gatewaySocket;
+    delete m_gatewayClient;
+    delete m_backendSocket;
+    delete m_gateway;
+    delete m_backend;
+}
+
+void tst_BenchRelay::forward_data()
+{
+    QTest::addColumn<bool>("relay");
+    QTest::addColumn<bool>("binary");
+    QTest::addColumn<int>("payloadSize");
+    QTest::addColumn<int>("messageCount");
+
+    for (bool relay : { false, true }) {
+        const char *mode = relay ? "relay" : "messages";
+        QTest::addRow("%s text 1KiB", mode) << relay << false << 1024 << 20000;
+        QTest::addRow("%s binary 1KiB", mode) << relay << true << 1024 << 20000;
+        QTest::addRow("%s binary 64KiB", mode) << relay << true << 65536 << 1000;
+        QTest::addRow("%s binary 1MiB", mode) << relay << true << 1024 * 1024 << 100;
+    }
+}
+
+void tst_BenchRelay::forward()
+{
+    QFETCH(bool, relay);
+    QFETCH(bool, binary);
+    QFETCH(int, payloadSize);
+    QFETCH(int, messageCount);
+
+    const QByteArray binaryPayload(payloadSize, 'a');
+    const QString textPayload(payloadSize, u'a');
+
+    QObject context;
+    if (relay) {
+        m_gatewaySocket->setRelayTarget(m_gatewayClient);
+    } else {
+        m_gatewaySocket->setRelayTarget(nullptr);
+        connect(m_gatewaySocket, &QWebSocket::textMessageReceived, &context,
+                [this](const QString &message) { m_gatewayClient->sendTextMessage(message); });
+        connect(m_gatewaySocket, &QWebSocket::binaryMessageReceived, &context,
+                [this](const QByteArray &message) {
+            m_gatewayClient->sendBinaryMessage(message);
+        });
+    }
+
+    // QTRY_* polls in steps that would dominate the measurement, so the
+    // event loop is quit as soon as the last message has arrived
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    timeout.setInterval(60000);
+    connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+
+    int received = 0;
+    const auto countMessage = [&]() {
+        if (++received == messageCount)
+            loop.quit();
+    };
+    connect(m_backendSocket, &QWebSocket::textMessageReceived, &loop, countMessage);
+    connect(m_backendSocket, &QWebSocket::binaryMessageReceived, &loop, countMessage);
+
+    QBENCHMARK {
+        received = 0;
+        timeout.start();
+        for (int i = 0; i < messageCount; ++i) {
+            if (binary)
+                m_client->sendBinaryMessage(binaryPayload);
+            else
+                m_client->sendTextMessage(textPayload);
+        }
+        if (received < messageCount)
+            loop.exec();
+        QCOMPARE(received, messageCount);
+    }
+}
+
+QTEST_MAIN(tst_BenchRelay)
+
+#include "tst_bench_relay.moc"
@@ -0,0 +1,10 @@
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+TARGET = loadgenerator
+
+QT = core network websockets
+
+SOURCES += main.cpp
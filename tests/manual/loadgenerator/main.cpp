@@ -0,0 +1,411 @@
+// Copyright (C) 2024 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR GPL-3.0-only
+
+// Runs a QWebSocketServer in the main thread and a swarm of QWebSocket
+// clients in a second thread, connected over loopback. Every client sends
+// timestamped binary messages at a fixed rate; the server forwards each of
+// them to fan-out clients, which record the latency. At the end, throughput,
+// latency percentiles, the CPU time of the server thread and the resident
+// memory per connection (client and server side together) are printed.
+//
+// Example: loadgenerator --connections 1000 --rate 10 --size 256 --fan-out 4
+
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QFile>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QtEndian>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+#if QT_CONFIG(ssl)
+#include <QtNetwork/QSslCertificate>
+#include <QtNetwork/QSslConfiguration>
+#include <QtNetwork/QSslKey>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using namespace Qt::StringLiterals;
+
+namespace {
+
+// shared by both threads, so that timestamps can be compared
+QElapsedTimer s_clock;
+
+struct Options
+{
+    int connections = 100;
+    int messageSize = 64;
+    int rate = 10;
+    int fanOut = 1;
+    int duration = 10;
+    bool tls = false;
+    QString certificate;
+    QString key;
+};
+
+qint64 residentBytes()
+{
+#ifdef Q_OS_LINUX
+    QFile statm(u"/proc/self/statm"_s);
+    if (!statm.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+#ifdef RUSAGE_THREAD
+constexpr bool isCpuTimePerThread = true;
+#else
+constexpr bool isCpuTimePerThread = false;
+#endif
+
+// user and system time consumed by the calling thread (or by the whole
+// process, where per-thread usage is not available), in milliseconds
+qint64 cpuTime()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &usage) != 0)
+#else
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+#endif
+        return -1;
+    const auto toMsecs = [](const timeval &time) {
+        return qint64(time.tv_sec) * 1000 + time.tv_usec / 1000;
+    };
+    return toMsecs(usage.ru_utime) + toMsecs(usage.ru_stime);
+#else
+    return -1;
+#endif
+}
+
+class Server : public QObject
+{
+    Q_OBJECT
+
+public:
+    Server(const Options &options, QObject *parent = nullptr)
+        : QObject(parent),
+          m_server(u"loadgenerator"_s,
+                   options.tls ? QWebSocketServer::SecureMode : QWebSocketServer::NonSecureMode),
+          m_fanOut(options.fanOut)
+    {
+        connect(&m_server, &QWebSocketServer::newConnection, this, &Server::onNewConnection);
+    }
+
+    bool listen(const Options &options)
+    {
+#if QT_CONFIG(ssl)
+        if (options.tls) {
+            QFile certificateFile(options.certificate);
+            QFile keyFile(options.key);
+            if (!certificateFile.open(QIODevice::ReadOnly) || !keyFile.open(QIODevice::ReadOnly)) {
+                qWarning("Cannot read the certificate or the key");
+                return false;
+            }
+            QSslConfiguration configuration = QSslConfiguration::defaultConfiguration();
+            configuration.setLocalCertificate(QSslCertificate(&certificateFile, QSsl::Pem));
+            configuration.setPrivateKey(QSslKey(&keyFile, QSsl::Rsa, QSsl::Pem));
+            configuration.setPeerVerifyMode(QSslSocket::VerifyNone);
+            m_server.setSslConfiguration(configuration);
+        }
+#else
+        Q_UNUSED(options);
+#endif
+        return m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url() const
+    {
+        QUrl url;
+        url.setScheme(m_server.secureMode() == QWebSocketServer::SecureMode ? u"wss"_s : u"ws"_s);
+        url.setHost(u"127.0.0.1"_s);
+        url.setPort(m_server.serverPort());
+        return url;
+    }
+
+    qsizetype connectionCount() const { return m_clients.size(); }
+    quint64 forwardedMessages() const { return m_forwarded; }
+
+private:
+    void onNewConnection()
+    {
+        while (QWebSocket *socket = m_server.nextPendingConnection()) {
+            socket->setParent(this);
+            const qsizetype index = m_clients.size();
+            m_clients.append(socket);
+            connect(socket, &QWebSocket::binaryMessageReceived, this,
+                    [this, index](const QByteArray &message) { forward(index, message); });
+        }
+    }
+
+    void forward(qsizetype sender, const QByteArray &message)
+    {
+        // the sender and the clients after it receive the message
+        for (int i = 0; i < m_fanOut; ++i) {
+            m_clients.at((sender + i) % m_clients.size())->sendBinaryMessage(message);
+            ++m_forwarded;
+        }
+    }
+
+    QWebSocketServer m_server;
+    QList<QWebSocket *> m_clients;
+    int m_fanOut;
+    quint64 m_forwarded = 0;
+};
+
+// Lives in its own thread, so that the server thread is measured on its own.
+class Swarm : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Swarm(const Options &options) : m_options(options) { }
+
+    void connectAll(const QUrl &url)
+    {
+        for (int i = 0; i < m_options.connections; ++i) {
+            auto *socket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+#if QT_CONFIG(ssl)
+            // the certificate is usually self-signed
+            connect(socket, &QWebSocket::sslErrors, socket,
+                    [socket](const QList<QSslError> &) { socket->ignoreSslErrors(); });
+#endif
+            connect(socket, &QWebSocket::connected, this, [this]() { ++m_connected; });
+            connect(socket, &QWebSocket::binaryMessageReceived, this, &Swarm::onMessage);
+            socket->open(url);
+            m_sockets.append(socket);
+        }
+    }
+
+    int connectedCount() const { return m_connected; }
+
+    void startSending()
+    {
+        m_latencies.clear();
+        m_sent = 0;
+        m_received = 0;
+        m_timer.setTimerType(Qt::PreciseTimer);
+        m_timer.setInterval(qMax(1, 1000 / m_options.rate));
+        connect(&m_timer, &QTimer::timeout, this, &Swarm::sendRound, Qt::UniqueConnection);
+        m_timer.start();
+    }
+
+    void stopSending() { m_timer.stop(); }
+
+    quint64 sent() const { return m_sent; }
+    quint64 received() const { return m_received; }
+    std::vector<qint64> takeLatencies() { return std::exchange(m_latencies, {}); }
+
+private:
+    void sendRound()
+    {
+        QByteArray message(qMax(m_options.messageSize, int(sizeof(qint64))), 'a');
+        for (QWebSocket *socket : std::as_const(m_sockets)) {
+            if (socket->state() != QAbstractSocket::ConnectedState)
+                continue;
+            qToBigEndian<qint64>(s_clock.nsecsElapsed(), message.data());
+            socket->sendBinaryMessage(message);
+            ++m_sent;
+        }
+    }
+
+    void onMessage(const QByteArray &message)
+    {
+        if (message.size() < qsizetype(sizeof(qint64)))
+            return;
+        ++m_received;
+        m_latencies.push_back(s_clock.nsecsElapsed()
+                              - qFromBigEndian<qint64>(message.constData()));
+    }
+
+    Options m_options;
+    QList<QWebSocket *> m_sockets;
+    // a child, so that it moves to the thread of the swarm
+    QTimer m_timer{ this };
+    std::vector<qint64> m_latencies;
+    quint64 m_sent = 0;
+    quint64 m_received = 0;
+    int m_connected = 0;
+};
+
+// runs function in the thread of object and waits for it
+template <typename Function>
+void runIn(QObject *object, Function function)
+{
+    QMetaObject::invokeMethod(object, function, Qt::BlockingQueuedConnection);
+}
+
+void printLatencies(std::vector<qint64> &latencies)
+{
+    if (latencies.empty()) {
+        printf("latency: no messages received\n");
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double p) {
+        const size_t index = qMin(latencies.size() - 1, size_t(p * double(latencies.size())));
+        return double(latencies[index]) / 1000.0;
+    };
+    printf("latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+           double(latencies.back()) / 1000.0);
+
+    // logarithmic histogram, one bucket per power of two microseconds
+    std::vector<quint64> buckets;
+    for (qint64 latency : latencies) {
+        size_t bucket = 0;
+        for (qint64 us = latency / 1000; us > 1; us >>= 1)
+            ++bucket;
+        if (bucket >= buckets.size())
+            buckets.resize(bucket + 1);
+        ++buckets[bucket];
+    }
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        if (!buckets[i])
+            continue;
+        printf("  < %8llu us: %10llu (%5.2f%%)\n", 2ULL << i, buckets[i],
+               100.0 * double(buckets[i]) / double(latencies.size()));
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    s_clock.start();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(u"Loopback load generator for QWebSocketServer"_s);
+    parser.addHelpOption();
+    const QCommandLineOption connectionsOption(u"connections"_s, u"Number of clients."_s,
+                                               u"count"_s, u"100"_s);
+    const QCommandLineOption sizeOption(u"size"_s, u"Message size in bytes."_s, u"bytes"_s,
+                                        u"64"_s);
+    const QCommandLineOption rateOption(u"rate"_s, u"Messages per second per client."_s,
+                                        u"rate"_s, u"10"_s);
+    const QCommandLineOption fanOutOption(u"fan-out"_s,
+                                          u"Number of clients every message is forwarded to."_s,
+                                          u"count"_s, u"1"_s);
+    const QCommandLineOption durationOption(u"duration"_s, u"Duration of the run in seconds."_s,
+                                            u"seconds"_s, u"10"_s);
+    const QCommandLineOption tlsOption(u"tls"_s, u"Use wss:// (needs --certificate and --key)."_s);
+    const QCommandLineOption certificateOption(u"certificate"_s,
+                                               u"PEM certificate of the server."_s, u"file"_s);
+    const QCommandLineOption keyOption(u"key"_s, u"PEM RSA key of the server."_s, u"file"_s);
+    parser.addOptions({ connectionsOption, sizeOption, rateOption, fanOutOption, durationOption,
+                        tlsOption, certificateOption, keyOption });
+    parser.process(app);
+
+    Options options;
+    options.connections = qMax(1, parser.value(connectionsOption).toInt());
+    options.messageSize = qMax(0, parser.value(sizeOption).toInt());
+    options.rate = qBound(1, parser.value(rateOption).toInt(), 1000);
+    options.fanOut = qBound(1, parser.value(fanOutOption).toInt(), options.connections);
+    options.duration = qMax(1, parser.value(durationOption).toInt());
+    options.tls = parser.isSet(tlsOption);
+    options.certificate = parser.value(certificateOption);
+    options.key = parser.value(keyOption);
+#if !QT_CONFIG(ssl)
+    if (options.tls) {
+        qWarning("This build of Qt has no TLS support");
+        return 1;
+    }
+#endif
+
+    Server server(options);
+    if (!server.listen(options))
+        return 1;
+
+    QThread swarmThread;
+    Swarm swarm(options);
+    swarm.moveToThread(&swarmThread);
+    swarmThread.start();
+    const auto stopThread = qScopeGuard([&]() {
+        runIn(&swarm, [&swarm]() {
+            const QList<QWebSocket *> sockets = swarm.findChildren<QWebSocket *>();
+            qDeleteAll(sockets);
+        });
+        swarmThread.quit();
+        swarmThread.wait();
+    });
+
+    const qint64 baseline = residentBytes();
+    QElapsedTimer phase;
+    phase.start();
+    const QUrl url = server.url();
+    runIn(&swarm, [&swarm, url]() { swarm.connectAll(url); });
+    int connected = 0;
+    while (connected < options.connections || server.connectionCount() < options.connections) {
+        if (phase.hasExpired(60000)) {
+            qWarning("Only %d of %d clients connected", connected, options.connections);
+            return 1;
+        }
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        runIn(&swarm, [&swarm, &connected]() { connected = swarm.connectedCount(); });
+    }
+    const qint64 connectTime = phase.elapsed();
+    const qint64 connectedBytes = residentBytes();
+    printf("%d connections%s in %lld ms\n", options.connections, options.tls ? " (TLS)" : "",
+           connectTime);
+    if (baseline > 0 && connectedBytes > 0) {
+        printf("resident memory per connection (client and server side): %lld bytes\n",
+               (connectedBytes - baseline) / options.connections);
+    }
+
+    // sampled in this thread, which is the server thread
+    const qint64 cpuStart = cpuTime();
+    phase.restart();
+    runIn(&swarm, [&swarm]() { swarm.startSending(); });
+    QTimer::singleShot(options.duration * 1000, &app, &QCoreApplication::quit);
+    app.exec();
+    runIn(&swarm, [&swarm]() { swarm.stopSending(); });
+
+    // give the messages in flight some time to arrive
+    QElapsedTimer drain;
+    drain.start();
+    while (!drain.hasExpired(1000))
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+
+    const double seconds = double(phase.elapsed()) / 1000.0;
+    const qint64 cpuUsed = cpuTime() - cpuStart;
+    quint64 sent = 0;
+    quint64 received = 0;
+    std::vector<qint64> latencies;
+    runIn(&swarm, [&]() {
+        sent = swarm.sent();
+        received = swarm.received();
+        latencies = swarm.takeLatencies();
+    });
+
+    printf("messages sent: %llu (%.0f/s), forwarded: %llu, received: %llu (%.0f/s, %.2f MB/s)\n",
+           sent, double(sent) / seconds, server.forwardedMessages(), received,
+           double(received) / seconds,
+           double(received) * options.messageSize / seconds / (1024 * 1024));
+    if (cpuStart >= 0) {
+        printf("CPU time: %lld ms (%.1f%% of one core, %s)\n", cpuUsed,
+               100.0 * double(cpuUsed) / 1000.0 / seconds,
+               isCpuTimePerThread ? "server thread" : "server and client threads");
+    }
+    printLatencies(latencies);
+    return 0;
+}
+
+#include "main.moc"
@@ -2,6 +2,7 @@ TEMPLATE = subdirs
 
 SUBDIRS += \
     compliance \
+    loadgenerator \
     websockets
 
 